@@ -323,8 +323,10 @@ PYBIND11_MODULE(_broker, m) {
            xs.emplace_back(std::move(m.first), std::move(m.second));
          ep.publish(std::move(xs));
        })
-    .def("make_publisher", &broker::endpoint::make_publisher)
-    .def("make_subscriber", &broker::endpoint::make_subscriber, py::arg("topics"), py::arg("max_qsize") = 20)
+    .def("make_publisher",
+         (broker::publisher (broker::endpoint::*)(broker::topic))
+           &broker::endpoint::make_publisher)
+    .def("make_subscriber", &broker::endpoint::make_subscriber, py::arg("topics"), py::arg("max_qsize") = 0)
     .def("make_status_subscriber", &broker::endpoint::make_status_subscriber, py::arg("receive_statuses") = false)
     .def("shutdown", &broker::endpoint::shutdown)
     .def("attach_master",
@@ -68,5 +68,6 @@ void init_enums(py::module& m) {
   py::enum_<broker::backend>(m, "Backend")
     .value("Memory", broker::backend::memory)
     .value("SQLite", broker::backend::sqlite)
+    .value("Log", broker::backend::log)
     .export_values();
 }
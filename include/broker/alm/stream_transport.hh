@@ -363,11 +363,29 @@ public:
                         caf::make_span(&msg, 1));
   }
 
+  /// Pushes a batch of messages to peers without forwarding it to local
+  /// subscribers. The dispatcher processes the entire batch in a single pass.
+  void remote_push(caf::span<const node_message> msgs) {
+    BROKER_TRACE(BROKER_ARG2("msgs.size", msgs.size()));
+    if (!msgs.empty())
+      dispatcher_.enqueue(nullptr, detail::item_scope::remote, msgs);
+  }
+
   /// Pushes data to peers.
   void push(data_message msg) {
     remote_push(make_node_message(std::move(msg), ttl()));
   }
 
+  /// Pushes a batch of data or commands to peers.
+  template <class T>
+  void push(std::vector<T> msgs) {
+    std::vector<node_message> xs;
+    xs.reserve(msgs.size());
+    for (auto& msg : msgs)
+      xs.emplace_back(make_node_message(std::move(msg), ttl()));
+    remote_push(caf::span<const node_message>{xs.data(), xs.size()});
+  }
+
   /// Pushes data to peers.
   void push(command_message msg) {
     remote_push(make_node_message(std::move(msg), ttl()));
@@ -393,6 +411,11 @@ public:
     push(std::move(msg));
   }
 
+  template <class T>
+  void ship(std::vector<T>& msgs) {
+    push(std::move(msgs));
+  }
+
   template <class T>
   void publish(T msg) {
     dref().ship(msg);
@@ -21,4 +21,40 @@ namespace broker::defaults::store {
 
 extern const caf::timespan tick_interval;
 
+constexpr size_t snapshot_chunk_size = 1000;
+
+constexpr size_t snapshot_credit = 4;
+
+constexpr size_t mutation_log_size = 10000;
+
+constexpr size_t range_page_size = 1000;
+
+constexpr bool clone_local_reads = false;
+
+extern const caf::timespan sqlite_batch_interval;
+
+constexpr size_t log_compaction_threshold = 4 * 1024 * 1024;
+
+extern const caf::timespan expiry_resolution;
+
+extern const caf::timespan batch_window;
+
 } // namespace broker::defaults::store
+
+namespace broker::defaults::publisher {
+
+constexpr size_t queue_size = 30;
+
+constexpr size_t max_queue_size = 30;
+
+constexpr size_t rate_sample_size = 10;
+
+} // namespace broker::defaults::publisher
+
+namespace broker::defaults::subscriber {
+
+constexpr size_t queue_size = 20;
+
+constexpr size_t rate_sample_size = 10;
+
+} // namespace broker::defaults::subscriber
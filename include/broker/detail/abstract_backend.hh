@@ -6,6 +6,9 @@
 #include "broker/snapshot.hh"
 
 #include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace broker {
 namespace detail {
@@ -13,6 +16,26 @@ namespace detail {
 using expirable = std::pair<broker::data, timestamp>;
 using expirables = std::deque<expirable>;
 
+/// Visits a single entry of a store. The callee may move from the value.
+using entry_visitor
+  = std::function<void(const data& key, data& value, optional<timestamp>)>;
+
+/// Visits a single key with an expiration time.
+using expiry_visitor = std::function<void(const data& key, timestamp)>;
+
+struct key_range;
+
+/// A page of key-value pairs, as returned by `abstract_backend::scan` and
+/// `abstract_backend::range`.
+struct scan_result {
+  /// Key-value pairs in ascending key order.
+  std::vector<std::pair<data, data>> entries;
+
+  /// Stores the key for resuming the scan or `nil` if `entries` includes the
+  /// last key-value pair.
+  optional<data> next;
+};
+
 /// Abstract base class for a key-value storage backend.
 class abstract_backend {
 public:
@@ -48,6 +71,41 @@ public:
   virtual expected<void> subtract(const data& key, const data& value,
                                   optional<timestamp> expiry = {});
 
+  /// Inserts or updates a key-value pair and returns the previous value.
+  /// The default implementation calls `get()` followed by `put()`.
+  /// @param key The key to update/insert.
+  /// @param value The value associated with *key*.
+  /// @param expiry An optional expiration time for the entry.
+  /// @returns The previous value at *key* or `nil` if *key* did not exist.
+  virtual expected<optional<data>>
+  put_returning_old(const data& key, data value,
+                    optional<timestamp> expiry = {});
+
+  /// Adds one value to another value and returns the result.
+  /// @param key The key associated with the existing value to add to.
+  /// @param value The value to add on top of the existing value at *key*.
+  /// @param init_type The type of data to initialize when the key doesn't exist.
+  /// @param expiry An optional expiration time for the entry.
+  /// @param old_value Receives the previous value at *key* (or `nil` if *key*
+  ///                  did not exist) unless `nullptr`.
+  /// @returns The new value at *key*.
+  virtual expected<data> add_returning_new(const data& key, const data& value,
+                                           data::type init_type,
+                                           optional<timestamp> expiry = {},
+                                           optional<data>* old_value
+                                           = nullptr);
+
+  /// Removes one value from another value and returns the result.
+  /// @param key The key associated with the existing value to subtract from.
+  /// @param value The value to subtract from the existing value at *key*.
+  /// @param expiry An optional expiration time for the entry.
+  /// @param old_value Receives the previous value at *key* unless `nullptr`.
+  /// @returns The new value at *key*.
+  virtual expected<data> subtract_returning_new(const data& key,
+                                                const data& value,
+                                                optional<timestamp> expiry = {},
+                                                data* old_value = nullptr);
+
   /// Removes a key and its associated value from the store, if it exists.
   /// @param key The key to use.
   /// @returns `nil` if *key* was removed successfully or if *key* did not
@@ -69,6 +127,13 @@ public:
   virtual expected<bool> expire(const data& key,
                                 timestamp current_time) = 0;
 
+  /// Removes all keys with an expiration time that is not after
+  /// `current_time`, i.e., all keys that `expire` would remove. The default
+  /// implementation calls `expire` for each key in `for_each_expiry`.
+  /// @param current_time The time used to compare whether to expire a key.
+  /// @returns The expired keys.
+  virtual expected<std::vector<data>> expire_due(timestamp current_time);
+
   // --- inspectors -----------------------------------------------------------
 
   /// Retrieves the value associated with a given key.
@@ -88,6 +153,18 @@ public:
   /// the query.
   virtual expected<bool> exists(const data& key) const = 0;
 
+  /// Retrieves the values for multiple keys at once. The default
+  /// implementation calls `get` for each key.
+  /// @param keys The keys to look up.
+  /// @returns A table with the key-value pairs for all keys that exist.
+  virtual expected<data> get_many(const std::vector<data>& keys) const;
+
+  /// Checks for multiple keys at once. The default implementation calls
+  /// `exists` for each key.
+  /// @param keys The keys to check.
+  /// @returns A vector of booleans with one entry per key, in order.
+  virtual expected<data> exists_many(const std::vector<data>& keys) const;
+
   /// Retrieves the number of entries in the store.
   /// @returns The number of key-value pairs in the store.
   virtual expected<uint64_t> size() const = 0;
@@ -102,6 +179,59 @@ public:
 
   /// @returns the set of all keys that have expiry times.
   virtual expected<expirables> expiries() const = 0;
+
+  // --- batching -------------------------------------------------------------
+
+  /// Returns how long the backend may hold back modifications before making
+  /// them persistent, or `nil` if the backend applies each write immediately.
+  virtual optional<timespan> batch_interval() const;
+
+  /// Makes all pending modifications persistent.
+  /// @returns `nil` on success.
+  virtual expected<void> flush();
+
+  // --- cursors --------------------------------------------------------------
+
+  /// Invokes `f` for each key-value pair without materializing the content of
+  /// the store. The default implementation falls back to `snapshot()` and
+  /// `expiries()`.
+  /// @param f Receives each entry. Must not call member functions of the
+  ///          backend.
+  /// @returns `nil` after visiting all entries.
+  virtual expected<void> for_each(const entry_visitor& f) const;
+
+  /// Invokes `f` for each key that has an expiration time. The default
+  /// implementation falls back to `expiries()`.
+  /// @param f Receives each key and its expiry. Must not call member functions
+  ///          of the backend.
+  /// @returns `nil` after visiting all keys with an expiry.
+  virtual expected<void> for_each_expiry(const expiry_visitor& f) const;
+
+  /// Retrieves up to `limit` key-value pairs in ascending key order, starting
+  /// at the first key that is not less than `begin_key`. Passing the `next`
+  /// field of a previous result continues the scan, even if the store has
+  /// changed in between. Hence, a scan visits each key that exists for its
+  /// entire duration exactly once. The default implementation falls back to
+  /// `for_each()` and keeps at most `limit + 1` entries in memory.
+  /// @param begin_key The first key of the page or `nil` to start at the
+  ///                  beginning.
+  /// @param limit The maximum number of entries to return.
+  /// @returns The next page.
+  /// @pre `limit > 0`
+  virtual expected<scan_result> scan(const optional<data>& begin_key,
+                                     size_t limit) const;
+
+  /// Retrieves up to `limit` key-value pairs in `range` in ascending key
+  /// order. Passing `range.resume_at(next)` with the `next` field of a
+  /// previous result retrieves the following page. The default implementation
+  /// falls back to `for_each()` and keeps at most `limit + 1` entries in
+  /// memory.
+  /// @param range The keys to retrieve.
+  /// @param limit The maximum number of entries to return.
+  /// @returns The first page of *range*.
+  /// @pre `limit > 0`
+  virtual expected<scan_result> range(const key_range& range,
+                                      size_t limit) const;
 };
 
 } // namespace detail
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include <caf/actor.hpp>
+#include <caf/make_message.hpp>
+#include <caf/message.hpp>
+
+#include "broker/data.hh"
+#include "broker/error.hh"
+#include "broker/expected.hh"
+#include "broker/fwd.hh"
+
+namespace broker::detail {
+
+/// Performs blocking requests to a store frontend. Spawns a single
+/// `flare_actor` for receiving all responses instead of a new `scoped_actor`
+/// per request and correlates responses with requests by their ID. Threads
+/// that share a requester may have any number of requests in flight. One
+/// waiting thread at a time receives from the `flare_actor` and hands each
+/// response to the thread waiting for it.
+class blocking_requester {
+public:
+  /// Spawns the actor for receiving responses from `frontend`.
+  explicit blocking_requester(caf::actor frontend);
+
+  blocking_requester(const blocking_requester&) = delete;
+
+  blocking_requester& operator=(const blocking_requester&) = delete;
+
+  /// Sends `(xs..., id)` to the frontend and blocks until the frontend
+  /// responds with `(data, id)` or `(error, id)`.
+  template <class... Ts>
+  expected<data> request(Ts&&... xs) {
+    return request_with([&](const caf::actor&, request_id id) {
+      return caf::make_message(std::forward<Ts>(xs)..., id);
+    });
+  }
+
+  /// Sends the message `f(self, id)` to the frontend and blocks until the
+  /// frontend responds with `(data, id)` or `(error, id)`. Allows callers to
+  /// pass the handle for the response in the message itself.
+  template <class F>
+  expected<data> request_with(F f) {
+    request_id id;
+    {
+      std::unique_lock<std::mutex> guard{mtx_};
+      id = ++id_;
+      pending_.emplace(id, slot{});
+      send(f(self_, id));
+    }
+    return await(id);
+  }
+
+private:
+  using clock_type = std::chrono::steady_clock;
+
+  /// Holds the response for a request in flight.
+  struct slot {
+    bool done = false;
+    expected<data> result{ec::unspecified};
+  };
+
+  void send(caf::message msg);
+
+  /// Waits for the response with `id`. Receives responses for other threads
+  /// in the meantime if no other thread does.
+  expected<data> await(request_id id);
+
+  /// Receives a single response or returns after `deadline`. Stores the
+  /// response in its slot, dropping late responses to requests that timed
+  /// out.
+  void receive_one(clock_type::time_point deadline);
+
+  /// Protects all member variables below.
+  std::mutex mtx_;
+
+  /// Signals waiting threads that a response arrived or that the receiving
+  /// thread returned.
+  std::condition_variable cv_;
+
+  /// Stores whether a thread currently receives from `self_`.
+  bool receiving_ = false;
+
+  /// Stores the slots of all requests in flight.
+  std::unordered_map<request_id, slot> pending_;
+
+  request_id id_ = 0;
+  caf::actor frontend_;
+  caf::actor self_;
+};
+
+} // namespace broker::detail
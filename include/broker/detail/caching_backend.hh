@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+#include <caf/fwd.hpp>
+
+#include "broker/detail/abstract_backend.hh"
+
+namespace broker::detail {
+
+/// Wraps another backend and keeps the most recently used values in memory.
+/// Serves `get` and `exists` from the cache whenever possible and drops
+/// cached values on each modification of their key. A successful `exists`
+/// only caches that the key exists, i.e., a later `get` for the same key still
+/// goes to the wrapped backend.
+class caching_backend : public abstract_backend {
+public:
+  /// Constructs a cache in front of `backend`.
+  /// @param backend The backend that owns the data.
+  /// @param capacity The maximum number of cached keys.
+  caching_backend(std::unique_ptr<abstract_backend> backend, size_t capacity);
+
+  ~caching_backend() override;
+
+  // --- modifiers ------------------------------------------------------------
+
+  expected<void> put(const data& key, data value,
+                     optional<timestamp> expiry) override;
+
+  expected<void> add(const data& key, const data& value, data::type init_type,
+                     optional<timestamp> expiry) override;
+
+  expected<void> subtract(const data& key, const data& value,
+                          optional<timestamp> expiry) override;
+
+  expected<optional<data>> put_returning_old(const data& key, data value,
+                                             optional<timestamp> expiry) override;
+
+  expected<data> add_returning_new(const data& key, const data& value,
+                                   data::type init_type,
+                                   optional<timestamp> expiry,
+                                   optional<data>* old_value) override;
+
+  expected<data> subtract_returning_new(const data& key, const data& value,
+                                        optional<timestamp> expiry,
+                                        data* old_value) override;
+
+  expected<void> erase(const data& key) override;
+
+  expected<void> clear() override;
+
+  expected<bool> expire(const data& key, timestamp current_time) override;
+
+  expected<std::vector<data>> expire_due(timestamp current_time) override;
+
+  // --- inspectors -----------------------------------------------------------
+
+  expected<data> get(const data& key) const override;
+
+  expected<bool> exists(const data& key) const override;
+
+  expected<uint64_t> size() const override;
+
+  expected<data> keys() const override;
+
+  expected<broker::snapshot> snapshot() const override;
+
+  expected<expirables> expiries() const override;
+
+  // --- batching -------------------------------------------------------------
+
+  optional<timespan> batch_interval() const override;
+
+  expected<void> flush() override;
+
+  // --- cursors --------------------------------------------------------------
+
+  expected<void> for_each(const entry_visitor& f) const override;
+
+  expected<void> for_each_expiry(const expiry_visitor& f) const override;
+
+  expected<scan_result> scan(const optional<data>& begin_key,
+                             size_t limit) const override;
+
+  expected<scan_result> range(const key_range& range,
+                              size_t limit) const override;
+
+  // --- cache statistics -----------------------------------------------------
+
+  /// Returns how many lookups the cache answered.
+  uint64_t hits() const noexcept {
+    return hits_;
+  }
+
+  /// Returns how many lookups went to the wrapped backend.
+  uint64_t misses() const noexcept {
+    return misses_;
+  }
+
+  /// Returns the number of currently cached keys.
+  size_t cached() const noexcept {
+    return entries_.size();
+  }
+
+  /// Returns the maximum number of cached keys.
+  size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  /// Additionally counts hits and misses in the given metrics. Passing
+  /// `nullptr` stops updating the metrics.
+  void metrics(caf::telemetry::int_counter* hits,
+               caf::telemetry::int_counter* misses) noexcept {
+    hits_metric_ = hits;
+    misses_metric_ = misses;
+  }
+
+private:
+  struct entry {
+    /// Stores whether the key exists.
+    bool found;
+
+    /// The cached value or `nil` if the key does not exist or if only
+    /// `exists` has looked up the key so far.
+    optional<data> value;
+
+    /// Position of the key in `lru_`.
+    std::list<const data*>::iterator pos;
+  };
+
+  /// Returns the cached entry for `key` and marks it as most recently used.
+  const entry* lookup(const data& key) const;
+
+  /// Caches whether `key` exists and, if known, its `value`. Evicts the least
+  /// recently used entry if necessary.
+  void insert(const data& key, bool found, optional<data> value) const;
+
+  void hit() const;
+
+  void miss() const;
+
+  /// Drops the cached entry for `key`, if any.
+  void invalidate(const data& key);
+
+  std::unique_ptr<abstract_backend> backend_;
+
+  size_t capacity_;
+
+  mutable std::unordered_map<data, entry> entries_;
+
+  /// Points to keys in `entries_`, ordered from most to least recently used.
+  mutable std::list<const data*> lru_;
+
+  mutable uint64_t hits_ = 0;
+
+  mutable uint64_t misses_ = 0;
+
+  caf::telemetry::int_counter* hits_metric_ = nullptr;
+
+  caf::telemetry::int_counter* misses_metric_ = nullptr;
+};
+
+} // namespace broker::detail
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
 #include <caf/fwd.hpp>
 
 #include "broker/detail/assert.hh"
+#include "broker/detail/filter_index.hh"
 #include "broker/detail/unipath_manager.hh"
 #include "broker/fwd.hh"
 
@@ -22,6 +25,22 @@ public:
   /// Adds a new output path to the dispatcher.
   void add(unipath_manager_ptr sink);
 
+  /// Updates the prefix index after `sink` changed its filter. Called by the
+  /// managers whenever they receive a new filter.
+  void filter_changed(const unipath_manager* sink,
+                      const filter_type& old_filter,
+                      const filter_type& new_filter);
+
+  /// Returns whether at least one local subscriber receives data messages for
+  /// the topic `x`.
+  bool has_local_subscriber(const topic& x) const;
+
+  /// Sets a function that the dispatcher calls whenever a sink joins, leaves,
+  /// or changes its filter.
+  void on_sinks_changed(std::function<void()> f) {
+    sinks_changed_ = std::move(f);
+  }
+
   auto self() const noexcept {
     return self_;
   }
@@ -30,9 +49,29 @@ public:
     return sinks_;
   }
 
+  const auto& index() const noexcept {
+    return index_;
+  }
+
 private:
+  using selection = std::vector<const node_message*>;
+
+  void sinks_changed() {
+    if (sinks_changed_)
+      sinks_changed_();
+  }
+
   caf::scheduled_actor* self_;
   std::vector<unipath_manager_ptr> sinks_;
+
+  /// Maps the filter entries of all sinks to the sinks.
+  filter_index index_;
+
+  /// Caches the messages selected for each sink while running `enqueue`.
+  std::unordered_map<const unipath_manager*, selection> selections_;
+
+  /// Runs whenever a sink joins, leaves, or changes its filter.
+  std::function<void()> sinks_changed_;
 };
 
 } // namespace broker::detail
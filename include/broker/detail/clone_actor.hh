@@ -1,6 +1,8 @@
 #pragma once
 
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <caf/actor.hpp>
@@ -9,6 +11,7 @@
 #include <caf/behavior.hpp>
 
 #include "broker/data.hh"
+#include "broker/detail/clone_view.hh"
 #include "broker/detail/store_actor.hh"
 #include "broker/endpoint.hh"
 #include "broker/internal_command.hh"
@@ -61,14 +64,65 @@ public:
 
   void operator()(clear_command&);
 
+  void operator()(set_chunk_command&);
+
+  void operator()(put_batch_command&);
+
+  void operator()(erase_batch_command&);
+
+  void operator()(expire_batch_command&);
+
+  void operator()(delta_command&);
+
+  /// Applies all updates that arrived while waiting for the snapshot.
+  void snapshot_complete();
+
+  /// Makes all changes to `store` and `is_stale` visible to readers of
+  /// `view`. Does nothing if the clone has no view.
+  void publish_view();
+
+  /// Asks the clone to call `publish_view()` once it has processed all
+  /// updates of the current stream batch. Does nothing if the clone has no
+  /// view or already scheduled a publish.
+  void schedule_publish_view();
+
   data keys() const;
 
+  /// Returns a table with the key-value pairs for all `keys` that exist.
+  data get_many(const vector& keys) const;
+
+  /// Returns a vector of booleans with one entry per key in `keys`.
+  data exists_many(const vector& keys) const;
+
+  /// Returns the first page of `range` as produced by `make_range_page`.
+  /// Builds `ordered_keys` on the first call.
+  data range(const key_range& range);
+
+  /// Adds `key` to `ordered_keys` if the clone maintains the index.
+  void index_insert(const data& key);
+
+  /// Removes `key` from `ordered_keys` if the clone maintains the index.
+  void index_erase(const data& key);
+
+  /// Drops `ordered_keys` after replacing the entire content of `store`. The
+  /// next range query rebuilds the index.
+  void index_reset();
+
   topic master_topic;
 
   caf::actor master;
 
   std::unordered_map<data, data> store;
 
+  /// Keeps the keys of `store` in ascending order for answering range
+  /// queries without visiting the entire store. Remains empty until the first
+  /// range query, i.e., clones that never answer range queries pay nothing
+  /// for the index.
+  std::set<data> ordered_keys;
+
+  /// Stores whether `ordered_keys` mirrors the keys of `store`.
+  bool has_ordered_keys = false;
+
   bool is_stale = true;
 
   double stale_time = -1.0;
@@ -79,10 +133,28 @@ public:
 
   std::vector<internal_command> pending_remote_updates;
 
+  /// Mirrors `store` for readers on other threads. Remains `nullptr` unless
+  /// `broker.store.clone-local-reads` is enabled.
+  clone_view_ptr view;
+
+  /// Stores whether a message for publishing the view is on its way.
+  bool view_publish_scheduled = false;
+
+  /// Collects the keys of all snapshot chunks until receiving the last one.
+  std::unordered_set<data> snapshot_keys;
+
   bool awaiting_snapshot = true;
 
   bool awaiting_snapshot_sync = true;
 
+  /// Sequence number of the last mutation from the master that this clone
+  /// applied.
+  uint64_t seq = 0;
+
+  /// Address of the master that `seq` refers to. Remains invalid until the
+  /// clone received its first snapshot.
+  caf::actor_addr synced_master;
+
   static inline constexpr const char* name = "clone_actor";
 };
 
@@ -90,7 +162,7 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
                           caf::actor core, std::string id,
                           double resync_interval, double stale_interval,
                           double mutation_buffer_interval,
-                          endpoint::clock* ep_clock);
+                          endpoint::clock* ep_clock, clone_view_ptr view);
 
 } // namespace detail
 } // namespace broker
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <caf/allowed_unsafe_message_type.hpp>
+
+#include "broker/data.hh"
+#include "broker/expected.hh"
+#include "broker/fwd.hh"
+
+namespace broker::detail {
+
+/// Makes the content of a clone readable from other threads. The clone actor
+/// mirrors each change to its key-value pairs into the view and publishes an
+/// immutable snapshot after each batch of updates. Readers load the latest snapshot
+/// atomically and never wait for the clone actor. Snapshots split the keys
+/// into buckets by their hash and share all buckets that remain unchanged,
+/// i.e., publishing only copies the buckets with modified keys.
+class clone_view {
+public:
+  // -- member types -----------------------------------------------------------
+
+  using map_type = std::unordered_map<data, data>;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  clone_view();
+
+  clone_view(const clone_view&) = delete;
+
+  clone_view& operator=(const clone_view&) = delete;
+
+  // -- reader interface (safe to call from any thread) ------------------------
+
+  /// Returns the value for `key`, `ec::no_such_key` if `key` does not exist,
+  /// or `ec::stale_data` if the clone is stale.
+  expected<data> get(const data& key) const;
+
+  /// Returns whether `key` exists or `ec::stale_data` if the clone is stale.
+  expected<data> exists(const data& key) const;
+
+  /// Returns the number of key-value pairs in the current snapshot.
+  size_t size() const;
+
+  // -- writer interface (reserved to the clone actor) -------------------------
+
+  /// Inserts or updates the value for `key`.
+  void put(const data& key, const data& value);
+
+  /// Removes `key` if it exists.
+  void erase(const data& key);
+
+  /// Replaces the entire content with `xs`.
+  void assign(const map_type& xs);
+
+  /// Sets whether readers receive `ec::stale_data`.
+  void stale(bool value);
+
+  /// Makes all changes since the last call visible to readers.
+  void publish();
+
+private:
+  // -- private member types ---------------------------------------------------
+
+  using bucket_ptr = std::shared_ptr<map_type>;
+
+  using const_bucket_ptr = std::shared_ptr<const map_type>;
+
+  struct snapshot_type {
+    std::vector<const_bucket_ptr> buckets;
+    size_t size = 0;
+    bool stale = true;
+  };
+
+  using snapshot_ptr = std::shared_ptr<const snapshot_type>;
+
+  // -- private member functions -----------------------------------------------
+
+  /// Returns the index of the bucket for `key`.
+  size_t index_of(const data& key) const;
+
+  /// Returns the bucket at `index` after making sure that no snapshot shares
+  /// it.
+  map_type& writable_bucket(size_t index);
+
+  /// Redistributes all entries to `num_buckets` new buckets.
+  void rehash(size_t num_buckets);
+
+  /// Loads the latest snapshot.
+  snapshot_ptr load() const;
+
+  // -- member variables -------------------------------------------------------
+
+  /// The latest published snapshot. Only accessed via `std::atomic_load` and
+  /// `std::atomic_store`.
+  snapshot_ptr current_;
+
+  /// The buckets of the next snapshot.
+  std::vector<bucket_ptr> buckets_;
+
+  /// Stores for each bucket whether the writer may modify it in place, i.e.,
+  /// whether no published snapshot refers to it.
+  std::vector<bool> owned_;
+
+  /// Number of key-value pairs in `buckets_`.
+  size_t size_ = 0;
+
+  /// Stale flag for the next snapshot.
+  bool stale_ = true;
+
+  /// Stores whether the next snapshot differs from `current_`.
+  bool changed_ = false;
+};
+
+} // namespace broker::detail
+
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(broker::detail::clone_view_ptr)
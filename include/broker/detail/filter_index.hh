@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include "broker/detail/radix_tree.hh"
+#include "broker/filter_type.hh"
+#include "broker/topic.hh"
+
+namespace broker::detail {
+
+class unipath_manager;
+
+/// Maps subscribed topic prefixes to the managers that subscribed to them.
+/// Allows the @ref central_dispatcher to select all receivers for a topic with
+/// a single lookup instead of evaluating the filter of each manager.
+class filter_index {
+public:
+  using manager_list = std::vector<const unipath_manager*>;
+
+  /// Adds all entries of `filter` for `mgr` to the index.
+  void add(const unipath_manager* mgr, const filter_type& filter);
+
+  /// Removes all entries of `filter` for `mgr` from the index.
+  void erase(const unipath_manager* mgr, const filter_type& filter);
+
+  /// Incrementally updates the index after `mgr` changed its filter from
+  /// `old_filter` to `new_filter`.
+  void update(const unipath_manager* mgr, const filter_type& old_filter,
+              const filter_type& new_filter);
+
+  /// Calls `f` for each manager with a filter entry that is a prefix of `t`.
+  /// @note `f` may get called more than once for the same manager if it has
+  ///       overlapping filter entries.
+  template <class F>
+  void for_each_match(const topic& t, F&& f) const {
+    for (auto& i : tree_.prefix_of(t.string()))
+      for (auto mgr : i->second)
+        f(mgr);
+  }
+
+  /// Returns the number of distinct topics in the index.
+  size_t size() const noexcept {
+    return tree_.size();
+  }
+
+  /// Returns whether the index contains no entries.
+  bool empty() const noexcept {
+    return tree_.empty();
+  }
+
+private:
+  void add(const unipath_manager* mgr, const topic& x);
+
+  void erase(const unipath_manager* mgr, const topic& x);
+
+  radix_tree<manager_list> tree_;
+};
+
+} // namespace broker::detail
@@ -2,7 +2,9 @@
 
 #include <cstddef>
 #include <chrono>
+#include <mutex>
 
+#include "broker/config.hh"
 #include "broker/time.hh"
 
 #include <caf/io/network/native_socket.hpp>
@@ -14,16 +16,21 @@ namespace broker::detail {
 /// signal availability of a resource across threads, both access to that
 /// resource and the use of the fire/extinguish functions must be performed in
 /// a thread-safe manner in order for that to work correctly.
+///
+/// On Linux, the flare keeps its counter in user space and backs the file
+/// descriptor with a single `eventfd` that only changes on transitions
+/// between zero and non-zero. Elsewhere, it falls back to a UNIX pipe with one
+/// byte per "fire".
 class flare {
 public:
   using timeout_type = clock::time_point;
 
   using native_socket = caf::io::network::native_socket;
 
-  /// Constructs a flare by opening a UNIX pipe.
+  /// Constructs a flare by opening an eventfd or a UNIX pipe.
   flare();
 
-  /// Destructs the flare, closing the UNIX pipe's file descriptors.
+  /// Destructs the flare, closing its file descriptors.
   ~flare();
 
   flare(const flare&) = delete;
@@ -33,32 +40,28 @@ public:
   /// "fired" and not yet "extinguishedd."
   native_socket fd() const;
 
-  /// Puts the object in the "ready" state by writing `n` bytes into the
-  /// underlying pipe.
+  /// Puts the object in the "ready" state by adding `num` to its counter.
   void fire(size_t num = 1);
 
-  // Takes the object out of the "ready" state by consuming all bytes from the
-  // underlying pipe.
-  // @returns the number of consumed bytes
+  /// Takes the object out of the "ready" state by resetting its counter.
+  /// @returns the previous value of the counter.
   size_t extinguish();
 
-  /// Attempts to consume only one byte from the pipe, potentially leaving the
-  /// flare in "ready" state.
-  /// @returns `true` if one byte was read successfully from the pipe and
-  ///          `false` if the pipe had no data to be read.
+  /// Attempts to decrement the counter by one, potentially leaving the flare
+  /// in "ready" state.
+  /// @returns `true` if the counter was decremented and `false` if the flare
+  ///          was not active.
   bool extinguish_one();
 
-  /// Attempts to consume only one byte from the pipe, potentially leaving the
+  /// Attempts to decrement the counter by up to `num`, potentially leaving the
   /// flare in "ready" state.
-  /// @returns `true` if one byte was read successfully from the pipe and
-  ///          `false` if the pipe had no data to be read.
+  /// @returns the amount the counter was decremented by.
   size_t extinguish_some(size_t num);
 
-  /// Blocks the caller until the object could consume one byte from the pipe.
+  /// Blocks the caller until the flare becomes ready.
   void await_one();
 
-  /// Blocks the caller until the object could consume one byte from the pipe
-  /// or or a timeout occurs.
+  /// Blocks the caller until the flare becomes ready or a timeout occurs.
   template <class Timeout>
   bool await_one(Timeout timeout) {
     using clk = typename Timeout::clock;
@@ -73,6 +76,14 @@ private:
   bool await_one_impl(int ms_timeout);
 
   native_socket fds_[2];
+
+#ifdef BROKER_LINUX
+  /// Guards `count_` and keeps the state of the eventfd in sync with it.
+  std::mutex mtx_;
+
+  /// Stores how often the flare has been fired but not yet extinguished.
+  size_t count_ = 0;
+#endif // BROKER_LINUX
 };
 
 } // namespace broker::detail
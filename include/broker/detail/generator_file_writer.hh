@@ -6,6 +6,7 @@
 #include <fstream>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <caf/binary_serializer.hpp>
@@ -14,6 +15,7 @@
 #include <caf/variant.hpp>
 
 #include "broker/fwd.hh"
+#include "broker/topic.hh"
 
 namespace broker {
 namespace detail {
@@ -79,7 +81,7 @@ private:
   caf::binary_serializer sink_;
   std::ofstream f_;
   size_t flush_threshold_;
-  std::vector<topic> topic_table_;
+  std::unordered_map<topic, uint16_t> topic_ids_;
   std::string file_name_;
 };
 
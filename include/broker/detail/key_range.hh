@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <utility>
+
+#include "broker/data.hh"
+#include "broker/detail/abstract_backend.hh"
+#include "broker/optional.hh"
+
+namespace broker::detail {
+
+/// A contiguous range of keys in the order of `data`. The range includes all
+/// keys that are not less than `lo` and either less than `bound` or, for
+/// prefix ranges, start with `bound`.
+struct key_range {
+  /// The smallest key in the range.
+  data lo;
+
+  /// The end of the range (exclusive) or the prefix of all keys in the range.
+  data bound;
+
+  /// Selects whether `bound` is a prefix.
+  bool prefix = false;
+
+  /// Returns the range of all keys in `[lo, hi)`.
+  static key_range between(data lo, data hi);
+
+  /// Returns the range of all keys that start with `prefix`. Strings match
+  /// other strings that start with `prefix` and vectors match other vectors
+  /// that start with the elements of `prefix`. Values of any other type only
+  /// match themselves.
+  static key_range starting_with(data prefix);
+
+  /// Returns whether `key` lies before the end of the range. When iterating
+  /// keys in ascending order starting at `lo`, the range ends at the first
+  /// key for which this function returns `false`.
+  bool before_end(const data& key) const;
+
+  /// Returns whether the range includes `key`.
+  bool contains(const data& key) const {
+    return !(key < lo) && before_end(key);
+  }
+
+  /// Returns a copy of this range that starts at `key` instead.
+  key_range resume_at(data key) const {
+    return {std::move(key), bound, prefix};
+  }
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, key_range& x) {
+  return f.object(x).fields(f.field("lo", x.lo), f.field("bound", x.bound),
+                            f.field("prefix", x.prefix));
+}
+
+/// Returns whether `key` starts with `prefix` as defined by
+/// `key_range::starting_with`.
+bool has_prefix(const data& key, const data& prefix);
+
+/// Converts `page` into a `vector` with a `table` of its entries and, unless
+/// `page` is the last page of its range, the first key of the next page.
+data make_range_page(scan_result&& page);
+
+/// Collects a page of at most `limit` entries in a key range from entries in
+/// arbitrary order. Keeps at most `limit + 1` entries in memory.
+class range_page_builder {
+public:
+  /// @pre `limit > 0`
+  range_page_builder(const key_range& range, size_t limit);
+
+  /// Adds `key` and `value` to the page if `key` belongs to it.
+  void add(const data& key, const data& value);
+
+  /// Returns the entries of the page in ascending key order.
+  scan_result build() &&;
+
+private:
+  const key_range& range_;
+  size_t limit_;
+  std::map<data, data> entries_;
+};
+
+} // namespace broker::detail
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+
+#include "broker/backend_options.hh"
+
+#include "broker/detail/abstract_backend.hh"
+
+namespace broker::detail {
+
+/// A persistent backend that appends each modification to a log file. Keeps
+/// an in-memory ordered index that maps each key to the position of its
+/// latest value in the log and reads values from a memory-mapped view of the
+/// file. The index answers scans and range queries by seeking to their first
+/// key.
+/// Rewrites the log with only the live entries once overwritten and erased
+/// entries take up more space than the live entries.
+class log_backend : public abstract_backend {
+public:
+  /// Constructs a log backend.
+  /// @param opts The options to create/open a log file.
+  /// Required parameters:
+  ///   - `path`: a `std::string` representing the location of the log file
+  ///             on the filesystem.
+  /// Optional parameters:
+  ///   - `compaction-threshold`: a `count` with the minimum number of bytes
+  ///                             of stale records before compacting the log
+  ///                             (default: 4 MiB).
+  ///   - `sync-interval`: a `timespan` that makes the master call `flush()`
+  ///                      periodically.
+  /// Writes go to the operating system right away but only reach the disk
+  /// after calling `flush()` or when compacting the log. Opening a log that
+  /// ends with a partially written record drops that record. Opening a log
+  /// with an invalid record fails.
+  log_backend(backend_options opts = backend_options{});
+
+  ~log_backend() override;
+
+  bool init_failed() const;
+
+  expected<void> put(const data& key, data value,
+                     optional<timestamp> expiry) override;
+
+  expected<void> add(const data& key, const data& value, data::type init_type,
+                     optional<timestamp> expiry) override;
+
+  expected<void> subtract(const data& key, const data& value,
+                          optional<timestamp> expiry) override;
+
+  expected<void> erase(const data& key) override;
+
+  expected<void> clear() override;
+
+  expected<bool> expire(const data& key, timestamp current_time) override;
+
+  expected<std::vector<data>> expire_due(timestamp current_time) override;
+
+  expected<data> get(const data& key) const override;
+
+  expected<bool> exists(const data& key) const override;
+
+  expected<uint64_t> size() const override;
+
+  expected<data> keys() const override;
+
+  expected<broker::snapshot> snapshot() const override;
+
+  expected<expirables> expiries() const override;
+
+  optional<timespan> batch_interval() const override;
+
+  expected<void> flush() override;
+
+  expected<void> for_each(const entry_visitor& f) const override;
+
+  expected<void> for_each_expiry(const expiry_visitor& f) const override;
+
+  expected<scan_result> scan(const optional<data>& begin_key,
+                             size_t limit) const override;
+
+  expected<scan_result> range(const key_range& range,
+                              size_t limit) const override;
+
+  /// Rewrites the log with only the live entries.
+  /// @returns `nil` on success.
+  expected<void> compact();
+
+  /// Returns the current size of the log file in bytes.
+  uint64_t file_size() const;
+
+private:
+  struct impl;
+  std::unique_ptr<impl> impl_;
+};
+
+} // namespace broker::detail
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "broker/backend.hh"
 #include "broker/backend_options.hh"
@@ -13,5 +14,12 @@ namespace detail {
 std::unique_ptr<abstract_backend> make_backend(backend type,
                                                backend_options opts);
 
+/// Creates one backend per shard of a master. Reads the number of shards from
+/// the option `shards` (default: 1) and appends `.shard-<i>` to the `path` of
+/// shard `i` if there is more than one shard.
+/// @returns the backends or an empty vector on error.
+std::vector<std::unique_ptr<abstract_backend>>
+make_backends(backend type, backend_options opts);
+
 } // namespace detail
 } // namespace broker
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <deque>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include <caf/actor.hpp>
 #include <caf/behavior.hpp>
@@ -9,6 +14,7 @@
 
 #include "broker/data.hh"
 #include "broker/detail/store_actor.hh"
+#include "broker/detail/timer_wheel.hh"
 #include "broker/endpoint.hh"
 #include "broker/fwd.hh"
 #include "broker/internal_command.hh"
@@ -27,28 +33,121 @@ public:
   /// Owning smart pointer to a backend.
   using backend_pointer = std::unique_ptr<abstract_backend>;
 
-  /// Initializes the object.
+  /// Initializes the object. The coordinator of a sharded master has no
+  /// backend, i.e., `bp` is `nullptr`.
   void init(caf::event_based_actor* ptr, std::string&& nm,
             backend_pointer&& bp, caf::actor&& parent, endpoint::clock* clock);
 
-  /// Sends `x` to all clones.
+  /// Sends `x` to all clones. Collects `x` for the next batch instead if
+  /// `batch_window` is positive.
   void broadcast(internal_command&& x);
 
+  /// Sends all commands in `xs` to all clones. Collects `xs` for the next
+  /// batch instead if `batch_window` is positive.
+  void broadcast(std::vector<internal_command>&& xs);
+
+  /// Sends all commands in `xs` to all clones in a single message to the core.
+  /// Merges consecutive commands into batch commands.
+  void publish(std::vector<internal_command>& xs);
+
+  /// Sends all commands in `pending_commands` to all clones.
+  void publish_pending();
+
+  /// Asks the clock to trigger `publish_pending()` after `batch_window`.
+  void schedule_publish();
+
+  /// Returns whether mutations need to leave this actor, i.e., whether the
+  /// master has clones or forwards its mutations to a coordinator.
+  bool replicates() const {
+    return !clones.empty() || coordinator != nullptr;
+  }
+
+  /// Records `cmd` in the mutation log and sends it to all clones.
   template <class T>
   void broadcast_cmd_to_clones(T cmd) {
     BROKER_DEBUG("broadcast" << cmd << "to" << clones.size() << "clones");
-    if (!clones.empty())
-      broadcast(internal_command{std::move(cmd)});
+    internal_command x{std::move(cmd)};
+    record(x);
+    if (replicates())
+      broadcast(std::move(x));
   }
 
+  /// Starts tracking the clone from `x`, sends a sync point to all clones and
+  /// tries to bring the clone up to date with the mutation log.
+  /// @returns `true` if the clone received all missing mutations, `false` if
+  ///          the clone still needs a snapshot.
+  bool add_clone(snapshot_command& x);
+
+  /// Assigns the next sequence number to `x` and appends it to the mutation
+  /// log.
+  void record(const internal_command& x);
+
+  /// Returns the commands since `clone_seq` if the mutation log still has all
+  /// of them.
+  optional<std::vector<internal_command>> delta_since(uint64_t clone_seq);
+
+  /// Schedules the expiration of `key` after `expiry`.
   void remind(timespan expiry, const data& key);
 
-  void expire(data& key);
+  /// Expires all keys with an expiration time in the past with a single call
+  /// to the backend and sends the resulting commands to the clones in a
+  /// single batch.
+  void tick();
+
+  /// Asks the clock to trigger `tick()` if keys wait for their expiration.
+  void schedule_tick();
 
   void command(internal_command& cmd);
 
   void command(internal_command::variant_type& cmd);
 
+  /// Returns the index of the shard that owns `key`.
+  size_t shard_of(const data& key) const;
+
+  /// Sends `cmd` to the shards that own its keys. Only the coordinator of a
+  /// sharded master routes commands.
+  void route(internal_command::variant_type& cmd);
+
+  /// Records and broadcasts the mutations that shard `i` has applied to its
+  /// backend. Holds back mutations of shards that have already processed a
+  /// `clear_command` until all shards have cleared their backend, because
+  /// clones must see a single clear at the same position for all keys.
+  void replicate(size_t i, std::vector<internal_command>& xs);
+
+  /// Starts sending a snapshot to `clone`. The snapshot includes all
+  /// mutations up to `seq`.
+  void start_snapshot(const caf::actor& clone);
+
+  /// Sends chunks of the snapshot for `clone` until the clone has
+  /// `snapshot_credit` unacknowledged chunks or the snapshot is complete.
+  /// Coordinators of sharded masters ask the current shard for the next
+  /// chunk instead.
+  void send_snapshot_chunks(const caf::actor_addr& clone);
+
+  /// Frees up credit for sending further snapshot chunks to `clone`.
+  void ack_snapshot_chunk(const caf::actor_addr& clone);
+
+  /// Reads up to `snapshot_chunk_size` entries from the backend, starting at
+  /// `next`. Afterwards, `next` is the first key of the following chunk.
+  /// @returns `true` if `chunk` includes the last entry of the backend.
+  bool read_snapshot_chunk(optional<data>& next, broker::snapshot& chunk);
+
+  /// Relays a chunk of a shard snapshot to the clone. Moves on to the next
+  /// shard once `next` is `nil` and completes the snapshot after the last
+  /// shard. Drops chunks for transfers that are no longer in progress.
+  void relay_snapshot_chunk(const caf::actor_addr& clone, uint64_t transfer,
+                            broker::snapshot& chunk, optional<data>& next);
+
+  /// Asks the clock to trigger `flush()` if the backend batches writes.
+  void schedule_flush();
+
+  /// Makes all pending writes of the backend persistent.
+  void flush();
+
+  /// Applies `x` to the backend and emits the corresponding event.
+  /// @returns `true` on success, `false` otherwise.
+  bool put(put_command& x);
+
   void operator()(none);
 
   void operator()(put_command&);
@@ -71,12 +170,112 @@ public:
 
   void operator()(clear_command&);
 
+  void operator()(put_batch_command&);
+
+  void operator()(erase_batch_command&);
+
+  void operator()(expire_batch_command&);
+
   topic clones_topic;
 
   backend_pointer backend;
 
   std::unordered_map<caf::actor_addr, caf::actor> clones;
 
+  /// Stores the sequence numbers of reconnecting clones until their snapshot
+  /// request arrives.
+  std::unordered_map<caf::actor_addr, uint64_t> resync_offers;
+
+  /// Sequence number of the last mutation.
+  uint64_t seq = 0;
+
+  /// Keeps the most recent mutations for bringing reconnecting clones up to
+  /// date. The last entry has the sequence number `seq`.
+  std::deque<internal_command> mutation_log;
+
+  /// Configures the maximum number of entries in the mutation log.
+  size_t mutation_log_size = 0;
+
+  /// Configures the maximum number of entries per snapshot chunk.
+  size_t snapshot_chunk_size = 0;
+
+  /// Configures how many unacknowledged snapshot chunks a clone may have.
+  size_t snapshot_credit = 0;
+
+  /// Stores whether a flush message is already on its way.
+  bool flush_scheduled = false;
+
+  /// Keeps track of the expiration times of all keys.
+  std::unique_ptr<timer_wheel> expirations;
+
+  /// Stores whether a tick message is already on its way.
+  bool tick_scheduled = false;
+
+  /// Configures how long the master collects commands for clones before
+  /// sending them in a single batch. A value of 0 disables batching.
+  timespan batch_window{0};
+
+  /// Collects commands for clones until the current batch window closes.
+  std::vector<internal_command> pending_commands;
+
+  /// Stores whether a publish message is already on its way.
+  bool publish_scheduled = false;
+
+  /// Points to the coordinator if this master is a shard of a sharded master.
+  /// Shards forward their mutations to the coordinator instead of sending
+  /// them to clones.
+  caf::actor coordinator;
+
+  /// Stores all shards if this master is the coordinator of a sharded master.
+  /// The coordinator has no backend. Instead, each shard owns the keys that
+  /// `shard_of` maps to its index.
+  std::vector<caf::actor> shards;
+
+  /// Counts the shards that still need to clear their backend before the
+  /// coordinator may broadcast a pending `clear_command`.
+  size_t pending_clears = 0;
+
+  /// Stores which shards have cleared their backend for the pending
+  /// `clear_command`.
+  std::vector<bool> cleared_shards;
+
+  /// Holds back the mutations of shards in `cleared_shards` until all shards
+  /// have cleared their backend.
+  std::vector<std::vector<internal_command>> held_commands;
+
+  /// Keeps track of a snapshot that this master sends to a clone. Masters
+  /// read the snapshot with a backend cursor while processing updates in
+  /// between. Clones apply the updates since `seq` on top of the snapshot.
+  struct snapshot_transfer {
+    /// Receives the snapshot.
+    caf::actor clone;
+
+    /// Tells transfers to the same clone apart.
+    uint64_t id = 0;
+
+    /// Sequence number of the last mutation before the snapshot started.
+    uint64_t seq = 0;
+
+    /// Stores the first key of the next chunk or `nil` before the first chunk
+    /// of the current backend.
+    optional<data> next;
+
+    /// Index of the shard that provides the next chunk.
+    size_t shard = 0;
+
+    /// Number of chunks that the clone has not acknowledged yet.
+    size_t in_flight = 0;
+
+    /// Stores whether the coordinator waits for a chunk from a shard.
+    bool fetching = false;
+  };
+
+  /// Stores all snapshots in progress by the address of their clone.
+  std::unordered_map<caf::actor_addr, snapshot_transfer> snapshot_transfers;
+
+  /// Assigns IDs to snapshot transfers.
+  uint64_t next_transfer_id = 0;
+
   bool exists(const data& key);
 
   static inline constexpr const char* name = "master_actor";
@@ -87,5 +286,23 @@ caf::behavior master_actor(caf::stateful_actor<master_state>* self,
                            master_state::backend_pointer backend,
                            endpoint::clock* clock);
 
+/// Runs one shard of a sharded master. Applies commands to its own backend
+/// and forwards the resulting mutations to `coordinator`.
+caf::behavior master_shard_actor(caf::stateful_actor<master_state>* self,
+                                 caf::actor core, caf::actor coordinator,
+                                 std::string id,
+                                 master_state::backend_pointer backend,
+                                 endpoint::clock* clock);
+
+/// Runs the coordinator of a sharded master. Spawns one shard per backend,
+/// routes commands and queries to the shards by key hash and takes care of
+/// all clones, i.e., clones see a single master with a single sequence of
+/// mutations.
+caf::behavior
+sharded_master_actor(caf::stateful_actor<master_state>* self, caf::actor core,
+                     std::string id,
+                     std::vector<master_state::backend_pointer> backends,
+                     endpoint::clock* clock);
+
 } // namespace detail
 } // namespace broker
@@ -1,6 +1,8 @@
 #pragma once
 
-#include <unordered_map>
+#include <map>
+#include <set>
+#include <utility>
 
 #include "broker/backend_options.hh"
 
@@ -9,7 +11,9 @@
 namespace broker {
 namespace detail {
 
-/// An in-memory key-value storage backend.
+/// An in-memory key-value storage backend. Keeps its entries ordered by key
+/// for answering range queries without visiting the entire store and indexes
+/// all keys with an expiry by their expiration time.
 class memory_backend : public abstract_backend {
 public:
   /// Constructs a memory backend.
@@ -25,12 +29,26 @@ public:
   expected<void> subtract(const data& key, const data& value,
                           optional<timestamp> expiry) override;
 
+  expected<optional<data>> put_returning_old(const data& key, data value,
+                                             optional<timestamp> expiry) override;
+
+  expected<data> add_returning_new(const data& key, const data& value,
+                                   data::type init_type,
+                                   optional<timestamp> expiry,
+                                   optional<data>* old_value) override;
+
+  expected<data> subtract_returning_new(const data& key, const data& value,
+                                        optional<timestamp> expiry,
+                                        data* old_value) override;
+
   expected<void> erase(const data& key) override;
 
   expected<void> clear() override;
 
   expected<bool> expire(const data& key, timestamp current_time) override;
 
+  expected<std::vector<data>> expire_due(timestamp current_time) override;
+
   expected<data> get(const data& key) const override;
 
   expected<data> get(const data& key, const data& value) const override;
@@ -45,10 +63,30 @@ public:
 
   expected<expirables> expiries() const override;
 
+  expected<void> for_each(const entry_visitor& f) const override;
+
+  expected<void> for_each_expiry(const expiry_visitor& f) const override;
+
+  expected<scan_result> scan(const optional<data>& begin_key,
+                             size_t limit) const override;
+
+  expected<scan_result> range(const key_range& range,
+                              size_t limit) const override;
+
 private:
+  using store_type = std::map<data, std::pair<data, optional<timestamp>>>;
+
+  /// Changes the expiry of the entry at `i` and updates the index.
+  void set_expiry(store_type::iterator i, optional<timestamp> expiry);
+
+  /// Removes the entry at `i` from the store and the index.
+  void erase(store_type::iterator i);
+
   backend_options options_;
-  std::unordered_map<data, std::pair<data, optional<timestamp>>> store_;
-  std::unordered_map<data, timestamp> expirations_;
+  store_type store_;
+
+  /// Orders all keys with an expiry by their expiration time.
+  std::set<std::pair<timestamp, data>> expirations_;
 };
 
 } // namespace detail
@@ -39,6 +39,12 @@ public:
 
   caf::error operator()(const clear_command& x);
 
+  caf::error operator()(const put_batch_command& x);
+
+  caf::error operator()(const erase_batch_command& x);
+
+  caf::error operator()(const expire_batch_command& x);
+
 private:
   caf::error apply_tag(uint8_t tag);
 
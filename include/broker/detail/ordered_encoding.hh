@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "broker/data.hh"
+#include "broker/expected.hh"
+
+namespace broker::detail {
+
+/// Identifies the current layout of `encode_ordered`. Persistent storage
+/// records this version next to the encoded values and must convert its
+/// content whenever the layout changes.
+constexpr uint32_t ordered_encoding_version = 1;
+
+/// Appends the binary representation of `x` to `buf`. The encoding is
+/// compact and preserves the order of `data`: comparing two encoded values
+/// bytewise, with a proper prefix comparing less, yields the same result as
+/// comparing the values themselves. The only exceptions are `-0.0` and
+/// `0.0`, which have distinct encodings, and NaNs.
+///
+/// Each value starts with a type tag. Integers and sizes use a variable
+/// number of bytes, strings escape zero bytes and end with a terminator, and
+/// containers list their elements and end with a zero byte.
+void encode_ordered(const data& x, std::vector<uint8_t>& buf);
+
+/// Returns the binary representation of `x`.
+/// @relates encode_ordered
+std::vector<uint8_t> encode_ordered(const data& x);
+
+/// Restores a value from its binary representation.
+/// @returns the decoded value or `ec::invalid_data` if the `size` bytes at
+///          `buf` do not contain exactly one encoded value.
+expected<data> decode_ordered(const void* buf, size_t size);
+
+} // namespace broker::detail
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <deque>
+
 #include <caf/intrusive_ptr.hpp>
 #include <caf/make_counted.hpp>
 
@@ -21,6 +24,11 @@ namespace detail {
 /// - consume() fires the flare when it removes items from xs_ and less than 20
 ///   items remain
 /// - produce() extinguishes the flare it adds items to xs_, exceeding 20
+///
+/// When constructed with a maximum buffer size above the initial size, the
+/// queue adapts its capacity: produce() doubles the capacity instead of
+/// blocking as long as it stays below the maximum, and consume() halves the
+/// capacity again (down to the initial size) once the buffer runs mostly empty.
 template <class ValueType = data_message>
 class shared_publisher_queue : public shared_queue<ValueType> {
 public:
@@ -30,7 +38,15 @@ public:
 
   using guard_type = typename super::guard_type;
 
-  shared_publisher_queue(size_t buffer_size) : capacity_(buffer_size) {
+  shared_publisher_queue(size_t buffer_size)
+    : shared_publisher_queue(buffer_size, buffer_size) {
+    // nop
+  }
+
+  shared_publisher_queue(size_t buffer_size, size_t max_buffer_size)
+    : capacity_(buffer_size),
+      min_capacity_(buffer_size),
+      max_capacity_(std::max(buffer_size, max_buffer_size)) {
     // The flare is active as long as publishers can write.
     this->fx_.fire();
   }
@@ -43,8 +59,9 @@ public:
   template <class F>
   size_t consume(size_t num, F fun) {
     guard_type guard{this->mtx_};
-    auto& xs = this->xs_;
+    auto& xs = xs_;
     if (xs.empty()) {
+      shrink();
       this->pending_ = static_cast<long>(num);
       return false;
     }
@@ -53,14 +70,16 @@ public:
     auto e = b + static_cast<ptrdiff_t>(n);
     for (auto i = b; i != e; ++i)
       fun(std::move(*i));
-    auto old_size = xs.size();
+    auto was_full = xs.size() >= capacity_;
     xs.erase(b, e);
     auto new_size = xs.size();
+    shrink();
     // Extinguish the flare if we reach the capacity or fire it if we drop
     // below the capacity again.
-    if (new_size >= capacity_ && old_size < capacity_)
+    auto is_full = new_size >= capacity_;
+    if (is_full && !was_full)
       this->fx_.extinguish();
-    else if (new_size < capacity_ && old_size >= capacity_)
+    else if (!is_full && was_full)
       this->fx_.fire();
     if (num - n > 0)
       this->pending_ = static_cast<long>(num - n);
@@ -72,7 +91,7 @@ public:
   template <class Iterator>
   bool produce(const topic& t, Iterator first, Iterator last) {
     guard_type guard{this->mtx_};
-    auto& xs = this->xs_;
+    auto& xs = xs_;
     if (xs.size() >= capacity_)
       await_consumer(guard);
     auto xs_old_size = xs.size();
@@ -89,7 +108,7 @@ public:
   // Returns true if the caller must wake up the consumer.
   bool produce(const topic& t, data&& y) {
     guard_type guard{this->mtx_};
-    auto& xs = this->xs_;
+    auto& xs = xs_;
     if (xs.size() >= capacity_)
       await_consumer(guard);
     auto xs_old_size = xs.size();
@@ -103,25 +122,60 @@ public:
   }
 
   size_t capacity() const {
+    guard_type guard{this->mtx_};
     return capacity_;
   }
 
+  size_t max_capacity() const {
+    return max_capacity_;
+  }
+
+  size_t buffer_size() const {
+    guard_type guard{this->mtx_};
+    return xs_.size();
+  }
+
 private:
+  // Halves an adaptive buffer again once it runs mostly empty.
+  void shrink() {
+    if (capacity_ > min_capacity_ && xs_.size() < capacity_ / 4) {
+      capacity_ = std::max(capacity_ / 2, min_capacity_);
+      xs_.shrink_to_fit();
+    }
+  }
+
   void await_consumer(guard_type& guard) {
-    // Block the caller until the consumer catched up.
-    guard.unlock();
-    this->fx_.await_one();
-    guard.lock();
+    while (xs_.size() >= capacity_) {
+      if (capacity_ < max_capacity_) {
+        // Grow the buffer instead of blocking if we still can.
+        capacity_ = std::min(capacity_ * 2, max_capacity_);
+        if (xs_.size() < capacity_)
+          this->fx_.fire();
+      } else {
+        // Block the caller until the consumer catched up.
+        guard.unlock();
+        this->fx_.await_one();
+        guard.lock();
+      }
+    }
   }
 
   /// @pre xs.size() < capacity_
   ptrdiff_t free_space() {
-    return static_cast<ptrdiff_t>(capacity_ - this->xs.size());
+    return static_cast<ptrdiff_t>(capacity_ - xs_.size());
   }
 
+  /// Buffers values produced by the user.
+  std::deque<value_type> xs_;
 
   // Configures the amound of items for xs_.
-  const size_t capacity_;
+  size_t capacity_;
+
+  // Lower bound for `capacity_` when shrinking the buffer.
+  const size_t min_capacity_;
+
+  // Upper bound for `capacity_` when growing the buffer.
+  const size_t max_capacity_;
 };
 
 template <class ValueType = data_message>
@@ -134,5 +188,12 @@ make_shared_publisher_queue(size_t buffer_size) {
   return caf::make_counted<shared_publisher_queue<ValueType>>(buffer_size);
 }
 
+template <class ValueType = data_message>
+shared_publisher_queue_ptr<ValueType>
+make_shared_publisher_queue(size_t buffer_size, size_t max_buffer_size) {
+  return caf::make_counted<shared_publisher_queue<ValueType>>(buffer_size,
+                                                              max_buffer_size);
+}
+
 } // namespace detail
 } // namespace broker
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <atomic>
-#include <deque>
 #include <mutex>
 #include <thread>
 #include <condition_variable>
@@ -39,11 +38,6 @@ public:
     return rate_.load();
   }
 
-  size_t buffer_size() const {
-    guard_type guard{mtx_};
-    return xs_.size();
-  }
-
   // --- mutators --------------------------------------------------------------
 
   void pending(long x) {
@@ -79,15 +73,12 @@ protected:
     // nop
   }
 
-  /// Guards access to `xs`.
+  /// Guards access to the buffer of the derived queue.
   mutable std::mutex mtx_;
 
   /// Signals to users when data can be read or written.
   mutable flare fx_;
 
-  /// Buffers values received by the worker.
-  std::deque<value_type> xs_;
-
   /// Stores what demand the worker has last signaled to the core or vice
   /// versa, depending on the message direction.
   std::atomic<long> pending_;
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <limits>
 #include <vector>
+
 #include <caf/intrusive_ptr.hpp>
 #include <caf/make_counted.hpp>
 
@@ -15,11 +20,15 @@ namespace detail {
 /// the flare remains active. The user consumes items, while the worker
 /// produces them.
 ///
+/// The queue stores whole batches as chunks and keeps a read cursor into the
+/// first chunk. Hence, the worker hands over batches without touching
+/// individual elements and users can take out entire chunks at once.
+///
 /// The protocol on the flare is as follows:
 /// - the flare starts inactive
-/// - the flare is active as long as xs_ has more than one item
-/// - produce() fires the flare when it adds items to xs_ and xs_ was empty
-/// - consume() extinguishes the flare when it removes the last item from xs_
+/// - the flare is active as long as the queue has more than one item
+/// - produce() fires the flare when it adds items to an empty queue
+/// - consume() extinguishes the flare when it removes the last item
 template <class ValueType = data_message>
 class shared_subscriber_queue : public shared_queue<ValueType> {
 public:
@@ -29,6 +38,8 @@ public:
 
   using guard_type = typename super::guard_type;
 
+  using chunk_type = std::vector<value_type>;
+
   shared_subscriber_queue() = default;
 
   // Called to pull up to `num` items out of the queue. Returns the number of
@@ -36,43 +47,66 @@ public:
   template <class F>
   size_t consume(size_t num, size_t* size_before_consume, F fun) {
     guard_type guard{this->mtx_};
-    if (this->xs_.empty())
+    if (size_ == 0)
       return 0;
     if (size_before_consume)
-      *size_before_consume = this->xs_.size();
-    auto n = std::min(num, this->xs_.size());
-    if (n == this->xs_.size()) {
-      for (auto& x : this->xs_)
-        fun(std::move(x));
-      this->xs_.clear();
-      this->fx_.extinguish_one();
-    } else {
-      auto b = this->xs_.begin();
-      auto e = b + static_cast<ptrdiff_t>(n);
-      for (auto i = b; i != e; ++i)
+      *size_before_consume = size_;
+    auto n = std::min(num, size_);
+    auto remaining = n;
+    while (remaining > 0) {
+      auto& chunk = chunks_.front();
+      auto first = chunk.begin() + static_cast<ptrdiff_t>(offset_);
+      auto k = std::min(remaining, chunk.size() - offset_);
+      for (auto i = first; i != first + static_cast<ptrdiff_t>(k); ++i)
         fun(std::move(*i));
-      this->xs_.erase(b, e);
+      advance(k);
+      remaining -= k;
     }
     return n;
   }
 
-  std::vector<value_type> consume_all() {
+  // Moves up to `num` items out of the queue and appends them to `xs`. Moves
+  // entire chunks into `xs` without touching individual elements whenever
+  // possible. Returns the number of consumed elements.
+  size_t consume(size_t num, size_t* size_before_consume, chunk_type& xs) {
     guard_type guard{this->mtx_};
+    if (size_ == 0)
+      return 0;
+    if (size_before_consume)
+      *size_before_consume = size_;
+    auto n = std::min(num, size_);
+    auto remaining = n;
+    while (remaining > 0) {
+      auto& chunk = chunks_.front();
+      auto k = std::min(remaining, chunk.size() - offset_);
+      if (xs.empty() && offset_ == 0 && k == chunk.size()) {
+        xs.swap(chunk);
+      } else {
+        auto first = chunk.begin() + static_cast<ptrdiff_t>(offset_);
+        xs.insert(xs.end(), std::make_move_iterator(first),
+                  std::make_move_iterator(first + static_cast<ptrdiff_t>(k)));
+      }
+      advance(k);
+      remaining -= k;
+    }
+    return n;
+  }
 
-    std::vector<value_type> rval;
-
-    if (this->xs_.empty())
-      return rval;
-
-    rval.reserve(this->xs_.size());
-
-    for (auto& x : this->xs_)
-      rval.emplace_back(std::move(x));
-
-    this->xs_.clear();
-    this->fx_.extinguish_one();
+  chunk_type consume_all() {
+    chunk_type result;
+    consume(std::numeric_limits<size_t>::max(), nullptr, result);
+    return result;
+  }
 
-    return rval;
+  // Inserts `xs` into the queue as a single chunk.
+  void produce(chunk_type&& xs) {
+    if (xs.empty())
+      return;
+    guard_type guard{this->mtx_};
+    if (size_ == 0)
+      this->fx_.fire();
+    size_ += xs.size();
+    chunks_.emplace_back(std::move(xs));
   }
 
   // Inserts the range `[i, e)` into the queue.
@@ -80,19 +114,44 @@ public:
   void produce(size_t num, Iter i, Iter e) {
     CAF_IGNORE_UNUSED(num);
     CAF_ASSERT(num == std::distance(i, e));
-    guard_type guard{this->mtx_};
-    if (this->xs_.empty())
-      this->fx_.fire();
-    this->xs_.insert(this->xs_.end(), i, e);
+    produce(chunk_type(i, e));
   }
 
   // Inserts `x` into the queue.
   void produce(ValueType x) {
+    chunk_type xs;
+    xs.emplace_back(std::move(x));
+    produce(std::move(xs));
+  }
+
+  size_t buffer_size() const {
     guard_type guard{this->mtx_};
-    if (this->xs_.empty())
-      this->fx_.fire();
-    this->xs_.emplace_back(std::move(x));
+    return size_;
   }
+
+private:
+  // Moves the read cursor `n` elements forward, dropping the first chunk once
+  // the cursor reaches its end. Note that the first chunk is empty at this
+  // point if the caller swapped it out entirely.
+  void advance(size_t n) {
+    offset_ += n;
+    size_ -= n;
+    if (offset_ >= chunks_.front().size()) {
+      chunks_.pop_front();
+      offset_ = 0;
+    }
+    if (size_ == 0)
+      this->fx_.extinguish_one();
+  }
+
+  /// Buffers batches received by the worker.
+  std::deque<chunk_type> chunks_;
+
+  /// Points to the first unread element in `chunks_.front()`.
+  size_t offset_ = 0;
+
+  /// Stores the number of unread elements in all chunks.
+  size_t size_ = 0;
 };
 
 template <class ValueType = data_message>
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <caf/intrusive_ptr.hpp>
+#include <caf/make_counted.hpp>
+#include <caf/ref_counted.hpp>
+
+#include "broker/detail/assert.hh"
+#include "broker/detail/flare.hh"
+#include "broker/message.hh"
+
+namespace broker::detail {
+
+/// Lock-free alternative to `shared_publisher_queue` for a single producer
+/// (the user) and a single consumer (the background worker). Stores items in a
+/// bounded ring buffer and provides the same interface and flare protocol as
+/// `shared_publisher_queue`:
+/// - the flare starts active
+/// - the flare is active as long as the buffer has free capacity
+/// - consume() fires the flare when the buffer goes from full to non-full
+/// - produce() extinguishes the flare when the buffer becomes full
+///
+/// Unlike `shared_publisher_queue`, producing a range of items never exceeds
+/// the capacity. Instead, the producer blocks whenever the buffer is full.
+template <class ValueType = data_message>
+class spsc_publisher_queue : public caf::ref_counted {
+public:
+  using value_type = ValueType;
+
+  explicit spsc_publisher_queue(size_t buffer_size)
+    : capacity_(buffer_size), buf_(buffer_size) {
+    BROKER_ASSERT(buffer_size > 0);
+    // The flare is active as long as publishers can write.
+    fx_.fire();
+  }
+
+  // --- accessors -------------------------------------------------------------
+
+  auto fd() const {
+    return fx_.fd();
+  }
+
+  long pending() const {
+    return pending_.load();
+  }
+
+  size_t rate() const {
+    return rate_.load();
+  }
+
+  size_t buffer_size() const {
+    return size_.load();
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // --- mutators --------------------------------------------------------------
+
+  void pending(long x) {
+    pending_ = x;
+  }
+
+  void rate(size_t x) {
+    rate_ = x;
+  }
+
+  // --- consumer interface ----------------------------------------------------
+
+  /// Pulls up to `num` items out of the queue. Signals demand to the user if
+  /// less than `num` items can be published from the buffer.
+  /// @note Only the consumer may call this member function.
+  template <class F>
+  size_t consume(size_t num, F fun) {
+    size_t total = 0;
+    auto available = size_.load(std::memory_order_acquire);
+    while (total < num && available > 0) {
+      auto n = std::min(num - total, available);
+      for (size_t i = 0; i < n; ++i) {
+        auto& slot = buf_[head_];
+        fun(std::move(*slot));
+        slot.reset();
+        head_ = next(head_);
+      }
+      auto old_size = size_.fetch_sub(n, std::memory_order_acq_rel);
+      // Signal free capacity to the producer when leaving the full state.
+      if (old_size >= capacity_ && old_size - n < capacity_)
+        fx_.fire();
+      // The producer may have added items in the meantime. We don't need to
+      // re-check if the buffer became empty, because the producer wakes us up
+      // in that case.
+      available = old_size - n;
+      total += n;
+    }
+    if (total < num)
+      pending_ = static_cast<long>(num - total);
+    return total;
+  }
+
+  // --- producer interface ----------------------------------------------------
+
+  /// Returns true if the caller must wake up the consumer.
+  /// @note Only the producer may call this member function.
+  template <class Iterator>
+  bool produce(const topic& t, Iterator first, Iterator last) {
+    bool result = false;
+    for (; first != last; ++first)
+      if (push(value_type(t, std::move(*first))))
+        result = true;
+    return result;
+  }
+
+  /// Returns true if the caller must wake up the consumer.
+  /// @note Only the producer may call this member function.
+  bool produce(const topic& t, data&& y) {
+    return push(value_type(t, std::move(y)));
+  }
+
+private:
+  size_t next(size_t pos) const noexcept {
+    return pos + 1 < capacity_ ? pos + 1 : 0;
+  }
+
+  bool push(value_type&& x) {
+    // Block the caller until the consumer catched up.
+    while (size_.load(std::memory_order_acquire) >= capacity_)
+      fx_.await_one();
+    buf_[tail_].emplace(std::move(x));
+    tail_ = next(tail_);
+    auto old_size = size_.fetch_add(1, std::memory_order_acq_rel);
+    if (old_size + 1 == capacity_) {
+      // Extinguish the flare to cause the *next* produce to block. The
+      // consumer may have fired the flare before we could extinguish it.
+      // Hence, we need to re-check the size afterwards.
+      fx_.extinguish();
+      if (size_.load(std::memory_order_acquire) < capacity_)
+        fx_.fire();
+    }
+    // Wake up the consumer on transition from empty to non-empty.
+    return old_size == 0;
+  }
+
+  /// Configures the number of slots in the ring buffer.
+  const size_t capacity_;
+
+  /// Stores the items. Only the producer writes to empty slots and only the
+  /// consumer reads from full slots.
+  std::vector<std::optional<value_type>> buf_;
+
+  /// Position of the next item for the consumer. Only the consumer accesses
+  /// this member.
+  alignas(64) size_t head_ = 0;
+
+  /// Position of the next free slot for the producer. Only the producer
+  /// accesses this member.
+  alignas(64) size_t tail_ = 0;
+
+  /// Number of items in the buffer. Synchronizes producer and consumer.
+  alignas(64) std::atomic<size_t> size_{0};
+
+  /// Signals to the user when data can be written.
+  mutable flare fx_;
+
+  /// Stores what demand the worker has last signaled to the core.
+  std::atomic<long> pending_{0};
+
+  /// Stores the production rate.
+  std::atomic<size_t> rate_{0};
+};
+
+template <class ValueType = data_message>
+using spsc_publisher_queue_ptr
+  = caf::intrusive_ptr<spsc_publisher_queue<ValueType>>;
+
+template <class ValueType = data_message>
+spsc_publisher_queue_ptr<ValueType>
+make_spsc_publisher_queue(size_t buffer_size) {
+  return caf::make_counted<spsc_publisher_queue<ValueType>>(buffer_size);
+}
+
+} // namespace broker::detail
@@ -15,6 +15,19 @@ public:
   /// Required parameters:
   ///   - `path`: a `std::string` representing the location of the database on
   ///             the filesystem.
+  /// Optional parameters:
+  ///   - `batch-size`: a `count` enabling group commits if greater than 1.
+  ///                   The backend then wraps up to this many writes into a
+  ///                   single transaction.
+  ///   - `batch-interval`: a `timespan` that limits how long the backend
+  ///                       holds back writes when batching (default: 100ms).
+  ///   - `journal-mode`: a `std::string` for `PRAGMA journal_mode`, e.g.,
+  ///                     `WAL`.
+  ///   - `synchronous`: a `std::string` for `PRAGMA synchronous`, e.g.,
+  ///                    `NORMAL`.
+  /// When batching, a crash loses at most the writes of the current batch.
+  /// Since each batch commits atomically, the database never contains a
+  /// partially applied batch.
   sqlite_backend(backend_options opts = backend_options{});
 
   ~sqlite_backend();
@@ -30,12 +43,18 @@ public:
   expected<void> subtract(const data& key, const data& value,
                           optional<timestamp> expiry) override;
 
+  expected<data> subtract_returning_new(const data& key, const data& value,
+                                        optional<timestamp> expiry,
+                                        data* old_value) override;
+
   expected<void> erase(const data& key) override;
 
   expected<void> clear() override;
 
   expected<bool> expire(const data& key, timestamp current_time) override;
 
+  expected<std::vector<data>> expire_due(timestamp current_time) override;
+
   expected<data> get(const data& key) const override;
 
   expected<bool> exists(const data& key) const override;
@@ -48,6 +67,20 @@ public:
 
   expected<expirables> expiries() const override;
 
+  optional<timespan> batch_interval() const override;
+
+  expected<void> flush() override;
+
+  expected<void> for_each(const entry_visitor& f) const override;
+
+  expected<void> for_each_expiry(const expiry_visitor& f) const override;
+
+  expected<scan_result> scan(const optional<data>& begin_key,
+                             size_t limit) const override;
+
+  expected<scan_result> range(const key_range& range,
+                              size_t limit) const override;
+
 private:
   struct impl;
   std::unique_ptr<impl> impl_;
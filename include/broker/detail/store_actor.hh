@@ -22,6 +22,12 @@ public:
   void init(caf::event_based_actor* self, endpoint::clock* clock,
             std::string&& id, caf::actor&& core);
 
+  /// Returns whether local subscribers may receive events of this store.
+  /// Allows the store to skip work that only serves event subscribers.
+  bool has_event_subscribers() const noexcept {
+    return event_subscribers;
+  }
+
   /// Emits an `insert` event to topics::store_events subscribers.
   void emit_insert_event(const data& key, const data& value,
                          const optional<timespan>& expiry,
@@ -82,6 +88,15 @@ public:
 
   /// Destination for emitted events.
   topic dst;
+
+  /// Stores whether any local subscriber receives events of this store. The
+  /// core updates this flag whenever its subscriptions change. Event emitters
+  /// do nothing while this flag is `false`.
+  bool event_subscribers = true;
+
+  /// Configures the maximum number of entries per response to range and
+  /// prefix queries.
+  size_t range_page_size = 1;
 };
 
 } // namespace broker::detail
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "broker/data.hh"
+#include "broker/time.hh"
+
+namespace broker::detail {
+
+/// A hierarchical timer wheel that tracks one deadline per key. The wheel
+/// rounds all deadlines up to the next multiple of its resolution, which
+/// allows callers to process expirations in periodic ticks instead of
+/// scheduling one timeout per key.
+class timer_wheel {
+public:
+  /// Number of bits for selecting a slot at each level.
+  static constexpr size_t slot_bits = 6;
+
+  /// Number of slots at each level.
+  static constexpr size_t slots_per_level = size_t{1} << slot_bits;
+
+  /// Number of levels. Deadlines beyond the range of the last level go to an
+  /// overflow list.
+  static constexpr size_t num_levels = 4;
+
+  /// @param resolution The length of a single tick.
+  /// @param now The current time.
+  /// @pre `resolution.count() > 0`
+  timer_wheel(timespan resolution, timestamp now);
+
+  /// Sets the deadline for `key`, replacing any previous deadline.
+  void schedule(const data& key, timestamp deadline);
+
+  /// Removes all keys with a deadline at or before `now` from the wheel.
+  /// @returns The removed keys in no particular order.
+  std::vector<data> advance(timestamp now);
+
+  /// Returns the point in time of the next tick after `now`.
+  timestamp next_tick(timestamp now) const noexcept;
+
+  /// Returns the number of keys with a pending deadline.
+  size_t size() const noexcept {
+    return deadlines_.size();
+  }
+
+  /// Returns whether no key has a pending deadline.
+  bool empty() const noexcept {
+    return deadlines_.empty();
+  }
+
+  /// Returns the length of a single tick.
+  timespan resolution() const noexcept {
+    return resolution_;
+  }
+
+private:
+  struct entry {
+    data key;
+    uint64_t tick;
+  };
+
+  using slot = std::vector<entry>;
+
+  using level = std::array<slot, slots_per_level>;
+
+  /// Returns the tick for `t`, rounding up.
+  uint64_t tick_ceil(timestamp t) const noexcept;
+
+  /// Returns the tick for `t`, rounding down.
+  uint64_t tick_floor(timestamp t) const noexcept;
+
+  /// Places `x` in the slot that matches its tick.
+  void add(entry x);
+
+  /// Moves all entries from one slot of `lvl` to lower levels.
+  /// @returns The index of the slot.
+  size_t cascade(size_t lvl);
+
+  /// Processes the slot for `next_` and advances `next_`.
+  void step(std::vector<data>& fired);
+
+  /// Advances `next_` past ticks without any entries, up to `limit`.
+  /// @returns `true` if `next_` changed.
+  bool skip_empty(uint64_t limit);
+
+  timespan resolution_;
+
+  /// The first tick that the wheel did not process yet.
+  uint64_t next_;
+
+  std::array<level, num_levels> levels_;
+
+  /// Stores the number of entries at each level.
+  std::array<size_t, num_levels> level_sizes_ = {};
+
+  std::vector<entry> overflow_;
+
+  /// Maps each key to its current deadline (in ticks). Slots may contain
+  /// outdated entries for a key, which we skip or re-add when processing
+  /// them.
+  std::unordered_map<data, uint64_t> deadlines_;
+};
+
+} // namespace broker::detail
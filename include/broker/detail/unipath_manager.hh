@@ -37,8 +37,15 @@ public:
 
   using super::handle;
 
+  /// Adds messages to the outbound path of this manager.
+  /// @param source The manager that produced the messages (or `nullptr`).
+  /// @param scope Visibility of the messages.
+  /// @param xs The messages for this manager, i.e., all messages with a topic
+  ///           that matches the filter of this manager.
+  /// @returns `false` if this manager has no outbound path (and no pending
+  ///          handshakes) anymore, `true` otherwise.
   virtual bool enqueue(const unipath_manager* source, item_scope scope,
-                       caf::span<const node_message> xs)
+                       caf::span<const node_message* const> xs)
     = 0;
 
   /// Returns the filter that this manager applies to enqueued items.
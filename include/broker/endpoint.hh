@@ -210,14 +210,27 @@ public:
   /// @param xs The contents of the messages.
   void publish(topic t, std::initializer_list<data> xs);
 
+  /// Publishes a batch of messages that share the same topic.
+  /// @param t The topic of the messages.
+  /// @param xs The contents of the messages.
+  /// @note Sends a single message to the core, which then dispatches the
+  ///       entire batch at once.
+  void publish(topic t, std::vector<data> xs);
+
   // Publishes the messages `x`.
   void publish(data_message x);
 
-  // Publishes all messages in `xs`.
+  /// Publishes all messages in `xs`.
+  /// @note Sends a single message to the core, which then dispatches the
+  ///       entire batch at once.
   void publish(std::vector<data_message> xs);
 
   publisher make_publisher(topic ts);
 
+  /// Returns a publisher for the topic `ts` that uses the queue implementation
+  /// `qtype` for connecting to its background worker.
+  publisher make_publisher(topic ts, publisher_queue_type qtype);
+
   /// Starts a background worker from the given set of functions that publishes
   /// a series of messages. The worker will run in the background, but `init`
   /// is guaranteed to be called before the function returns.
@@ -258,7 +271,10 @@ public:
   // --- subscribing data ------------------------------------------------------
 
   /// Returns a subscriber connected to this endpoint for the topics `ts`.
-  subscriber make_subscriber(std::vector<topic> ts, size_t max_qsize = 20u);
+  /// @param max_qsize The number of buffered items at which the subscriber
+  ///                  signals backpressure. Passing 0 selects the value of
+  ///                  `broker.subscriber.queue-size`.
+  subscriber make_subscriber(std::vector<topic> ts, size_t max_qsize = 0);
 
   /// Starts a background worker from the given set of function that consumes
   /// incoming messages. The worker will run in the background, but `init` is
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <vector>
@@ -17,16 +18,21 @@ namespace broker {
 
 struct add_command;
 struct clear_command;
+struct delta_command;
 struct endpoint_info;
 struct enum_value;
+struct erase_batch_command;
 struct erase_command;
+struct expire_batch_command;
 struct expire_command;
 struct network_info;
 struct node_message;
 struct none;
 struct peer_info;
+struct put_batch_command;
 struct put_command;
 struct put_unique_command;
+struct set_chunk_command;
 struct set_command;
 struct snapshot_command;
 struct snapshot_sync_command;
@@ -51,6 +57,7 @@ class topic;
 
 enum class backend : uint8_t;
 enum class ec : uint8_t;
+enum class publisher_queue_type : uint8_t;
 enum class sc : uint8_t;
 
 // -- STD type aliases ---------------------------------------------------------
@@ -99,13 +106,17 @@ class IdentifierUpdate;
 
 namespace broker::detail {
 
+struct key_range;
 struct retry_state;
 
 class central_dispatcher;
+class clone_view;
 class flare_actor;
 class mailbox;
 class unipath_manager;
 
+using clone_view_ptr = std::shared_ptr<clone_view>;
+
 } // namespace broker::detail
 
 // -- imported atoms -----------------------------------------------------------
@@ -181,6 +192,7 @@ CAF_BEGIN_TYPE_ID_BLOCK(broker, caf::first_custom_type_id)
   BROKER_ADD_ATOM(erase)
   BROKER_ADD_ATOM(exists)
   BROKER_ADD_ATOM(expire)
+  BROKER_ADD_ATOM(flush)
   BROKER_ADD_ATOM(increment)
   BROKER_ADD_ATOM(keys)
   BROKER_ADD_ATOM(local)
@@ -209,11 +221,16 @@ CAF_BEGIN_TYPE_ID_BLOCK(broker, caf::first_custom_type_id)
   BROKER_ADD_TYPE_ID((broker::command_message))
   BROKER_ADD_TYPE_ID((broker::data))
   BROKER_ADD_TYPE_ID((broker::data_message))
+  BROKER_ADD_TYPE_ID((broker::delta_command))
+  BROKER_ADD_TYPE_ID((broker::detail::clone_view_ptr))
+  BROKER_ADD_TYPE_ID((broker::detail::key_range))
   BROKER_ADD_TYPE_ID((broker::detail::retry_state))
   BROKER_ADD_TYPE_ID((broker::ec))
   BROKER_ADD_TYPE_ID((broker::endpoint_info))
   BROKER_ADD_TYPE_ID((broker::enum_value))
+  BROKER_ADD_TYPE_ID((broker::erase_batch_command))
   BROKER_ADD_TYPE_ID((broker::erase_command))
+  BROKER_ADD_TYPE_ID((broker::expire_batch_command))
   BROKER_ADD_TYPE_ID((broker::expire_command))
   BROKER_ADD_TYPE_ID((broker::filter_type))
   BROKER_ADD_TYPE_ID((broker::internal_command))
@@ -221,14 +238,17 @@ CAF_BEGIN_TYPE_ID_BLOCK(broker, caf::first_custom_type_id)
   BROKER_ADD_TYPE_ID((broker::node_message))
   BROKER_ADD_TYPE_ID((broker::node_message_content))
   BROKER_ADD_TYPE_ID((broker::none))
+  BROKER_ADD_TYPE_ID((broker::optional<broker::data>))
   BROKER_ADD_TYPE_ID((broker::optional<broker::timespan>))
   BROKER_ADD_TYPE_ID((broker::optional<broker::timestamp>))
   BROKER_ADD_TYPE_ID((broker::peer_info))
   BROKER_ADD_TYPE_ID((broker::port))
+  BROKER_ADD_TYPE_ID((broker::put_batch_command))
   BROKER_ADD_TYPE_ID((broker::put_command))
   BROKER_ADD_TYPE_ID((broker::put_unique_command))
   BROKER_ADD_TYPE_ID((broker::sc))
   BROKER_ADD_TYPE_ID((broker::set))
+  BROKER_ADD_TYPE_ID((broker::set_chunk_command))
   BROKER_ADD_TYPE_ID((broker::set_command))
   BROKER_ADD_TYPE_ID((broker::snapshot))
   BROKER_ADD_TYPE_ID((broker::snapshot_command))
@@ -248,6 +268,7 @@ CAF_BEGIN_TYPE_ID_BLOCK(broker, caf::first_custom_type_id)
   BROKER_ADD_TYPE_ID((caf::stream<broker::node_message_content>))
   BROKER_ADD_TYPE_ID((std::vector<broker::command_message>))
   BROKER_ADD_TYPE_ID((std::vector<broker::data_message>))
+  BROKER_ADD_TYPE_ID((std::vector<broker::internal_command>))
   BROKER_ADD_TYPE_ID((std::vector<broker::node_message>))
   BROKER_ADD_TYPE_ID((std::vector<broker::node_message_content>))
   BROKER_ADD_TYPE_ID((std::vector<broker::peer_info>))
@@ -2,6 +2,7 @@
 
 #include <utility>
 #include <unordered_map>
+#include <vector>
 
 #include <caf/actor.hpp>
 #include <caf/variant.hpp>
@@ -10,6 +11,7 @@
 #include "broker/data.hh"
 #include "broker/fwd.hh"
 #include "broker/publisher_id.hh"
+#include "broker/snapshot.hh"
 #include "broker/time.hh"
 
 namespace broker {
@@ -140,6 +142,22 @@ bool inspect(Inspector& f, set_command& x) {
   return f.object(x).fields(f.field("state", x.state));
 }
 
+/// Transfers a part of the master's state to a single clone. Masters send
+/// snapshots as a sequence of chunks in order to bound memory usage on both
+/// sides. The last chunk has `last` set and completes the snapshot.
+struct set_chunk_command {
+  snapshot state;
+  bool last;
+  /// Sequence number of the last mutation that the snapshot includes.
+  uint64_t seq;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, set_chunk_command& x) {
+  return f.object(x).fields(f.field("state", x.state),
+                            f.field("last", x.last), f.field("seq", x.seq));
+}
+
 /// Drops all values.
 struct clear_command {
   publisher_id publisher;
@@ -150,6 +168,47 @@ bool inspect(Inspector& f, clear_command& x) {
   return f.object(x).fields();
 }
 
+/// Sets multiple values in the key-value store. Masters merge consecutive
+/// `put_command` messages with the same expiry and publisher into a single
+/// batch for clones that understand batch commands. Frontends also send this
+/// command for `store::put_many`.
+struct put_batch_command {
+  std::vector<std::pair<data, data>> entries;
+  caf::optional<timespan> expiry;
+  publisher_id publisher;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, put_batch_command& x) {
+  return f.object(x).fields(f.field("entries", x.entries),
+                            f.field("expiry", x.expiry),
+                            f.field("publisher", x.publisher));
+}
+
+/// Removes multiple values from the key-value store.
+struct erase_batch_command {
+  std::vector<data> keys;
+  publisher_id publisher;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, erase_batch_command& x) {
+  return f.object(x).fields(f.field("keys", x.keys),
+                            f.field("publisher", x.publisher));
+}
+
+/// Drops multiple values because their expiration time has passed.
+struct expire_batch_command {
+  std::vector<data> keys;
+  publisher_id publisher;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, expire_batch_command& x) {
+  return f.object(x).fields(f.field("keys", x.keys),
+                            f.field("publisher", x.publisher));
+}
+
 class internal_command {
 public:
   enum class type : uint8_t {
@@ -164,13 +223,20 @@ public:
     snapshot_sync_command,
     set_command,
     clear_command,
+    put_batch_command,
+    erase_batch_command,
+    expire_batch_command,
   };
 
+  // Note: new alternatives must go to the end of the list. Otherwise, the
+  //       indexes on the wire change and clones of older versions fail to
+  //       read any command.
   using variant_type
     = caf::variant<none, put_command, put_unique_command, erase_command,
                    expire_command, add_command, subtract_command,
                    snapshot_command, snapshot_sync_command, set_command,
-                   clear_command>;
+                   clear_command, put_batch_command, erase_batch_command,
+                   expire_batch_command>;
 
   variant_type content;
 
@@ -193,6 +259,33 @@ bool inspect(Inspector& f, internal_command& x) {
   return f.object(x).fields(f.field("content", x.content));
 }
 
+/// Transfers all mutations a reconnecting clone missed to that clone. Masters
+/// send this command instead of a full snapshot as long as their mutation log
+/// still contains all commands since the last update of the clone.
+struct delta_command {
+  std::vector<internal_command> commands;
+  /// Sequence number of the last mutation in `commands`.
+  uint64_t seq;
+};
+
+template <class Inspector>
+bool inspect(Inspector& f, delta_command& x) {
+  return f.object(x).fields(f.field("commands", x.commands),
+                            f.field("seq", x.seq));
+}
+
+/// Returns how many mutations `x` represents, i.e., 1 for regular updates,
+/// the number of entries for batch commands, and 0 for all other commands.
+/// Masters and clones use this number for keeping their sequence numbers in
+/// sync.
+size_t mutation_count(const internal_command::variant_type& x);
+
+/// Merges runs of consecutive `put_command`, `erase_command` and
+/// `expire_command` entries into batch commands. Merging preserves the order
+/// of all commands and only combines commands with the same publisher (and
+/// the same expiry for `put_command`).
+void batch_commands(std::vector<internal_command>& xs);
+
 namespace detail {
 
 template <internal_command::type Value>
@@ -218,6 +311,9 @@ INTERNAL_COMMAND_TAG_ORACLE(snapshot_command);
 INTERNAL_COMMAND_TAG_ORACLE(snapshot_sync_command);
 INTERNAL_COMMAND_TAG_ORACLE(set_command);
 INTERNAL_COMMAND_TAG_ORACLE(clear_command);
+INTERNAL_COMMAND_TAG_ORACLE(put_batch_command);
+INTERNAL_COMMAND_TAG_ORACLE(erase_batch_command);
+INTERNAL_COMMAND_TAG_ORACLE(expire_batch_command);
 
 #undef INTERNAL_COMMAND_TAG_ORACLE
 
@@ -1,14 +1,18 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
 #include <caf/actor.hpp>
 #include <caf/behavior.hpp>
+#include <caf/settings.hpp>
 
 #include "broker/backend.hh"
 #include "broker/backend_options.hh"
+#include "broker/defaults.hh"
 #include "broker/detail/clone_actor.hh"
+#include "broker/detail/clone_view.hh"
 #include "broker/detail/lift.hh"
 #include "broker/detail/make_backend.hh"
 #include "broker/detail/master_actor.hh"
@@ -38,7 +42,8 @@ public:
   template <class... Ts>
   explicit data_store_manager(endpoint::clock* clock, Ts&&... xs)
     : super(std::forward<Ts>(xs)...), clock_(clock) {
-    // nop
+    super::dispatcher_.on_sinks_changed(
+      [this] { update_store_event_subscribers(); });
   }
 
   // -- properties -------------------------------------------------------------
@@ -73,22 +78,33 @@ public:
       BROKER_WARNING("remote master with same name exists already");
       return ec::master_exists;
     }
-    auto ptr = detail::make_backend(backend_type, std::move(opts));
-    if (!ptr)
+    auto backends = detail::make_backends(backend_type, std::move(opts));
+    if (backends.empty())
       return ec::backend_failure;
-    BROKER_INFO("spawning new master:" << name);
+    BROKER_INFO("spawning new master:" << name << "with" << backends.size()
+                                       << "shard(s)");
     auto self = super::self();
-    auto ms = self->template spawn<spawn_flags>(detail::master_actor, self,
-                                                name, std::move(ptr), clock_);
+    caf::actor ms;
+    if (backends.size() == 1)
+      ms = self->template spawn<spawn_flags>(detail::master_actor, self, name,
+                                             std::move(backends.front()),
+                                             clock_);
+    else
+      ms = self->template spawn<spawn_flags>(detail::sharded_master_actor,
+                                             self, name, std::move(backends),
+                                             clock_);
     filter_type filter{name / topics::master_suffix};
     if (auto err = dref().add_store(ms, filter))
       return err;
     masters_.emplace(name, ms);
+    update_store_event_subscribers(name, ms);
     return ms;
   }
 
-  /// Attaches a clone for given store to this peer.
-  caf::result<caf::actor>
+  /// Attaches a clone for given store to this peer. Also returns the view
+  /// for reading the content of the clone from other threads, or `nullptr`
+  /// if `broker.store.clone-local-reads` is disabled.
+  caf::result<caf::actor, detail::clone_view_ptr>
   attach_clone(const std::string& name, double resync_interval,
                double stale_interval, double mutation_buffer_interval) {
     BROKER_TRACE(BROKER_ARG(name)
@@ -99,18 +115,24 @@ public:
       return ec::no_such_master;
     }
     if (auto i = clones_.find(name); i != clones_.end())
-      return i->second;
+      return {i->second, clone_views_[name]};
     BROKER_INFO("spawning new clone:" << name);
     auto self = super::self();
+    detail::clone_view_ptr view;
+    if (caf::get_or(self->system().config(), "broker.store.clone-local-reads",
+                    defaults::store::clone_local_reads))
+      view = std::make_shared<detail::clone_view>();
     auto cl = self->template spawn<spawn_flags>(detail::clone_actor, self, name,
                                                 resync_interval, stale_interval,
                                                 mutation_buffer_interval,
-                                                clock_);
+                                                clock_, view);
     filter_type filter{name / topics::clone_suffix};
     if (auto err = dref().add_store(cl, filter))
       return err;
     clones_.emplace(name, cl);
-    return cl;
+    clone_views_.emplace(name, view);
+    update_store_event_subscribers(name, cl);
+    return {std::move(cl), std::move(view)};
   }
 
   /// Returns whether the master for the given store runs at this peer.
@@ -139,6 +161,29 @@ public:
     };
     f(masters_);
     f(clones_);
+    clone_views_.clear();
+    store_event_subscribers_.clear();
+  }
+
+  /// Tells the store `name` whether any local subscriber receives its events,
+  /// unless the store already knows.
+  void update_store_event_subscribers(const std::string& name,
+                                      const caf::actor& hdl) {
+    auto flag = super::dispatcher_.has_local_subscriber(topics::store_events
+                                                        / name);
+    auto [i, added] = store_event_subscribers_.emplace(name, flag);
+    if (added || i->second != flag) {
+      i->second = flag;
+      super::self()->send(hdl, atom::subscriptions_v, flag);
+    }
+  }
+
+  /// Tells all stores whether any local subscriber receives their events.
+  void update_store_event_subscribers() {
+    for (auto& [name, hdl] : masters_)
+      update_store_event_subscribers(name, hdl);
+    for (auto& [name, hdl] : clones_)
+      update_store_event_subscribers(name, hdl);
   }
 
   // -- factories --------------------------------------------------------------
@@ -195,6 +240,14 @@ protected:
 
   /// Stores all clone actors created by this core.
   std::unordered_map<std::string, caf::actor> clones_;
+
+  /// Stores the view of each clone in `clones_` or `nullptr` if the clone has
+  /// none.
+  std::unordered_map<std::string, detail::clone_view_ptr> clone_views_;
+
+  /// Stores the last flag we have sent to each store via
+  /// `update_store_event_subscribers`.
+  std::unordered_map<std::string, bool> store_event_subscribers_;
 };
 
 } // namespace broker::mixin
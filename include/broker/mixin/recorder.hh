@@ -2,6 +2,7 @@
 
 #include "broker/detail/core_recorder.hh"
 #include "broker/filter_type.hh"
+#include "broker/message.hh"
 
 namespace broker::mixin {
 
@@ -29,6 +30,16 @@ public:
     super::ship(msg);
   }
 
+  template <class T>
+  void ship(std::vector<T>& msgs) {
+    for (auto& msg : msgs) {
+      if (!rec_)
+        break;
+      rec_.try_record(msg);
+    }
+    super::ship(msgs);
+  }
+
   void ship(data_message& msg, const communication_handle_type& receiver) {
     // TODO: extend recording interface to cover direct messages
     super::ship(msg, receiver);
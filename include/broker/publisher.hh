@@ -5,15 +5,29 @@
 #include <vector>
 
 #include <caf/actor.hpp>
+#include <caf/variant.hpp>
 
 #include "broker/atoms.hh"
 #include "broker/fwd.hh"
 #include "broker/message.hh"
 
 #include "broker/detail/shared_publisher_queue.hh"
+#include "broker/detail/spsc_publisher_queue.hh"
 
 namespace broker {
 
+/// Selects the queue implementation that connects a @ref publisher to its
+/// background worker.
+enum class publisher_queue_type : uint8_t {
+  /// Guards a deque with a mutex. Allows sharing the publisher between
+  /// multiple threads.
+  locked,
+  /// Uses a lock-free ring buffer. Requires that only a single thread at a
+  /// time publishes data through the publisher. Always has a fixed capacity,
+  /// i.e., ignores `broker.publisher.max-queue-size`.
+  lock_free,
+};
+
 /// Provides asynchronous publishing of data with demand management.
 class publisher {
 public:
@@ -27,6 +41,9 @@ public:
 
   using guard_type = std::unique_lock<std::mutex>;
 
+  using queue_ptr = caf::variant<detail::shared_publisher_queue_ptr<>,
+                                 detail::spsc_publisher_queue_ptr<>>;
+
   // --- constructors and destructors ------------------------------------------
 
   publisher(publisher&&) = default;
@@ -49,7 +66,10 @@ public:
   /// Returns the current size of the output queue.
   size_t buffered() const;
 
-  /// Returns the capacity of the output queue.
+  /// Returns the current capacity of the output queue. The capacity starts at
+  /// `broker.publisher.queue-size` and grows up to
+  /// `broker.publisher.max-queue-size` while the publisher keeps hitting the
+  /// limit, shrinking again once the queue runs idle.
   size_t capacity() const;
 
   /// Returns the free capacity of the output queue, i.e., how many items can
@@ -68,7 +88,7 @@ public:
   /// Returns a file handle for integrating this publisher into a `select` or
   /// `poll` loop.
   auto fd() const {
-    return queue_->fd();
+    return visit_queue([](auto& q) { return q.fd(); });
   }
 
   // --- mutators --------------------------------------------------------------
@@ -101,10 +121,17 @@ public:
 
 private:
   // -- force users to use `endpoint::make_publsiher` -------------------------
-  publisher(endpoint& ep, topic t);
+  publisher(endpoint& ep, topic t,
+            publisher_queue_type qtype = publisher_queue_type::locked);
+
+  template <class F>
+  auto visit_queue(F f) const {
+    auto g = [&f](const auto& ptr) { return f(*ptr); };
+    return caf::visit(g, queue_);
+  }
 
   bool drop_on_destruction_;
-  detail::shared_publisher_queue_ptr<> queue_;
+  queue_ptr queue_;
   caf::actor worker_;
   topic topic_;
 };
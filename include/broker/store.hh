@@ -1,6 +1,9 @@
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <caf/actor.hpp>
@@ -13,6 +16,7 @@
 #include "broker/api_flags.hh"
 #include "broker/atoms.hh"
 #include "broker/data.hh"
+#include "broker/detail/blocking_requester.hh"
 #include "broker/fwd.hh"
 #include "broker/mailbox.hh"
 #include "broker/message.hh"
@@ -34,6 +38,11 @@ public:
 
   using stream_type = caf::stream<command_message>;
 
+  /// Receives one page of a range or prefix query. The page contains at most
+  /// `broker.store.range-page-size` entries. Returning `false` stops the
+  /// query after this page.
+  using page_handler = std::function<bool(table& page)>;
+
   /// A response to a lookup request issued by a ::proxy.
   struct response {
     expected<data> answer;
@@ -60,6 +69,18 @@ public:
     /// response.
     request_id get(data key);
 
+    /// Performs a request to check existence of multiple keys at once.
+    /// @param keys The keys to check.
+    /// @returns A unique identifier for this request to correlate it with a
+    /// response.
+    request_id exists_many(std::vector<data> keys);
+
+    /// Performs a request to retrieve multiple values at once.
+    /// @param keys The keys of the values to retrieve.
+    /// @returns A unique identifier for this request to correlate it with a
+    /// response.
+    request_id get_many(std::vector<data> keys);
+
     /// Inserts a value if the key does not already exist.
     /// @param key The key of the key-value pair.
     /// @param value The value of the key-value pair.
@@ -115,13 +136,30 @@ public:
 
   /// Checks whether a key exists in the store.
   /// @returns A boolean that's if the key exists.
+  /// @note Clones answer on the calling thread from their latest published
+  ///       content if `broker.store.clone-local-reads` is enabled.
   expected<data> exists(data key) const;
 
   /// Retrieves a value.
   /// @param key The key of the value to retrieve.
   /// @returns The value under *key* or an error.
+  /// @note Clones answer on the calling thread from their latest published
+  ///       content if `broker.store.clone-local-reads` is enabled.
   expected<data> get(data key) const;
 
+  /// Checks whether multiple keys exist in the store. Needs only a single
+  /// round trip to the frontend.
+  /// @param keys The keys to check.
+  /// @returns A vector of booleans with one entry per key, in order.
+  expected<data> exists_many(std::vector<data> keys) const;
+
+  /// Retrieves multiple values at once. Needs only a single round trip to the
+  /// frontend.
+  /// @param keys The keys of the values to retrieve.
+  /// @returns A table with the key-value pairs for all keys that exist. Omits
+  ///          keys that do not exist.
+  expected<data> get_many(std::vector<data> keys) const;
+
   /// Inserts a value if the key does not already exist.
   /// @param key The key of the key-value pair.
   /// @param value The value of the key-value pair.
@@ -130,6 +168,44 @@ public:
   expected<data> put_unique(data key, data value,
                             optional<timespan> expiry = {}) const;
 
+  /// Retrieves all key-value pairs with keys in `[lo, hi)` in the order of
+  /// `data`. The frontend sends the result in pages of at most
+  /// `broker.store.range-page-size` entries, but this function collects all
+  /// pages before returning. Use `for_each_range_page` for large ranges.
+  /// @param lo The smallest key to retrieve.
+  /// @param hi The first key past the range.
+  /// @returns A table with all key-value pairs in the range.
+  expected<data> get_range(data lo, data hi) const;
+
+  /// Retrieves all key-value pairs with keys that start with `prefix`. String
+  /// prefixes select string keys and vector prefixes select vector keys with
+  /// the same leading elements. The frontend sends the result in pages of at
+  /// most `broker.store.range-page-size` entries, but this function collects
+  /// all pages before returning. Use `for_each_prefix_page` for large
+  /// results.
+  /// @param prefix The common prefix of all keys to retrieve.
+  /// @returns A table with all matching key-value pairs.
+  expected<data> get_prefix(data prefix) const;
+
+  /// Passes all key-value pairs with keys in `[lo, hi)` to `f`, one page at a
+  /// time in ascending key order. Only requests the next page after `f`
+  /// returned, i.e., keeps at most one page in memory.
+  /// @param lo The smallest key to retrieve.
+  /// @param hi The first key past the range.
+  /// @param f Receives each page.
+  /// @returns `nil` after the last page or after `f` returned `false`.
+  expected<void> for_each_range_page(data lo, data hi,
+                                     const page_handler& f) const;
+
+  /// Passes all key-value pairs with keys that start with `prefix` to `f`,
+  /// one page at a time in ascending key order. Only requests the next page
+  /// after `f` returned, i.e., keeps at most one page in memory.
+  /// @param prefix The common prefix of all keys to retrieve.
+  /// @param f Receives each page.
+  /// @returns `nil` after the last page or after `f` returned `false`.
+  expected<void> for_each_prefix_page(data prefix,
+                                      const page_handler& f) const;
+
   /// For containers values, retrieves a specific index from the value. This
   /// is supported for sets, tables, and vectors.
   /// @param key The key of the value to retrieve the index from.
@@ -160,6 +236,12 @@ public:
   /// @param expiry An optional expiration time for *key*.
   void put(data key, data value, optional<timespan> expiry = {}) const;
 
+  /// Inserts or updates multiple values in a single command.
+  /// @param entries The key-value pairs to store.
+  /// @param expiry An optional expiration time for all keys.
+  void put_many(std::vector<std::pair<data, data>> entries,
+                optional<timespan> expiry = {}) const;
+
   /// Removes the value associated with a given key.
   /// @param key The key to remove from the store.
   void erase(data key) const;
@@ -265,7 +347,8 @@ public:
   void reset();
 
 private:
-  store(caf::actor actor, std::string name);
+  store(caf::actor actor, std::string name,
+        detail::clone_view_ptr view = nullptr);
 
   /// Adds a value to another one, with a type-specific meaning of
   /// "add". This is the backend for a number of the modifiers methods.
@@ -282,26 +365,30 @@ private:
   /// @param expiry An optional new expiration time for *key*.
   void subtract(data key, data value, optional<timespan> expiry = {}) const;
 
-  template <class T, class... Ts>
-  expected<T> request(Ts&&... xs) const {
-    if (!frontend_)
+  /// Collects all pages of `range` into a single table.
+  expected<data> get_pages(detail::key_range range) const;
+
+  /// Requests the pages of `range` one by one and passes each to `f`.
+  expected<void> for_each_page(detail::key_range range,
+                               const page_handler& f) const;
+
+  template <class... Ts>
+  expected<data> request(Ts&&... xs) const {
+    if (!requester_)
       return make_error(ec::unspecified, "store not initialized");
-    expected<T> res{ec::unspecified};
-    caf::scoped_actor self{frontend_->home_system()};
-    auto msg = caf::make_message(std::forward<Ts>(xs)...);
-    self->request(frontend_, timeout::frontend, std::move(msg)).receive(
-      [&](T& x) {
-        res = std::move(x);
-      },
-      [&](caf::error& e) {
-        res = std::move(e);
-      }
-    );
-    return res;
+    return requester_->request(std::forward<Ts>(xs)...);
   }
 
   caf::actor frontend_;
   std::string name_;
+
+  /// Performs all blocking requests of this store and its copies.
+  std::shared_ptr<detail::blocking_requester> requester_;
+
+  /// Allows clones to answer `get` and `exists` without a request to the
+  /// frontend. Remains `nullptr` for masters and for clones without local
+  /// reads.
+  detail::clone_view_ptr view_;
 };
 
 } // namespace broker
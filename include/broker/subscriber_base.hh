@@ -85,16 +85,13 @@ public:
       return result;
     if (timeout <= std::chrono::system_clock::now())
       return result;
-    result.reserve(num);
     for (;;) {
       if (!queue_->wait_on_flare_abs(timeout))
         return result;
       size_t prev_size = 0;
       auto remaining = num - result.size();
-      auto got = queue_->consume(remaining, &prev_size, [&](value_type&& x) {
-        BROKER_DEBUG("received" << x);
-        result.emplace_back(std::move(x));
-      });
+      auto got = queue_->consume(remaining, &prev_size, result);
+      BROKER_DEBUG("received" << got << "values");
       if (prev_size >= static_cast<size_t>(max_qsize_)
           && prev_size - got < static_cast<size_t>(max_qsize_))
         became_not_full();
@@ -117,15 +114,12 @@ public:
     std::vector<value_type> result;
     if (num == 0)
       return result;
-    result.reserve(num);
     for (;;) {
       queue_->wait_on_flare();
       size_t prev_size = 0;
       auto remaining = num - result.size();
-      auto got = queue_->consume(remaining, &prev_size, [&](value_type&& x) {
-        BROKER_DEBUG("received" << x);
-        result.emplace_back(std::move(x));
-      });
+      auto got = queue_->consume(remaining, &prev_size, result);
+      BROKER_DEBUG("received" << got << "values");
       if (prev_size >= static_cast<size_t>(max_qsize_)
           && prev_size - got < static_cast<size_t>(max_qsize_))
         became_not_full();
@@ -18,6 +18,8 @@
 #include "broker/config.hh"
 #include "broker/core_actor.hh"
 #include "broker/data.hh"
+#include "broker/detail/clone_view.hh"
+#include "broker/detail/key_range.hh"
 #include "broker/endpoint.hh"
 #include "broker/internal_command.hh"
 #include "broker/port.hh"
@@ -91,6 +93,43 @@ configuration::configuration(skip_init_t) {
                  "maximum number of entries when recording published messages")
     .add<size_t>("max-pending-inputs-per-source",
                  "maximum number of items we buffer per peer or publisher");
+  opt_group{custom_options_, "?broker.publisher"}
+    .add<size_t>("queue-size",
+                 "number of items a publisher buffers before blocking")
+    .add<size_t>("max-queue-size",
+                 "upper bound for adaptive publisher buffers (disabled if "
+                 "not greater than queue-size)")
+    .add<size_t>("rate-sample-size",
+                 "number of seconds to average the publisher send rate over");
+  opt_group{custom_options_, "?broker.store"}
+    .add<size_t>("snapshot-chunk-size",
+                 "maximum number of entries per message when sending "
+                 "snapshots from masters to clones")
+    .add<size_t>("snapshot-credit",
+                 "maximum number of snapshot chunks a master sends to a "
+                 "clone before waiting for an acknowledgement")
+    .add<size_t>("mutation-log-size",
+                 "number of recent updates masters keep for bringing "
+                 "reconnecting clones up to date (disabled if 0)")
+    .add<caf::timespan>("expiry-resolution",
+                        "granularity of expiration times; masters expire "
+                        "keys in batches at most once per interval")
+    .add<caf::timespan>("batch-window",
+                        "time masters collect updates before sending them "
+                        "to clones in batches (disabled if 0)")
+    .add<size_t>("range-page-size",
+                 "maximum number of entries per response to range and "
+                 "prefix queries")
+    .add<bool>("clone-local-reads",
+               "answer get and exists on clones from a snapshot on the "
+               "calling thread instead of asking the clone actor");
+  opt_group{custom_options_, "?broker.subscriber"}
+    .add<size_t>("queue-size",
+                 "number of items a subscriber buffers before signaling "
+                 "backpressure")
+    .add<size_t>("rate-sample-size",
+                 "number of seconds to average the subscriber receive rate "
+                 "over");
   // Ensure that we're only talking to compatible Broker instances.
   std::vector<std::string> ids{"broker.v" + std::to_string(version::protocol)};
   // Override CAF defaults.
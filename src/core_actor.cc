@@ -196,6 +196,22 @@ caf::behavior core_state::make_behavior() {
       BROKER_TRACE(BROKER_ARG(x));
       publish(std::move(x));
     },
+    [=](atom::publish, std::vector<data_message>& xs) {
+      BROKER_TRACE(BROKER_ARG2("xs.size", xs.size()));
+      publish(std::move(xs));
+    },
+    [=](atom::publish, std::vector<command_message>& xs) {
+      BROKER_TRACE(BROKER_ARG2("xs.size", xs.size()));
+      publish(std::move(xs));
+    },
+    [=](atom::publish, topic& t, std::vector<data>& xs) {
+      BROKER_TRACE(BROKER_ARG(t) << BROKER_ARG2("xs.size", xs.size()));
+      std::vector<data_message> msgs;
+      msgs.reserve(xs.size());
+      for (auto& x : xs)
+        msgs.emplace_back(make_data_message(t, std::move(x)));
+      publish(std::move(msgs));
+    },
     // --- communication to local actors only, i.e., never forward to peers ----
     [=](atom::publish, atom::local, data_message& x) {
       BROKER_TRACE(BROKER_ARG(x));
@@ -17,4 +17,10 @@ namespace broker::defaults::store {
 
 const caf::timespan tick_interval = 50ms;
 
+const caf::timespan sqlite_batch_interval = 100ms;
+
+const caf::timespan expiry_resolution = 100ms;
+
+const caf::timespan batch_window = 0ms;
+
 } // namespace broker::defaults::store
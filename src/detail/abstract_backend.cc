@@ -1,5 +1,10 @@
 #include "broker/detail/appliers.hh"
 #include "broker/detail/abstract_backend.hh"
+#include "broker/detail/key_range.hh"
+
+#include <iterator>
+#include <map>
+#include <unordered_map>
 
 namespace broker {
 namespace detail {
@@ -31,6 +36,76 @@ expected<void> abstract_backend::subtract(const data& key, const data& value,
   return put(key, *v, expiry);
 }
 
+expected<optional<data>>
+abstract_backend::put_returning_old(const data& key, data value,
+                                    optional<timestamp> expiry) {
+  optional<data> old_value;
+  if (auto v = get(key))
+    old_value = std::move(*v);
+  else if (v.error() != ec::no_such_key)
+    return v.error();
+  if (auto res = put(key, std::move(value), expiry); !res)
+    return res.error();
+  return old_value;
+}
+
+expected<data> abstract_backend::add_returning_new(const data& key,
+                                                   const data& value,
+                                                   data::type init_type,
+                                                   optional<timestamp> expiry,
+                                                   optional<data>* old_value) {
+  auto v = get(key);
+  if (!v) {
+    if (v.error() != ec::no_such_key)
+      return v;
+    v = expected<data>{data::from_type(init_type)};
+    if (old_value)
+      *old_value = nil;
+  } else if (old_value) {
+    *old_value = *v;
+  }
+  if (auto res = caf::visit(adder{value}, *v); !res)
+    return res.error();
+  if (auto res = put(key, *v, expiry); !res)
+    return res.error();
+  return v;
+}
+
+expected<data> abstract_backend::subtract_returning_new(
+  const data& key, const data& value, optional<timestamp> expiry,
+  data* old_value) {
+  auto v = get(key);
+  if (!v)
+    return v;
+  if (old_value)
+    *old_value = *v;
+  if (auto res = caf::visit(remover{value}, *v); !res)
+    return res.error();
+  if (auto res = put(key, *v, expiry); !res)
+    return res.error();
+  return v;
+}
+
+expected<std::vector<data>>
+abstract_backend::expire_due(timestamp current_time) {
+  std::vector<data> due;
+  auto res = for_each_expiry([&](const data& key, timestamp expiry) {
+    if (expiry <= current_time)
+      due.emplace_back(key);
+  });
+  if (!res)
+    return res.error();
+  std::vector<data> result;
+  for (auto& key : due) {
+    auto expired = expire(key, current_time);
+    if (!expired)
+      return expired.error();
+    if (*expired)
+      result.emplace_back(std::move(key));
+  }
+  return {std::move(result)};
+}
+
 expected<data> abstract_backend::get(const data& key, const data& value) const {
   auto k = get(key);
   if (!k)
@@ -38,5 +113,109 @@ expected<data> abstract_backend::get(const data& key, const data& value) const {
   return caf::visit(retriever{value}, *k);
 }
 
+expected<data>
+abstract_backend::get_many(const std::vector<data>& keys) const {
+  table result;
+  for (auto& key : keys) {
+    if (auto x = get(key))
+      result.emplace(key, std::move(*x));
+    else if (x.error() != ec::no_such_key)
+      return x.error();
+  }
+  return {std::move(result)};
+}
+
+expected<data>
+abstract_backend::exists_many(const std::vector<data>& keys) const {
+  vector result;
+  result.reserve(keys.size());
+  for (auto& key : keys) {
+    auto x = exists(key);
+    if (!x)
+      return x.error();
+    result.emplace_back(*x);
+  }
+  return {std::move(result)};
+}
+
+optional<timespan> abstract_backend::batch_interval() const {
+  return nil;
+}
+
+expected<void> abstract_backend::flush() {
+  return {};
+}
+
+expected<void> abstract_backend::for_each(const entry_visitor& f) const {
+  auto ss = snapshot();
+  if (!ss)
+    return ss.error();
+  auto es = expiries();
+  if (!es)
+    return es.error();
+  std::unordered_map<data, timestamp> expiry_map;
+  for (auto& [key, expiry] : *es)
+    expiry_map.emplace(std::move(key), expiry);
+  for (auto& [key, value] : *ss) {
+    optional<timestamp> expiry;
+    if (auto i = expiry_map.find(key); i != expiry_map.end())
+      expiry = i->second;
+    f(key, value, expiry);
+  }
+  return {};
+}
+
+expected<void> abstract_backend::for_each_expiry(const expiry_visitor& f) const {
+  auto es = expiries();
+  if (!es)
+    return es.error();
+  for (auto& [key, expiry] : *es)
+    f(key, expiry);
+  return {};
+}
+
+expected<scan_result> abstract_backend::scan(const optional<data>& begin_key,
+                                             size_t limit) const {
+  // Keep one more entry than fits into the page for determining the first key
+  // of the next page.
+  std::map<data, data> entries;
+  auto res = for_each([&](const data& key, data& value, optional<timestamp>) {
+    if (begin_key && key < *begin_key)
+      return;
+    if (entries.size() <= limit) {
+      entries.emplace(key, std::move(value));
+      return;
+    }
+    auto last = std::prev(entries.end());
+    if (key < last->first) {
+      entries.erase(last);
+      entries.emplace(key, std::move(value));
+    }
+  });
+  if (!res)
+    return res.error();
+  scan_result result;
+  if (entries.size() > limit) {
+    auto last = std::prev(entries.end());
+    result.next = last->first;
+    entries.erase(last);
+  }
+  result.entries.reserve(entries.size());
+  for (auto& kvp : entries)
+    result.entries.emplace_back(kvp.first, std::move(kvp.second));
+  return {std::move(result)};
+}
+
+expected<scan_result> abstract_backend::range(const key_range& range,
+                                              size_t limit) const {
+  range_page_builder page{range, limit};
+  auto res = for_each([&](const data& key, data& value, optional<timestamp>) {
+    page.add(key, value);
+  });
+  if (!res)
+    return res.error();
+  return std::move(page).build();
+}
+
 } // namespace detail
 } // namespace broker
@@ -0,0 +1,85 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include "broker/detail/blocking_requester.hh"
+
+#include <chrono>
+
+#include <caf/actor_cast.hpp>
+#include <caf/actor_system.hpp>
+#include <caf/after.hpp>
+#include <caf/error.hpp>
+#include <caf/send.hpp>
+
+#include "broker/detail/flare_actor.hh"
+#include "broker/error.hh"
+#include "broker/timeout.hh"
+
+namespace broker::detail {
+
+blocking_requester::blocking_requester(caf::actor frontend)
+  : frontend_(std::move(frontend)) {
+  self_ = frontend_.home_system().spawn<flare_actor>();
+}
+
+void blocking_requester::send(caf::message msg) {
+  caf::send_as(self_, frontend_, std::move(msg));
+}
+
+expected<data> blocking_requester::await(request_id id) {
+  auto deadline = clock_type::now() + timeout::frontend;
+  std::unique_lock<std::mutex> guard{mtx_};
+  for (;;) {
+    auto i = pending_.find(id);
+    if (i->second.done) {
+      auto result = std::move(i->second.result);
+      pending_.erase(i);
+      return result;
+    }
+    if (clock_type::now() >= deadline) {
+      pending_.erase(i);
+      return caf::make_error(caf::sec::request_timeout);
+    }
+    if (receiving_) {
+      cv_.wait_until(guard, deadline);
+      continue;
+    }
+    receiving_ = true;
+    guard.unlock();
+    receive_one(deadline);
+    guard.lock();
+    receiving_ = false;
+    // Wakes up threads with a response as well as a thread that takes over
+    // receiving.
+    cv_.notify_all();
+  }
+}
+
+void blocking_requester::receive_one(clock_type::time_point deadline) {
+  auto now = clock_type::now();
+  if (now >= deadline)
+    return;
+  auto deliver = [this](request_id rid, expected<data> x) {
+    std::unique_lock<std::mutex> guard{mtx_};
+    if (auto i = pending_.find(rid); i != pending_.end()) {
+      i->second.result = std::move(x);
+      i->second.done = true;
+    } else {
+      BROKER_DEBUG("drop late response for request" << rid);
+    }
+  };
+  auto fa = caf::actor_cast<flare_actor*>(self_);
+  fa->receive(
+    [&](data& x, request_id rid) {
+      fa->extinguish_one();
+      deliver(rid, std::move(x));
+    },
+    [&](caf::error& e, request_id rid) {
+      fa->extinguish_one();
+      deliver(rid, std::move(e));
+    },
+    caf::after(deadline - now) >> [] {
+      // The caller checks the deadline.
+    });
+}
+
+} // namespace broker::detail
@@ -0,0 +1,229 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include "broker/detail/caching_backend.hh"
+
+#include <utility>
+
+#include <caf/telemetry/counter.hpp>
+
+#include "broker/detail/assert.hh"
+#include "broker/error.hh"
+
+namespace broker::detail {
+
+caching_backend::caching_backend(std::unique_ptr<abstract_backend> backend,
+                                 size_t capacity)
+  : backend_(std::move(backend)), capacity_(capacity) {
+  BROKER_ASSERT(backend_ != nullptr);
+  BROKER_ASSERT(capacity_ > 0);
+}
+
+caching_backend::~caching_backend() {
+  BROKER_DEBUG("cache statistics:" << BROKER_ARG(hits_) << BROKER_ARG(misses_));
+}
+
+// -- modifiers ----------------------------------------------------------------
+
+expected<void> caching_backend::put(const data& key, data value,
+                                    optional<timestamp> expiry) {
+  invalidate(key);
+  return backend_->put(key, std::move(value), expiry);
+}
+
+expected<void> caching_backend::add(const data& key, const data& value,
+                                    data::type init_type,
+                                    optional<timestamp> expiry) {
+  invalidate(key);
+  return backend_->add(key, value, init_type, expiry);
+}
+
+expected<void> caching_backend::subtract(const data& key, const data& value,
+                                         optional<timestamp> expiry) {
+  invalidate(key);
+  return backend_->subtract(key, value, expiry);
+}
+
+expected<optional<data>>
+caching_backend::put_returning_old(const data& key, data value,
+                                   optional<timestamp> expiry) {
+  invalidate(key);
+  return backend_->put_returning_old(key, std::move(value), expiry);
+}
+
+expected<data> caching_backend::add_returning_new(const data& key,
+                                                  const data& value,
+                                                  data::type init_type,
+                                                  optional<timestamp> expiry,
+                                                  optional<data>* old_value) {
+  invalidate(key);
+  auto result = backend_->add_returning_new(key, value, init_type, expiry,
+                                            old_value);
+  if (result)
+    insert(key, true, *result);
+  return result;
+}
+
+expected<data>
+caching_backend::subtract_returning_new(const data& key, const data& value,
+                                        optional<timestamp> expiry,
+                                        data* old_value) {
+  invalidate(key);
+  auto result = backend_->subtract_returning_new(key, value, expiry, old_value);
+  if (result)
+    insert(key, true, *result);
+  return result;
+}
+
+expected<void> caching_backend::erase(const data& key) {
+  invalidate(key);
+  return backend_->erase(key);
+}
+
+expected<void> caching_backend::clear() {
+  entries_.clear();
+  lru_.clear();
+  return backend_->clear();
+}
+
+expected<bool> caching_backend::expire(const data& key,
+                                       timestamp current_time) {
+  auto result = backend_->expire(key, current_time);
+  if (!result || *result)
+    invalidate(key);
+  return result;
+}
+
+expected<std::vector<data>>
+caching_backend::expire_due(timestamp current_time) {
+  auto result = backend_->expire_due(current_time);
+  if (result)
+    for (auto& key : *result)
+      invalidate(key);
+  return result;
+}
+
+// -- inspectors ---------------------------------------------------------------
+
+expected<data> caching_backend::get(const data& key) const {
+  if (auto e = lookup(key); e && (e->value || !e->found)) {
+    hit();
+    if (e->value)
+      return *e->value;
+    return ec::no_such_key;
+  }
+  miss();
+  auto result = backend_->get(key);
+  if (result)
+    insert(key, true, *result);
+  else if (result.error() == ec::no_such_key)
+    insert(key, false, nil);
+  return result;
+}
+
+expected<bool> caching_backend::exists(const data& key) const {
+  if (auto e = lookup(key)) {
+    hit();
+    return e->found;
+  }
+  miss();
+  auto result = backend_->exists(key);
+  if (result)
+    insert(key, *result, nil);
+  return result;
+}
+
+expected<uint64_t> caching_backend::size() const {
+  return backend_->size();
+}
+
+expected<data> caching_backend::keys() const {
+  return backend_->keys();
+}
+
+expected<broker::snapshot> caching_backend::snapshot() const {
+  return backend_->snapshot();
+}
+
+expected<expirables> caching_backend::expiries() const {
+  return backend_->expiries();
+}
+
+// -- batching -----------------------------------------------------------------
+
+optional<timespan> caching_backend::batch_interval() const {
+  return backend_->batch_interval();
+}
+
+expected<void> caching_backend::flush() {
+  return backend_->flush();
+}
+
+// -- cursors ------------------------------------------------------------------
+
+expected<void> caching_backend::for_each(const entry_visitor& f) const {
+  return backend_->for_each(f);
+}
+
+expected<void>
+caching_backend::for_each_expiry(const expiry_visitor& f) const {
+  return backend_->for_each_expiry(f);
+}
+
+expected<scan_result> caching_backend::scan(const optional<data>& begin_key,
+                                            size_t limit) const {
+  return backend_->scan(begin_key, limit);
+}
+
+expected<scan_result> caching_backend::range(const key_range& range,
+                                             size_t limit) const {
+  return backend_->range(range, limit);
+}
+
+// -- cache management ---------------------------------------------------------
+
+const caching_backend::entry* caching_backend::lookup(const data& key) const {
+  auto i = entries_.find(key);
+  if (i == entries_.end())
+    return nullptr;
+  lru_.splice(lru_.begin(), lru_, i->second.pos);
+  return &i->second;
+}
+
+void caching_backend::insert(const data& key, bool found,
+                             optional<data> value) const {
+  if (auto i = entries_.find(key); i != entries_.end()) {
+    // Only happens when `get` fills in the value after `exists`.
+    i->second.found = found;
+    i->second.value = std::move(value);
+    return;
+  }
+  if (entries_.size() >= capacity_) {
+    auto victim = lru_.back();
+    lru_.pop_back();
+    entries_.erase(*victim);
+  }
+  auto i = entries_.emplace(key, entry{found, std::move(value), {}}).first;
+  lru_.push_front(&i->first);
+  i->second.pos = lru_.begin();
+}
+
+void caching_backend::hit() const {
+  ++hits_;
+  if (hits_metric_)
+    hits_metric_->inc();
+}
+
+void caching_backend::miss() const {
+  ++misses_;
+  if (misses_metric_)
+    misses_metric_->inc();
+}
+
+void caching_backend::invalidate(const data& key) {
+  if (auto i = entries_.find(key); i != entries_.end()) {
+    lru_.erase(i->second.pos);
+    entries_.erase(i);
+  }
+}
+
+} // namespace broker::detail
@@ -1,5 +1,7 @@
 #include "broker/detail/central_dispatcher.hh"
 
+#include <algorithm>
+
 #include "broker/logger.hh"
 #include "broker/message.hh"
 
@@ -15,12 +17,67 @@ void central_dispatcher::enqueue(const unipath_manager* source,
                                  caf::span<const node_message> xs) {
   BROKER_DEBUG("central enqueue" << BROKER_ARG(scope)
                                  << BROKER_ARG2("xs.size", xs.size()));
-  auto f = [&](auto& sink) { return !sink->enqueue(source, scope, xs); };
-  sinks_.erase(std::remove_if(sinks_.begin(), sinks_.end(), f), sinks_.end());
+  // Select the receivers for each message with a single index lookup.
+  for (auto& kvp : selections_)
+    kvp.second.clear();
+  for (const auto& x : xs) {
+    index_.for_each_match(get_topic(x), [&](const unipath_manager* mgr) {
+      auto& sel = selections_[mgr];
+      if (sel.empty() || sel.back() != &x)
+        sel.emplace_back(&x);
+    });
+  }
+  // Hand the pre-filtered messages to the sinks. Managers that return false
+  // no longer have a path and we drop them.
+  auto f = [&](auto& sink) {
+    auto ptr = sink.get();
+    auto i = selections_.find(ptr);
+    bool keep;
+    if (i != selections_.end())
+      keep = sink->enqueue(source, scope, i->second);
+    else
+      keep = sink->enqueue(source, scope, {});
+    if (!keep) {
+      index_.erase(ptr, sink->filter());
+      if (i != selections_.end())
+        selections_.erase(i);
+    }
+    return !keep;
+  };
+  auto e = std::remove_if(sinks_.begin(), sinks_.end(), f);
+  if (e != sinks_.end()) {
+    sinks_.erase(e, sinks_.end());
+    sinks_changed();
+  }
 }
 
 void central_dispatcher::add(unipath_manager_ptr sink) {
+  index_.add(sink.get(), sink->filter());
   sinks_.emplace_back(std::move(sink));
+  sinks_changed();
+}
+
+void central_dispatcher::filter_changed(const unipath_manager* sink,
+                                        const filter_type& old_filter,
+                                        const filter_type& new_filter) {
+  // Managers may change their filter before we add them as a sink, e.g., peers
+  // during the handshake. We pick up their filter in `add` in this case.
+  auto is_sink = [sink](const auto& ptr) { return ptr.get() == sink; };
+  if (std::any_of(sinks_.begin(), sinks_.end(), is_sink)) {
+    index_.update(sink, old_filter, new_filter);
+    sinks_changed();
+  }
+}
+
+bool central_dispatcher::has_local_subscriber(const topic& x) const {
+  // Only data sinks belong to local subscribers. Stores receive commands and
+  // peers receive node messages.
+  bool result = false;
+  index_.for_each_match(x, [&result](const unipath_manager* mgr) {
+    if (mgr->message_type() == caf::type_id_v<data_message>)
+      result = true;
+  });
+  return result;
 }
 
 } // namespace broker::detail
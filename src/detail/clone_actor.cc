@@ -7,6 +7,7 @@
 #include <caf/event_based_actor.hpp>
 #include <caf/make_message.hpp>
 #include <caf/message.hpp>
+#include <caf/message_priority.hpp>
 #include <caf/stateful_actor.hpp>
 #include <caf/sum_type.hpp>
 #include <caf/system_messages.hpp>
@@ -21,6 +22,7 @@
 
 #include "broker/detail/appliers.hh"
 #include "broker/detail/clone_actor.hh"
+#include "broker/detail/key_range.hh"
 
 #include <chrono>
 
@@ -45,6 +47,7 @@ void clone_state::forward(internal_command&& x) {
 
 void clone_state::command(internal_command::variant_type& cmd) {
   caf::visit(*this, cmd);
+  seq += mutation_count(cmd);
 }
 
 void clone_state::command(internal_command& cmd) {
@@ -62,9 +65,14 @@ void clone_state::operator()(put_command& x) {
     auto old_value = std::move(value);
     emit_update_event(x, old_value);
     value = std::move(x.value);
+    if (view)
+      view->put(i->first, value);
   } else {
     emit_insert_event(x);
-    store.emplace(std::move(x.key), std::move(x.value));
+    auto j = store.emplace(std::move(x.key), std::move(x.value)).first;
+    index_insert(j->first);
+    if (view)
+      view->put(j->first, j->second);
   }
 }
 
@@ -74,14 +82,22 @@ void clone_state::operator()(put_unique_command& x) {
 
 void clone_state::operator()(erase_command& x) {
   BROKER_INFO("ERASE" << x.key);
-  if (store.erase(x.key) != 0)
+  if (store.erase(x.key) != 0) {
+    index_erase(x.key);
     emit_erase_event(x.key, x.publisher);
+    if (view)
+      view->erase(x.key);
+  }
 }
 
 void clone_state::operator()(expire_command& x) {
   BROKER_INFO("EXPIRE" << x.key);
-  if (store.erase(x.key) != 0)
+  if (store.erase(x.key) != 0) {
+    index_erase(x.key);
     emit_expire_event(x.key, x.publisher);
+    if (view)
+      view->erase(x.key);
+  }
 }
 
 void clone_state::operator()(add_command&) {
@@ -113,44 +129,161 @@ void clone_state::operator()(set_command& x) {
     }
     return;
   }
-  if (store.empty()) {
-    // Emit insert events.
-    for (auto& [key, value] : x.state)
-      emit_insert_event(key, value, nil, publisher);
-  } else {
-    // Emit erase and put events.
-    std::vector<const data*> keys;
-    keys.reserve(store.size());
-    for (auto& kvp : store)
-      keys.emplace_back(&kvp.first);
-    auto is_erased = [&x](const data* key) { return x.state.count(*key) == 0; };
-    auto p = std::partition(keys.begin(), keys.end(), is_erased);
-    for (auto i = keys.begin(); i != p; ++i)
-      emit_erase_event(**i, publisher_id{});
-    for (auto i = p; i != keys.end(); ++i) {
-      const auto& value = x.state[**i];
-      emit_update_event(**i, store[**i], value, nil, publisher);
-    }
-    // Emit insert events.
-    auto is_new = [&keys](const data& key) {
-      for (const auto key_ptr : keys)
-        if (*key_ptr == key)
-          return false;
-      return true;
-    };
-    for (const auto& [key, value] : x.state)
-      if (is_new(key))
+  if (has_event_subscribers()) {
+    if (store.empty()) {
+      // Emit insert events.
+      for (auto& [key, value] : x.state)
         emit_insert_event(key, value, nil, publisher);
+    } else {
+      // Emit erase events for keys that no longer exist and update events for
+      // keys in both states. Each pass only uses hash lookups, i.e., the diff
+      // runs in linear time.
+      for (auto& kvp : store)
+        if (x.state.count(kvp.first) == 0)
+          emit_erase_event(kvp.first, publisher_id{});
+      for (auto& [key, value] : store)
+        if (auto i = x.state.find(key); i != x.state.end())
+          emit_update_event(key, value, i->second, nil, publisher);
+      // Emit insert events.
+      for (const auto& [key, value] : x.state)
+        if (store.count(key) == 0)
+          emit_insert_event(key, value, nil, publisher);
+    }
   }
   // Override local state.
   store = std::move(x.state);
+  index_reset();
+  if (view)
+    view->assign(store);
+}
+
+void clone_state::operator()(set_chunk_command& x) {
+  BROKER_INFO("SET_CHUNK" << x.state.size() << "entries, last:" << x.last);
+  // We consider the master the source of all updates.
+  publisher_id publisher{master.node(), master.id()};
+  // Apply each chunk right away and only remember its keys for dropping the
+  // keys that the master no longer has after the last chunk.
+  for (auto& [key, value] : x.state) {
+    snapshot_keys.emplace(key);
+    if (auto i = store.find(key); i != store.end()) {
+      emit_update_event(key, i->second, value, nil, publisher);
+      i->second = std::move(value);
+      if (view)
+        view->put(i->first, i->second);
+    } else {
+      emit_insert_event(key, value, nil, publisher);
+      auto j = store.emplace(key, std::move(value)).first;
+      index_insert(j->first);
+      if (view)
+        view->put(j->first, j->second);
+    }
+  }
+  if (!x.last)
+    return;
+  for (auto i = store.begin(); i != store.end();) {
+    if (snapshot_keys.count(i->first) == 0) {
+      emit_erase_event(i->first, publisher_id{});
+      if (view)
+        view->erase(i->first);
+      index_erase(i->first);
+      i = store.erase(i);
+    } else {
+      ++i;
+    }
+  }
+  snapshot_keys = std::unordered_set<data>{};
+  seq = x.seq;
+  synced_master = master.address();
 }
 
 void clone_state::operator()(clear_command& x) {
   BROKER_INFO("CLEAR");
-  for (auto& kvp : store)
-    emit_erase_event(kvp.first, x.publisher);
+  if (has_event_subscribers())
+    for (auto& kvp : store)
+      emit_erase_event(kvp.first, x.publisher);
   store.clear();
+  index_reset();
+  if (view)
+    view->assign(store);
+}
+
+void clone_state::operator()(put_batch_command& x) {
+  BROKER_INFO("PUT_BATCH" << x.entries.size() << "entries with expiry"
+                          << x.expiry);
+  for (auto& [key, value] : x.entries) {
+    if (auto i = store.find(key); i != store.end()) {
+      emit_update_event(key, i->second, value, x.expiry, x.publisher);
+      i->second = std::move(value);
+      if (view)
+        view->put(i->first, i->second);
+    } else {
+      emit_insert_event(key, value, x.expiry, x.publisher);
+      auto j = store.emplace(std::move(key), std::move(value)).first;
+      index_insert(j->first);
+      if (view)
+        view->put(j->first, j->second);
+    }
+  }
+}
+
+void clone_state::operator()(erase_batch_command& x) {
+  BROKER_INFO("ERASE_BATCH" << x.keys.size() << "keys");
+  for (auto& key : x.keys) {
+    if (store.erase(key) != 0) {
+      index_erase(key);
+      emit_erase_event(key, x.publisher);
+      if (view)
+        view->erase(key);
+    }
+  }
+}
+
+void clone_state::operator()(expire_batch_command& x) {
+  BROKER_INFO("EXPIRE_BATCH" << x.keys.size() << "keys");
+  for (auto& key : x.keys) {
+    if (store.erase(key) != 0) {
+      index_erase(key);
+      emit_expire_event(key, x.publisher);
+      if (view)
+        view->erase(key);
+    }
+  }
+}
+
+void clone_state::operator()(delta_command& x) {
+  BROKER_INFO("DELTA" << x.commands.size() << "commands, seq:" << x.seq);
+  for (auto& cmd : x.commands)
+    command(cmd);
+  seq = x.seq;
+  synced_master = master.address();
+}
+
+void clone_state::snapshot_complete() {
+  awaiting_snapshot = false;
+  if (!awaiting_snapshot_sync) {
+    for (auto& update : pending_remote_updates)
+      command(update);
+    pending_remote_updates.clear();
+    pending_remote_updates.shrink_to_fit();
+  }
+}
+
+void clone_state::publish_view() {
+  if (view) {
+    view->stale(is_stale);
+    view->publish();
+  }
+}
+
+void clone_state::schedule_publish_view() {
+  if (!view || view_publish_scheduled)
+    return;
+  // CAF processes all elements of a stream batch in one go. Hence, this
+  // message arrives after the current batch. The high priority makes sure
+  // that regular messages in the mailbox do not delay it any further.
+  view_publish_scheduled = true;
+  self->send<caf::message_priority::high>(self, atom::tick_v,
+                                          atom::publish_v);
 }
 
 data clone_state::keys() const {
@@ -160,13 +293,63 @@ data clone_state::keys() const {
   return result;
 }
 
+data clone_state::get_many(const vector& keys) const {
+  table result;
+  for (auto& key : keys)
+    if (auto i = store.find(key); i != store.end())
+      result.emplace(key, i->second);
+  return result;
+}
+
+data clone_state::range(const key_range& range) {
+  if (!has_ordered_keys) {
+    for (auto& kvp : store)
+      ordered_keys.emplace(kvp.first);
+    has_ordered_keys = true;
+  }
+  scan_result page;
+  for (auto i = ordered_keys.lower_bound(range.lo);
+       i != ordered_keys.end() && range.before_end(*i); ++i) {
+    if (page.entries.size() == range_page_size) {
+      page.next = *i;
+      break;
+    }
+    page.entries.emplace_back(*i, store.find(*i)->second);
+  }
+  return make_range_page(std::move(page));
+}
+
+void clone_state::index_insert(const data& key) {
+  if (has_ordered_keys)
+    ordered_keys.emplace(key);
+}
+
+void clone_state::index_erase(const data& key) {
+  if (has_ordered_keys)
+    ordered_keys.erase(key);
+}
+
+void clone_state::index_reset() {
+  ordered_keys.clear();
+  has_ordered_keys = false;
+}
+
+data clone_state::exists_many(const vector& keys) const {
+  vector result;
+  result.reserve(keys.size());
+  for (auto& key : keys)
+    result.emplace_back(store.count(key) > 0);
+  return result;
+}
+
 caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
                           caf::actor core, std::string id,
                           double resync_interval, double stale_interval,
                           double mutation_buffer_interval,
-                          endpoint::clock* clock) {
+                          endpoint::clock* clock, clone_view_ptr view) {
   self->monitor(core);
   self->state.init(self, std::move(id), std::move(core), clock);
+  self->state.view = std::move(view);
   self->set_down_handler(
     [=](const caf::down_msg& msg) {
       if (msg.source == core) {
@@ -179,6 +362,7 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
         self->state.awaiting_snapshot_sync = true;
         self->state.pending_remote_updates.clear();
         self->state.pending_remote_updates.shrink_to_fit();
+        self->state.snapshot_keys = std::unordered_set<data>{};
         self->send(self, atom::master_v, atom::resolve_v);
 
         if ( stale_interval >= 0 )
@@ -236,19 +420,37 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
     },
     [=](set_command& x) {
       self->state(x);
-      self->state.awaiting_snapshot = false;
-
-      if ( ! self->state.awaiting_snapshot_sync ) {
-        for ( auto& update : self->state.pending_remote_updates )
-          self->state.command(update);
-
-        self->state.pending_remote_updates.clear();
-        self->state.pending_remote_updates.shrink_to_fit();
+      self->state.snapshot_complete();
+      self->state.publish_view();
+    },
+    [=](set_chunk_command& x) {
+      auto last = x.last;
+      self->state(x);
+      if (last) {
+        self->state.snapshot_complete();
+        self->state.publish_view();
+      } else {
+        // The master waits for our acknowledgement before sending more than
+        // a few chunks.
+        self->send(caf::actor_cast<caf::actor>(self->current_sender()),
+                   atom::ack_v, atom::snapshot_v);
       }
     },
+    [=](delta_command& x) {
+      self->state(x);
+      self->state.snapshot_complete();
+      self->state.publish_view();
+    },
+    [=](atom::tick, atom::publish) {
+      self->state.view_publish_scheduled = false;
+      self->state.publish_view();
+    },
     [=](atom::sync_point, caf::actor& who) {
       self->send(who, atom::sync_point_v);
     },
+    [=](atom::subscriptions, bool flag) {
+      self->state.event_subscribers = flag;
+    },
     [=](atom::master, atom::resolve) {
       if ( self->state.master )
         return;
@@ -270,6 +472,7 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
       self->state.is_stale = false;
       self->state.stale_time = -1.0;
       self->state.unmutable_time = -1.0;
+      self->state.publish_view();
       self->monitor(self->state.master);
 
       for ( auto& cmd : self->state.mutation_buffer )
@@ -278,8 +481,35 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
       self->state.mutation_buffer.clear();
       self->state.mutation_buffer.shrink_to_fit();
 
-      self->send(self->state.core, atom::store_v, atom::master_v,
-                 atom::snapshot_v, self->state.id, self);
+      auto request_snapshot = [=] {
+        self->send(self->state.core, atom::store_v, atom::master_v,
+                   atom::snapshot_v, self->state.id, self);
+      };
+
+      auto& st = self->state;
+      if (st.synced_master != st.master.address()) {
+        request_snapshot();
+        return;
+      }
+
+      // When reconnecting to the same master, we offer our sequence number.
+      // The master then only sends the mutations we have missed if possible.
+      // The offer must arrive at the master before our snapshot request, so
+      // we wait for the response first.
+      auto ri = std::chrono::duration<double>(resync_interval);
+      auto ts = std::chrono::duration_cast<timespan>(ri);
+      auto hdl = st.master;
+      self->request(st.master, ts, atom::clone_v, st.seq)
+        .then(
+          [=] {
+            if (self->state.master == hdl)
+              request_snapshot();
+          },
+          [=](const caf::error& err) {
+            BROKER_INFO("master rejected delta resync:" << err);
+            if (self->state.master == hdl)
+              request_snapshot();
+          });
     },
     [=](atom::master, caf::error err) {
       if ( self->state.master )
@@ -298,6 +528,7 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
         return;
 
       self->state.is_stale = true;
+      self->state.publish_view();
     },
     [=](atom::tick, atom::mutable_check) {
       if ( self->state.unmutable_time < 0 )
@@ -394,6 +625,43 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
       }
       return result;
     },
+    [=](atom::exists, const vector& keys) -> caf::result<data> {
+      if (self->state.is_stale)
+        return {ec::stale_data};
+      auto result = self->state.exists_many(keys);
+      BROKER_INFO("EXISTS" << keys.size() << "keys ->" << result);
+      return result;
+    },
+    [=](atom::exists, const vector& keys, request_id id) {
+      if (self->state.is_stale)
+        return caf::make_message(make_error(ec::stale_data), id);
+      auto result = self->state.exists_many(keys);
+      BROKER_INFO("EXISTS" << keys.size() << "keys with id" << id << "->"
+                           << result);
+      return caf::make_message(std::move(result), id);
+    },
+    [=](atom::get, const vector& keys) -> caf::result<data> {
+      if (self->state.is_stale)
+        return {ec::stale_data};
+      auto result = self->state.get_many(keys);
+      BROKER_INFO("GET" << keys.size() << "keys ->" << result);
+      return result;
+    },
+    [=](atom::get, const vector& keys, request_id id) {
+      if (self->state.is_stale)
+        return caf::make_message(make_error(ec::stale_data), id);
+      auto result = self->state.get_many(keys);
+      BROKER_INFO("GET" << keys.size() << "keys with id" << id << "->"
+                        << result);
+      return caf::make_message(std::move(result), id);
+    },
+    [=](atom::get, const key_range& range, request_id id) {
+      if (self->state.is_stale)
+        return caf::make_message(make_error(ec::stale_data), id);
+      auto result = self->state.range(range);
+      BROKER_INFO("RANGE" << range.lo << range.bound << "with id" << id);
+      return caf::make_message(std::move(result), id);
+    },
     [=](atom::get, atom::name) { return self->state.id; },
     // --- stream handshake with core ------------------------------------------
     [=](store::stream_type in) {
@@ -424,6 +692,7 @@ caf::behavior clone_actor(caf::stateful_actor<clone_state>* self,
           }
 
           self->state.command(cmd);
+          self->state.schedule_publish_view();
         });
     }};
 }
@@ -0,0 +1,149 @@
+#include "broker/detail/clone_view.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "broker/error.hh"
+
+namespace broker::detail {
+
+namespace {
+
+// Smallest number of buckets. Always a power of two.
+constexpr size_t min_buckets = 16;
+
+// Average number of entries per bucket after redistributing the entries.
+constexpr size_t target_load = 64;
+
+// Average number of entries per bucket that makes the view add more buckets.
+// Larger buckets make publishing more expensive, since each modified bucket
+// gets copied.
+constexpr size_t max_load = 4 * target_load;
+
+size_t bucket_count_for(size_t num_entries) {
+  auto result = min_buckets;
+  while (result * target_load < num_entries)
+    result *= 2;
+  return result;
+}
+
+size_t bucket_of(const data& key, size_t num_buckets) {
+  // Scramble the hash before picking a bucket, since the hash maps in the
+  // buckets use the same hash function.
+  auto h = static_cast<uint64_t>(std::hash<data>{}(key));
+  return static_cast<size_t>((h * 0x9E3779B97F4A7C15ull) >> 32)
+         & (num_buckets - 1);
+}
+
+} // namespace
+
+clone_view::clone_view() {
+  rehash(min_buckets);
+  publish();
+}
+
+expected<data> clone_view::get(const data& key) const {
+  auto snapshot = load();
+  if (snapshot->stale)
+    return ec::stale_data;
+  auto& buckets = snapshot->buckets;
+  auto& bucket = *buckets[bucket_of(key, buckets.size())];
+  if (auto i = bucket.find(key); i != bucket.end())
+    return i->second;
+  return ec::no_such_key;
+}
+
+expected<data> clone_view::exists(const data& key) const {
+  auto snapshot = load();
+  if (snapshot->stale)
+    return ec::stale_data;
+  auto& buckets = snapshot->buckets;
+  auto& bucket = *buckets[bucket_of(key, buckets.size())];
+  return data{bucket.count(key) > 0};
+}
+
+size_t clone_view::size() const {
+  return load()->size;
+}
+
+void clone_view::put(const data& key, const data& value) {
+  auto& bucket = writable_bucket(index_of(key));
+  changed_ = true;
+  if (auto i = bucket.find(key); i != bucket.end()) {
+    i->second = value;
+    return;
+  }
+  bucket.emplace(key, value);
+  if (++size_ > buckets_.size() * max_load)
+    rehash(bucket_count_for(size_));
+}
+
+void clone_view::erase(const data& key) {
+  auto index = index_of(key);
+  if (buckets_[index]->count(key) == 0)
+    return;
+  writable_bucket(index).erase(key);
+  --size_;
+  changed_ = true;
+}
+
+void clone_view::assign(const map_type& xs) {
+  buckets_.clear();
+  rehash(bucket_count_for(xs.size()));
+  for (auto& [key, value] : xs)
+    buckets_[index_of(key)]->emplace(key, value);
+  size_ = xs.size();
+}
+
+void clone_view::stale(bool value) {
+  if (stale_ != value) {
+    stale_ = value;
+    changed_ = true;
+  }
+}
+
+void clone_view::publish() {
+  if (!changed_)
+    return;
+  auto snapshot = std::make_shared<snapshot_type>();
+  snapshot->buckets.assign(buckets_.begin(), buckets_.end());
+  snapshot->size = size_;
+  snapshot->stale = stale_;
+  std::atomic_store(&current_, snapshot_ptr{std::move(snapshot)});
+  // From now on, the published snapshot shares all buckets with the writer.
+  owned_.assign(owned_.size(), false);
+  changed_ = false;
+}
+
+size_t clone_view::index_of(const data& key) const {
+  return bucket_of(key, buckets_.size());
+}
+
+clone_view::map_type& clone_view::writable_bucket(size_t index) {
+  if (!owned_[index]) {
+    buckets_[index] = std::make_shared<map_type>(*buckets_[index]);
+    owned_[index] = true;
+  }
+  return *buckets_[index];
+}
+
+void clone_view::rehash(size_t num_buckets) {
+  std::vector<bucket_ptr> buckets;
+  buckets.reserve(num_buckets);
+  for (size_t i = 0; i < num_buckets; ++i)
+    buckets.emplace_back(std::make_shared<map_type>());
+  for (auto& bucket : buckets_)
+    for (auto& [key, value] : *bucket)
+      buckets[bucket_of(key, num_buckets)]->emplace(key, value);
+  buckets_ = std::move(buckets);
+  owned_.assign(num_buckets, true);
+  changed_ = true;
+}
+
+clone_view::snapshot_ptr clone_view::load() const {
+  return std::atomic_load(&current_);
+}
+
+} // namespace broker::detail
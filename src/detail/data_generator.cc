@@ -170,6 +170,33 @@ caf::error data_generator::generate(internal_command::type tag,
       x.content = clear_command{};
       break;
     }
+    case tag_type::put_batch_command: {
+      uint32_t size = 0;
+      BROKER_TRY(read_value(source_, size));
+      put_batch_command cmd{};
+      cmd.entries.reserve(size);
+      for (size_t i = 0; i < size; ++i) {
+        data key;
+        data val;
+        GENERATE(key);
+        GENERATE(val);
+        cmd.entries.emplace_back(std::move(key), std::move(val));
+      }
+      x.content = std::move(cmd);
+      break;
+    }
+    case tag_type::erase_batch_command: {
+      vector keys;
+      GENERATE(keys);
+      x.content = erase_batch_command{std::move(keys)};
+      break;
+    }
+    case tag_type::expire_batch_command: {
+      vector keys;
+      GENERATE(keys);
+      x.content = expire_batch_command{std::move(keys)};
+      break;
+    }
     default:
       return ec::invalid_tag;
   }
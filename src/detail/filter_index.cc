@@ -0,0 +1,53 @@
+#include "broker/detail/filter_index.hh"
+
+#include <algorithm>
+#include <iterator>
+
+namespace broker::detail {
+
+void filter_index::add(const unipath_manager* mgr, const filter_type& filter) {
+  for (auto& x : filter)
+    add(mgr, x);
+}
+
+void filter_index::erase(const unipath_manager* mgr,
+                         const filter_type& filter) {
+  for (auto& x : filter)
+    erase(mgr, x);
+}
+
+void filter_index::update(const unipath_manager* mgr,
+                          const filter_type& old_filter,
+                          const filter_type& new_filter) {
+  // Filters usually are sorted already, but we don't rely on it.
+  auto xs = old_filter;
+  auto ys = new_filter;
+  std::sort(xs.begin(), xs.end());
+  std::sort(ys.begin(), ys.end());
+  filter_type removed;
+  std::set_difference(xs.begin(), xs.end(), ys.begin(), ys.end(),
+                      std::back_inserter(removed));
+  filter_type added;
+  std::set_difference(ys.begin(), ys.end(), xs.begin(), xs.end(),
+                      std::back_inserter(added));
+  erase(mgr, removed);
+  add(mgr, added);
+}
+
+void filter_index::add(const unipath_manager* mgr, const topic& x) {
+  auto& mgrs = tree_[x.string()];
+  if (std::find(mgrs.begin(), mgrs.end(), mgr) == mgrs.end())
+    mgrs.emplace_back(mgr);
+}
+
+void filter_index::erase(const unipath_manager* mgr, const topic& x) {
+  auto i = tree_.find(x.string());
+  if (i == tree_.end())
+    return;
+  auto& mgrs = i->second;
+  mgrs.erase(std::remove(mgrs.begin(), mgrs.end(), mgr), mgrs.end());
+  if (mgrs.empty())
+    tree_.erase(x.string());
+}
+
+} // namespace broker::detail
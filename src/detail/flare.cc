@@ -3,6 +3,8 @@
 #include <errno.h>
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <exception>
 
 #include "broker/config.hh"
@@ -38,6 +40,10 @@ bool try_again_later() {
 #include <poll.h>
 #include <unistd.h>
 
+#ifdef BROKER_LINUX
+#include <sys/eventfd.h>
+#endif // BROKER_LINUX
+
 #define PIPE_WRITE ::write
 
 #define PIPE_READ ::read
@@ -71,6 +77,28 @@ struct stack_buffer {
 
 } // namespace
 
+#ifdef BROKER_LINUX
+
+// On Linux, the flare counts in user space and uses an eventfd only for
+// signaling readiness: fire() writes to the eventfd when the count leaves
+// zero and the extinguish functions read from it when the count drops back to
+// zero. Every other call gets by without any syscall.
+
+flare::flare() {
+  fds_[0] = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  fds_[1] = caf::io::network::invalid_native_socket;
+  if (fds_[0] < 0) {
+    BROKER_ERROR("failed to create flare eventfd: " << strerror(errno));
+    std::terminate();
+  }
+}
+
+flare::~flare() {
+  ::close(fds_[0]);
+}
+
+#else // BROKER_LINUX
+
 flare::flare() {
   using namespace caf::io::network;
   auto [first, second] = create_pipe();
@@ -95,10 +123,72 @@ flare::~flare() {
   close_socket(fds_[1]);
 }
 
+#endif // BROKER_LINUX
+
 flare::native_socket flare::fd() const {
   return fds_[0];
 }
 
+#ifdef BROKER_LINUX
+
+namespace {
+
+// Resets the eventfd, which always holds either 0 or 1.
+void reset_eventfd(int fd) {
+  uint64_t tmp = 0;
+  for (;;) {
+    auto n = ::read(fd, &tmp, sizeof(tmp));
+    if (n == sizeof(tmp) || (n < 0 && try_again_later()))
+      return;
+    if (n < 0 && errno != EINTR) {
+      BROKER_ERROR("unable to read flare eventfd: " << strerror(errno));
+      std::terminate();
+    }
+  }
+}
+
+// Makes the eventfd ready.
+void signal_eventfd(int fd) {
+  uint64_t one = 1;
+  for (;;) {
+    auto n = ::write(fd, &one, sizeof(one));
+    if (n == sizeof(one))
+      return;
+    if (n < 0 && errno != EINTR) {
+      BROKER_ERROR("unable to write flare eventfd: " << strerror(errno));
+      std::terminate();
+    }
+  }
+}
+
+} // namespace
+
+void flare::fire(size_t num) {
+  std::unique_lock<std::mutex> guard{mtx_};
+  if (num > 0 && count_ == 0)
+    signal_eventfd(fds_[0]);
+  count_ += num;
+}
+
+size_t flare::extinguish() {
+  return extinguish_some(SIZE_MAX);
+}
+
+bool flare::extinguish_one() {
+  return extinguish_some(1) == 1;
+}
+
+size_t flare::extinguish_some(size_t num) {
+  std::unique_lock<std::mutex> guard{mtx_};
+  auto result = std::min(num, count_);
+  if (result > 0 && result == count_)
+    reset_eventfd(fds_[0]);
+  count_ -= result;
+  return result;
+}
+
+#else // BROKER_LINUX
+
 void flare::fire(size_t num) {
   stack_buffer tmp;
   size_t remaining = num;
@@ -136,6 +226,22 @@ bool flare::extinguish_one() {
   }
 }
 
+size_t flare::extinguish_some(size_t num) {
+  stack_buffer tmp;
+  size_t result = 0;
+  while (result < num) {
+    auto len = static_cast<int>(std::min(num - result, stack_buffer_size));
+    auto n = PIPE_READ(fds_[0], tmp.data, len);
+    if (n > 0)
+      result += static_cast<size_t>(n);
+    else if (n == -1 && try_again_later())
+      break; // Pipe is now drained.
+  }
+  return result;
+}
+
+#endif // BROKER_LINUX
+
 void flare::await_one() {
   BROKER_TRACE("");
   pollfd p = {fds_[0], POLLIN, 0};
@@ -95,17 +95,15 @@ caf::error generator_file_writer::write(const data_or_command_message& x) {
 }
 
 caf::error generator_file_writer::topic_id(const topic& x, uint16_t& id) {
-  auto e = topic_table_.end();
-  auto i = std::find(topic_table_.begin(), e, x);
-  if (i == e) {
-    // Write the new topic to file first.
-    auto entry = format::entry_type::new_topic;
-    BROKER_TRY(write_value(sink_, entry), write_value(sink_, x.string()));
-    id = static_cast<uint16_t>(topic_table_.size());
-    topic_table_.emplace_back(x);
+  if (auto i = topic_ids_.find(x); i != topic_ids_.end()) {
+    id = i->second;
     return caf::none;
   }
-  id = static_cast<uint16_t>(std::distance(topic_table_.begin(), i));
+  // Write the new topic to file first.
+  auto entry = format::entry_type::new_topic;
+  BROKER_TRY(write_value(sink_, entry), write_value(sink_, x.string()));
+  id = static_cast<uint16_t>(topic_ids_.size());
+  topic_ids_.emplace(x, id);
   return caf::none;
 }
 
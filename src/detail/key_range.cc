@@ -0,0 +1,82 @@
+#include "broker/detail/key_range.hh"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+namespace broker::detail {
+
+key_range key_range::between(data lo, data hi) {
+  return {std::move(lo), std::move(hi), false};
+}
+
+key_range key_range::starting_with(data prefix) {
+  auto lo = prefix;
+  return {std::move(lo), std::move(prefix), true};
+}
+
+bool key_range::before_end(const data& key) const {
+  return prefix ? has_prefix(key, bound) : key < bound;
+}
+
+bool has_prefix(const data& key, const data& prefix) {
+  if (auto str = caf::get_if<std::string>(&key)) {
+    if (auto pre = caf::get_if<std::string>(&prefix))
+      return str->compare(0, pre->size(), *pre) == 0;
+    return false;
+  }
+  if (auto vec = caf::get_if<vector>(&key)) {
+    if (auto pre = caf::get_if<vector>(&prefix))
+      return vec->size() >= pre->size()
+             && std::equal(pre->begin(), pre->end(), vec->begin());
+    return false;
+  }
+  return key == prefix;
+}
+
+data make_range_page(scan_result&& page) {
+  table entries;
+  for (auto& [key, value] : page.entries)
+    entries.emplace_hint(entries.end(), std::move(key), std::move(value));
+  vector result;
+  result.emplace_back(std::move(entries));
+  if (page.next)
+    result.emplace_back(std::move(*page.next));
+  return result;
+}
+
+range_page_builder::range_page_builder(const key_range& range, size_t limit)
+  : range_(range), limit_(limit) {
+  // nop
+}
+
+void range_page_builder::add(const data& key, const data& value) {
+  if (!range_.contains(key))
+    return;
+  // Keep one more entry than fits into the page for determining the first key
+  // of the next page.
+  if (entries_.size() <= limit_) {
+    entries_.emplace(key, value);
+    return;
+  }
+  auto last = std::prev(entries_.end());
+  if (key < last->first) {
+    entries_.erase(last);
+    entries_.emplace(key, value);
+  }
+}
+
+scan_result range_page_builder::build() && {
+  scan_result result;
+  if (entries_.size() > limit_) {
+    auto last = std::prev(entries_.end());
+    result.next = last->first;
+    entries_.erase(last);
+  }
+  result.entries.reserve(entries_.size());
+  for (auto& kvp : entries_)
+    result.entries.emplace_back(kvp.first, std::move(kvp.second));
+  return result;
+}
+
+} // namespace broker::detail
@@ -0,0 +1,764 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include "broker/detail/log_backend.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <caf/detail/scope_guard.hpp>
+
+#include "broker/config.hh"
+#include "broker/defaults.hh"
+#include "broker/detail/appliers.hh"
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/key_range.hh"
+#include "broker/detail/ordered_encoding.hh"
+#include "broker/error.hh"
+
+#ifndef BROKER_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // BROKER_WINDOWS
+
+namespace broker::detail {
+
+namespace {
+
+// -- platform abstraction -----------------------------------------------------
+
+#ifdef BROKER_WINDOWS
+
+// The log backend relies on POSIX file descriptors and mmap. Opening a log
+// always fails on Windows.
+
+int open_file(const std::string&) {
+  return -1;
+}
+
+void close_file(int) {
+  // nop
+}
+
+bool write_at(int, const uint8_t*, size_t, uint64_t) {
+  return false;
+}
+
+bool truncate_file(int, uint64_t) {
+  return false;
+}
+
+bool sync_file(int) {
+  return false;
+}
+
+bool query_file_size(int, uint64_t&) {
+  return false;
+}
+
+const uint8_t* map_file(int, uint64_t) {
+  return nullptr;
+}
+
+void unmap_file(const uint8_t*, uint64_t) {
+  // nop
+}
+
+#else // BROKER_WINDOWS
+
+int open_file(const std::string& path) {
+  return ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+}
+
+void close_file(int fd) {
+  ::close(fd);
+}
+
+bool write_at(int fd, const uint8_t* buf, size_t size, uint64_t offset) {
+  while (size > 0) {
+    auto n = ::pwrite(fd, buf, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    buf += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+bool truncate_file(int fd, uint64_t size) {
+  return ::ftruncate(fd, static_cast<off_t>(size)) == 0;
+}
+
+bool sync_file(int fd) {
+  return ::fsync(fd) == 0;
+}
+
+bool query_file_size(int fd, uint64_t& size) {
+  struct stat sb;
+  if (::fstat(fd, &sb) != 0)
+    return false;
+  size = static_cast<uint64_t>(sb.st_size);
+  return true;
+}
+
+const uint8_t* map_file(int fd, uint64_t size) {
+  auto addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED)
+    return nullptr;
+  return static_cast<const uint8_t*>(addr);
+}
+
+void unmap_file(const uint8_t* addr, uint64_t size) {
+  ::munmap(const_cast<uint8_t*>(addr), size);
+}
+
+#endif // BROKER_WINDOWS
+
+// -- file format --------------------------------------------------------------
+
+// Starts each log file. The last byte is the version of the format.
+constexpr uint8_t file_header[] = {'B', 'R', 'O', 'K', 'L', 'O', 'G', 1};
+
+constexpr uint64_t file_header_size = sizeof(file_header);
+
+// Each record starts with a header, followed by the encoded key and, for put
+// records, the encoded value. The header stores the operation, the flags,
+// the expiry in nanoseconds since the epoch and the sizes of key and value
+// in little-endian byte order.
+constexpr uint64_t record_header_size = 1 + 1 + 8 + 4 + 4;
+
+enum class record_type : uint8_t {
+  put = 1,
+  erase = 2,
+};
+
+constexpr uint8_t has_expiry_flag = 0x01;
+
+// Stops compaction from accumulating more than this many bytes before
+// writing them to the new file.
+constexpr size_t compaction_buffer_size = 1024 * 1024;
+
+// Maps at least this many bytes past the end of the file. Appending records
+// extends the file into the mapped range, i.e., reading a record right after
+// writing it does not require a new mapping.
+constexpr uint64_t min_map_headroom = 1024 * 1024;
+
+template <class T>
+void write_le(uint8_t* buf, T x) {
+  auto bits = static_cast<uint64_t>(x);
+  for (size_t i = 0; i < sizeof(T); ++i)
+    buf[i] = static_cast<uint8_t>(bits >> (i * 8));
+}
+
+template <class T>
+T read_le(const uint8_t* buf) {
+  uint64_t bits = 0;
+  for (size_t i = sizeof(T); i > 0; --i)
+    bits = (bits << 8) | buf[i - 1];
+  return static_cast<T>(bits);
+}
+
+} // namespace
+
+struct log_backend::impl {
+  // Locates the latest record for a key.
+  struct entry {
+    uint64_t offset;
+    uint32_t key_size;
+    uint32_t value_size;
+    optional<timestamp> expiry;
+
+    uint64_t record_size() const {
+      return record_header_size + key_size + value_size;
+    }
+
+    uint64_t value_offset() const {
+      return offset + record_header_size + key_size;
+    }
+  };
+
+  using index_type = std::map<data, entry>;
+
+  impl(backend_options opts) : options{std::move(opts)} {
+    if (!read_options())
+      return;
+    if (!open())
+      BROKER_ERROR("unable to open log file" << path);
+  }
+
+  ~impl() {
+    close();
+  }
+
+  bool read_options() {
+    auto i = options.find("path");
+    if (i == options.end()) {
+      BROKER_ERROR("log backend options are missing required 'path' string");
+      return false;
+    }
+    if (auto str = caf::get_if<std::string>(&i->second)) {
+      path = *str;
+    } else {
+      BROKER_ERROR("log backend option 'path' is not a string");
+      return false;
+    }
+    if (i = options.find("compaction-threshold"); i != options.end()) {
+      if (auto n = caf::get_if<count>(&i->second)) {
+        compaction_threshold = *n;
+      } else if (auto n = caf::get_if<integer>(&i->second); n && *n >= 0) {
+        compaction_threshold = static_cast<uint64_t>(*n);
+      } else {
+        BROKER_ERROR("log backend option 'compaction-threshold' is not a "
+                     "count");
+        return false;
+      }
+    }
+    if (i = options.find("sync-interval"); i != options.end()) {
+      if (auto dt = caf::get_if<timespan>(&i->second)) {
+        sync_interval = *dt;
+      } else {
+        BROKER_ERROR("log backend option 'sync-interval' is not a timespan");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool open() {
+    auto dir = detail::dirname(path);
+    if (!dir.empty() && !detail::is_directory(dir) && !detail::mkdirs(dir))
+      return false;
+    fd = open_file(path);
+    if (fd == -1)
+      return false;
+    if (!query_file_size(fd, size)) {
+      close();
+      return false;
+    }
+    if (size == 0) {
+      if (!write_at(fd, file_header, file_header_size, 0)) {
+        close();
+        return false;
+      }
+      size = file_header_size;
+      return true;
+    }
+    if (size < file_header_size || !remap()
+        || std::memcmp(view, file_header, file_header_size) != 0) {
+      BROKER_ERROR("not a Broker log file:" << path);
+      close();
+      return false;
+    }
+    if (!load()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    unmap();
+    if (fd != -1) {
+      close_file(fd);
+      fd = -1;
+    }
+  }
+
+  // Rebuilds the index from the records in the log. Drops a partially
+  // written record at the end of the log, but refuses to open a log with an
+  // invalid record, since dropping everything after that record would lose
+  // data.
+  bool load() {
+    auto pos = file_header_size;
+    while (size - pos >= record_header_size) {
+      auto ptr = view + pos;
+      entry e{pos, read_le<uint32_t>(ptr + 10), read_le<uint32_t>(ptr + 14),
+              nil};
+      if (size - pos < e.record_size())
+        break;
+      auto key = decode_ordered(ptr + record_header_size, e.key_size);
+      if (!key) {
+        BROKER_ERROR("invalid key in record at offset" << pos << "of" << path);
+        return false;
+      }
+      auto type = static_cast<record_type>(ptr[0]);
+      if (type == record_type::put) {
+        if ((ptr[1] & has_expiry_flag) != 0)
+          e.expiry = timestamp{timespan{read_le<int64_t>(ptr + 2)}};
+        set(*key, e);
+      } else if (type == record_type::erase) {
+        if (auto i = index.find(*key); i != index.end())
+          remove(i);
+      } else {
+        BROKER_ERROR("invalid record type at offset" << pos << "of" << path);
+        return false;
+      }
+      pos += e.record_size();
+    }
+    // Only the last record may run past the end of the file.
+    if (pos < size) {
+      BROKER_WARNING("drop" << size - pos << "bytes of incomplete records at"
+                            << "the end of" << path);
+      unmap();
+      if (!truncate_file(fd, pos))
+        return false;
+      size = pos;
+    }
+    return true;
+  }
+
+  // Maps the entire log file into memory, plus some headroom for records
+  // that get appended later. Pages past the end of the file become readable
+  // as soon as the file grows into them.
+  bool remap() const {
+    unmap();
+    auto len = size + std::max(size / 2, min_map_headroom);
+    view = map_file(fd, len);
+    if (view == nullptr)
+      return false;
+    view_size = len;
+    return true;
+  }
+
+  void unmap() const {
+    if (view != nullptr) {
+      unmap_file(view, view_size);
+      view = nullptr;
+      view_size = 0;
+    }
+  }
+
+  // Encodes a record into `buf`. The returned entry assumes that `buf` gets
+  // appended to the log as a whole.
+  bool encode(record_type type, const data& key, const data* value,
+              optional<timestamp> expiry, entry& result) {
+    auto offset = buf.size();
+    buf.resize(offset + record_header_size);
+    encode_ordered(key, buf);
+    auto key_size = buf.size() - offset - record_header_size;
+    if (value != nullptr)
+      encode_ordered(*value, buf);
+    auto value_size = buf.size() - offset - record_header_size - key_size;
+    if (key_size > UINT32_MAX || value_size > UINT32_MAX) {
+      buf.resize(offset);
+      return false;
+    }
+    auto ptr = buf.data() + offset;
+    ptr[0] = static_cast<uint8_t>(type);
+    ptr[1] = expiry ? has_expiry_flag : 0;
+    write_le(ptr + 2, expiry ? expiry->time_since_epoch().count() : 0);
+    write_le(ptr + 10, static_cast<uint32_t>(key_size));
+    write_le(ptr + 14, static_cast<uint32_t>(value_size));
+    result = entry{size + offset, static_cast<uint32_t>(key_size),
+                   static_cast<uint32_t>(value_size), expiry};
+    return true;
+  }
+
+  // Appends all records in `buf` to the log.
+  bool write_buf() {
+    auto ok = write_at(fd, buf.data(), buf.size(), size);
+    if (ok)
+      size += buf.size();
+    else
+      BROKER_ERROR("failed to append to log file" << path);
+    buf.clear();
+    return ok;
+  }
+
+  // Updates the index after appending the put record `e` for `key`.
+  void set(const data& key, const entry& e) {
+    auto [i, added] = index.try_emplace(key, e);
+    if (!added) {
+      if (auto& expiry = i->second.expiry)
+        expirations.erase(std::make_pair(*expiry, key));
+      live_bytes -= i->second.record_size();
+      i->second = e;
+    }
+    live_bytes += e.record_size();
+    if (e.expiry)
+      expirations.emplace(*e.expiry, key);
+  }
+
+  // Updates the index after appending an erase record for `i->first`.
+  void remove(index_type::iterator i) {
+    if (auto& expiry = i->second.expiry)
+      expirations.erase(std::make_pair(*expiry, i->first));
+    live_bytes -= i->second.record_size();
+    index.erase(i);
+  }
+
+  expected<data> read(const entry& e) const {
+    if (e.value_offset() + e.value_size > view_size && !remap())
+      return ec::backend_failure;
+    return decode_ordered(view + e.value_offset(), e.value_size);
+  }
+
+  expected<void> put(const data& key, const data& value,
+                     optional<timestamp> expiry) {
+    entry e;
+    if (!encode(record_type::put, key, &value, expiry, e))
+      return ec::invalid_data;
+    if (!write_buf())
+      return ec::backend_failure;
+    set(key, e);
+    maybe_compact();
+    return {};
+  }
+
+  expected<void> erase(index_type::iterator i) {
+    entry e;
+    if (!encode(record_type::erase, i->first, nullptr, nil, e))
+      return ec::invalid_data;
+    if (!write_buf())
+      return ec::backend_failure;
+    remove(i);
+    maybe_compact();
+    return {};
+  }
+
+  // Compacts the log once stale records take up more space than live records
+  // and exceed the compaction threshold. Compaction is best-effort: the log
+  // remains valid if it fails, so we only report the error and wait until
+  // twice as many stale bytes have piled up before trying again.
+  void maybe_compact() {
+    auto stale_bytes = size - file_header_size - live_bytes;
+    if (stale_bytes < compaction_threshold || stale_bytes < live_bytes
+        || stale_bytes < compaction_backoff)
+      return;
+    if (auto res = compact(); !res) {
+      BROKER_ERROR("failed to compact log file" << path << ":" << res.error());
+      compaction_backoff = stale_bytes * 2;
+    }
+  }
+
+  // Writes all live records to a new file that replaces the log afterwards.
+  expected<void> compact() {
+    BROKER_DEBUG("compact log file" << path << "with" << index.size()
+                                    << "entries");
+    if (view_size < size && !remap())
+      return ec::backend_failure;
+    auto tmp_path = path + ".compact";
+    auto tmp = open_file(tmp_path);
+    if (tmp == -1)
+      return ec::backend_failure;
+    auto guard = caf::detail::make_scope_guard([&] {
+      if (tmp != -1)
+        close_file(tmp);
+    });
+    if (!truncate_file(tmp, 0))
+      return ec::backend_failure;
+    std::vector<std::pair<entry*, uint64_t>> moved;
+    moved.reserve(index.size());
+    buf.assign(file_header, file_header + file_header_size);
+    uint64_t pos = 0;
+    for (auto& kvp : index) {
+      auto& e = kvp.second;
+      moved.emplace_back(&e, pos + buf.size());
+      buf.insert(buf.end(), view + e.offset, view + e.offset + e.record_size());
+      if (buf.size() >= compaction_buffer_size) {
+        if (!write_at(tmp, buf.data(), buf.size(), pos)) {
+          buf.clear();
+          return ec::backend_failure;
+        }
+        pos += buf.size();
+        buf.clear();
+      }
+    }
+    auto ok = write_at(tmp, buf.data(), buf.size(), pos);
+    pos += buf.size();
+    buf.clear();
+    if (!ok || !sync_file(tmp)
+        || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+      return ec::backend_failure;
+    unmap();
+    close_file(fd);
+    fd = tmp;
+    tmp = -1;
+    size = pos;
+    for (auto& [e, offset] : moved)
+      e->offset = offset;
+    compaction_backoff = 0;
+    return {};
+  }
+
+  expected<void> clear() {
+    unmap();
+    if (!truncate_file(fd, file_header_size))
+      return ec::backend_failure;
+    size = file_header_size;
+    live_bytes = 0;
+    index.clear();
+    expirations.clear();
+    return {};
+  }
+
+  backend_options options;
+  std::string path;
+  uint64_t compaction_threshold = defaults::store::log_compaction_threshold;
+  // Minimum number of stale bytes before retrying a failed compaction.
+  uint64_t compaction_backoff = 0;
+  optional<timespan> sync_interval;
+  int fd = -1;
+  uint64_t size = 0;
+  uint64_t live_bytes = 0;
+  mutable const uint8_t* view = nullptr;
+  mutable uint64_t view_size = 0;
+  std::vector<uint8_t> buf;
+  index_type index;
+  std::set<std::pair<timestamp, data>> expirations;
+};
+
+log_backend::log_backend(backend_options opts)
+  : impl_{std::make_unique<impl>(std::move(opts))} {
+  // nop
+}
+
+log_backend::~log_backend() {
+  // nop
+}
+
+bool log_backend::init_failed() const {
+  return impl_->fd == -1;
+}
+
+expected<void> log_backend::put(const data& key, data value,
+                                optional<timestamp> expiry) {
+  if (init_failed())
+    return ec::backend_failure;
+  return impl_->put(key, value, expiry);
+}
+
+expected<void> log_backend::add(const data& key, const data& value,
+                                data::type init_type,
+                                optional<timestamp> expiry) {
+  if (init_failed())
+    return ec::backend_failure;
+  data v;
+  if (auto i = impl_->index.find(key); i != impl_->index.end()) {
+    auto x = impl_->read(i->second);
+    if (!x)
+      return x.error();
+    v = std::move(*x);
+  } else if (init_type == data::type::none) {
+    return ec::type_clash;
+  } else {
+    v = data::from_type(init_type);
+  }
+  if (auto res = caf::visit(adder{value}, v); !res)
+    return res;
+  return impl_->put(key, v, expiry);
+}
+
+expected<void> log_backend::subtract(const data& key, const data& value,
+                                     optional<timestamp> expiry) {
+  if (init_failed())
+    return ec::backend_failure;
+  auto i = impl_->index.find(key);
+  if (i == impl_->index.end())
+    return ec::no_such_key;
+  auto v = impl_->read(i->second);
+  if (!v)
+    return v.error();
+  if (auto res = caf::visit(remover{value}, *v); !res)
+    return res;
+  return impl_->put(key, *v, expiry);
+}
+
+expected<void> log_backend::erase(const data& key) {
+  if (init_failed())
+    return ec::backend_failure;
+  if (auto i = impl_->index.find(key); i != impl_->index.end())
+    return impl_->erase(i);
+  return {};
+}
+
+expected<void> log_backend::clear() {
+  if (init_failed())
+    return ec::backend_failure;
+  return impl_->clear();
+}
+
+expected<bool> log_backend::expire(const data& key, timestamp current_time) {
+  if (init_failed())
+    return ec::backend_failure;
+  auto i = impl_->index.find(key);
+  if (i == impl_->index.end())
+    return false;
+  auto& expiry = i->second.expiry;
+  if (!expiry || current_time < *expiry)
+    return false;
+  if (auto res = impl_->erase(i); !res)
+    return res.error();
+  return true;
+}
+
+expected<std::vector<data>>
+log_backend::expire_due(timestamp current_time) {
+  if (init_failed())
+    return ec::backend_failure;
+  // Append the erase records for all due keys with a single write.
+  auto& expirations = impl_->expirations;
+  std::vector<data> keys;
+  impl::entry e;
+  auto last = expirations.begin();
+  for (; last != expirations.end() && last->first <= current_time; ++last) {
+    if (!impl_->encode(record_type::erase, last->second, nullptr, nil, e)) {
+      impl_->buf.clear();
+      return ec::invalid_data;
+    }
+    keys.emplace_back(last->second);
+  }
+  if (keys.empty())
+    return {std::move(keys)};
+  if (!impl_->write_buf())
+    return ec::backend_failure;
+  for (auto& key : keys)
+    impl_->remove(impl_->index.find(key));
+  impl_->maybe_compact();
+  return {std::move(keys)};
+}
+
+expected<data> log_backend::get(const data& key) const {
+  if (init_failed())
+    return ec::backend_failure;
+  auto i = impl_->index.find(key);
+  if (i == impl_->index.end())
+    return ec::no_such_key;
+  return impl_->read(i->second);
+}
+
+expected<bool> log_backend::exists(const data& key) const {
+  if (init_failed())
+    return ec::backend_failure;
+  return impl_->index.count(key) == 1;
+}
+
+expected<uint64_t> log_backend::size() const {
+  if (init_failed())
+    return ec::backend_failure;
+  return impl_->index.size();
+}
+
+expected<data> log_backend::keys() const {
+  if (init_failed())
+    return ec::backend_failure;
+  set result;
+  for (auto& kvp : impl_->index)
+    result.emplace(kvp.first);
+  return {std::move(result)};
+}
+
+expected<snapshot> log_backend::snapshot() const {
+  if (init_failed())
+    return ec::backend_failure;
+  broker::snapshot result;
+  for (auto& [key, e] : impl_->index) {
+    auto value = impl_->read(e);
+    if (!value)
+      return value.error();
+    result.emplace(key, std::move(*value));
+  }
+  return {std::move(result)};
+}
+
+expected<expirables> log_backend::expiries() const {
+  if (init_failed())
+    return ec::backend_failure;
+  expirables result;
+  for (auto& [expiry, key] : impl_->expirations)
+    result.emplace_back(key, expiry);
+  return {std::move(result)};
+}
+
+optional<timespan> log_backend::batch_interval() const {
+  return impl_->sync_interval;
+}
+
+expected<void> log_backend::flush() {
+  if (init_failed() || !sync_file(impl_->fd))
+    return ec::backend_failure;
+  return {};
+}
+
+expected<void> log_backend::for_each(const entry_visitor& f) const {
+  if (init_failed())
+    return ec::backend_failure;
+  for (auto& [key, e] : impl_->index) {
+    auto value = impl_->read(e);
+    if (!value)
+      return value.error();
+    f(key, *value, e.expiry);
+  }
+  return {};
+}
+
+expected<void> log_backend::for_each_expiry(const expiry_visitor& f) const {
+  if (init_failed())
+    return ec::backend_failure;
+  for (auto& [expiry, key] : impl_->expirations)
+    f(key, expiry);
+  return {};
+}
+
+expected<scan_result> log_backend::scan(const optional<data>& begin_key,
+                                        size_t limit) const {
+  if (init_failed())
+    return ec::backend_failure;
+  auto& index = impl_->index;
+  auto i = begin_key ? index.lower_bound(*begin_key) : index.begin();
+  scan_result result;
+  for (; i != index.end() && result.entries.size() < limit; ++i) {
+    auto value = impl_->read(i->second);
+    if (!value)
+      return value.error();
+    result.entries.emplace_back(i->first, std::move(*value));
+  }
+  if (i != index.end())
+    result.next = i->first;
+  return {std::move(result)};
+}
+
+expected<scan_result> log_backend::range(const key_range& range,
+                                         size_t limit) const {
+  if (init_failed())
+    return ec::backend_failure;
+  auto& index = impl_->index;
+  scan_result result;
+  auto i = index.lower_bound(range.lo);
+  for (; i != index.end() && range.before_end(i->first); ++i) {
+    if (result.entries.size() == limit) {
+      result.next = i->first;
+      break;
+    }
+    auto value = impl_->read(i->second);
+    if (!value)
+      return value.error();
+    result.entries.emplace_back(i->first, std::move(*value));
+  }
+  return {std::move(result)};
+}
+
+expected<void> log_backend::compact() {
+  if (init_failed())
+    return ec::backend_failure;
+  return impl_->compact();
+}
+
+uint64_t log_backend::file_size() const {
+  return impl_->size;
+}
+
+} // namespace broker::detail
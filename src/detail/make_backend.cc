@@ -1,6 +1,12 @@
+#include "broker/logger.hh" // Needs to come before CAF includes.
+
+#include <string>
+
 #include "broker/config.hh"
 
+#include "broker/detail/caching_backend.hh"
 #include "broker/detail/die.hh"
+#include "broker/detail/log_backend.hh"
 #include "broker/detail/make_backend.hh"
 #include "broker/detail/memory_backend.hh"
 #include "broker/detail/sqlite_backend.hh"
@@ -8,8 +14,38 @@
 namespace broker {
 namespace detail {
 
-std::unique_ptr<detail::abstract_backend> make_backend(backend type,
-                                                       backend_options opts) {
+namespace {
+
+// Reads the option `cache-size`. Returns 0 if the option is absent and
+// `nil` if it has an invalid value.
+optional<size_t> cache_size(const backend_options& opts) {
+  auto i = opts.find("cache-size");
+  if (i == opts.end())
+    return size_t{0};
+  if (auto n = caf::get_if<count>(&i->second))
+    return static_cast<size_t>(*n);
+  if (auto n = caf::get_if<integer>(&i->second); n && *n >= 0)
+    return static_cast<size_t>(*n);
+  BROKER_ERROR("backend option 'cache-size' is not a count");
+  return nil;
+}
+
+// Reads the option `shards`. Returns 1 if the option is absent and `nil` if it
+// has an invalid value.
+optional<size_t> shard_count(const backend_options& opts) {
+  auto i = opts.find("shards");
+  if (i == opts.end())
+    return size_t{1};
+  if (auto n = caf::get_if<count>(&i->second); n && *n > 0)
+    return static_cast<size_t>(*n);
+  if (auto n = caf::get_if<integer>(&i->second); n && *n > 0)
+    return static_cast<size_t>(*n);
+  BROKER_ERROR("backend option 'shards' is not a positive count");
+  return nil;
+}
+
+std::unique_ptr<abstract_backend> make_plain_backend(backend type,
+                                                     backend_options opts) {
   switch (type) {
     case backend::memory:
       return std::make_unique<memory_backend>(std::move(opts));
@@ -19,10 +55,52 @@ std::unique_ptr<detail::abstract_backend> make_backend(backend type,
         return nullptr;
       return rval;
     }
+    case backend::log: {
+      auto rval = std::make_unique<log_backend>(std::move(opts));
+      if (rval->init_failed())
+        return nullptr;
+      return rval;
+    }
   }
 
   die("invalid backend type");
 }
 
+} // namespace
+
+std::unique_ptr<detail::abstract_backend> make_backend(backend type,
+                                                       backend_options opts) {
+  auto n = cache_size(opts);
+  if (!n)
+    return nullptr;
+  auto rval = make_plain_backend(type, std::move(opts));
+  if (rval == nullptr || *n == 0)
+    return rval;
+  return std::make_unique<caching_backend>(std::move(rval), *n);
+}
+
+std::vector<std::unique_ptr<abstract_backend>>
+make_backends(backend type, backend_options opts) {
+  std::vector<std::unique_ptr<abstract_backend>> result;
+  auto n = shard_count(opts);
+  if (!n)
+    return result;
+  opts.erase("shards");
+  for (size_t i = 0; i < *n; ++i) {
+    auto shard_opts = opts;
+    if (*n > 1)
+      if (auto j = shard_opts.find("path"); j != shard_opts.end())
+        if (auto path = caf::get_if<std::string>(&j->second))
+          *path += ".shard-" + std::to_string(i);
+    auto ptr = make_backend(type, std::move(shard_opts));
+    if (ptr == nullptr) {
+      result.clear();
+      return result;
+    }
+    result.emplace_back(std::move(ptr));
+  }
+  return result;
+}
+
 } // namespace detail
 } // namespace broker
@@ -1,25 +1,37 @@
 #include "broker/logger.hh" // Needs to come before CAF includes.
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+
 #include <caf/actor.hpp>
 #include <caf/attach_stream_sink.hpp>
 #include <caf/behavior.hpp>
 #include <caf/error.hpp>
 #include <caf/event_based_actor.hpp>
 #include <caf/make_message.hpp>
+#include <caf/message_handler.hpp>
+#include <caf/response_promise.hpp>
 #include <caf/stateful_actor.hpp>
 #include <caf/sum_type.hpp>
 #include <caf/system_messages.hpp>
+#include <caf/telemetry/counter.hpp>
+#include <caf/telemetry/metric_registry.hpp>
 #include <caf/unit.hpp>
 
 #include "broker/atoms.hh"
 #include "broker/convert.hh"
 #include "broker/data.hh"
+#include "broker/defaults.hh"
 #include "broker/store.hh"
 #include "broker/time.hh"
 #include "broker/topic.hh"
 
 #include "broker/detail/abstract_backend.hh"
+#include "broker/detail/assert.hh"
+#include "broker/detail/caching_backend.hh"
 #include "broker/detail/die.hh"
+#include "broker/detail/key_range.hh"
 #include "broker/detail/master_actor.hh"
 
 namespace broker {
@@ -36,41 +48,189 @@ void master_state::init(caf::event_based_actor* ptr, std::string&& nm,
   super::init(ptr, ep_clock, std::move(nm), std::move(parent));
   clones_topic = id / topics::clone_suffix;
   backend = std::move(bp);
-  if (auto es = backend->expiries()) {
-    for (auto& e : *es) {
-      auto& key = e.first;
-      auto& expire_time = e.second;
-      auto n = clock->now();
-      auto dur = expire_time - n;
-      auto msg = caf::make_message(atom::expire_v, std::move(key));
-      clock->send_later(self, dur, std::move(msg));
-    }
-  } else {
-    die("failed to get master expiries while initializing");
+  // Shards of the same store share their metrics, since CAF returns the
+  // same counter for the same labels.
+  if (auto cache = dynamic_cast<caching_backend*>(backend.get())) {
+    auto& reg = self->system().metrics();
+    auto hits = reg.counter_instance("broker", "store-cache-hits",
+                                     {{"name", id}},
+                                     "Number of lookups that the cache of a "
+                                     "master answered.",
+                                     "1", true);
+    auto misses = reg.counter_instance("broker", "store-cache-misses",
+                                       {{"name", id}},
+                                       "Number of lookups that went past the "
+                                       "cache of a master to its backend.",
+                                       "1", true);
+    cache->metrics(hits, misses);
   }
+  snapshot_chunk_size
+    = std::max(caf::get_or(self->system().config(),
+                           "broker.store.snapshot-chunk-size",
+                           defaults::store::snapshot_chunk_size),
+               size_t{1});
+  snapshot_credit
+    = std::max(caf::get_or(self->system().config(),
+                           "broker.store.snapshot-credit",
+                           defaults::store::snapshot_credit),
+               size_t{1});
+  // Shards leave the mutation log to their coordinator.
+  if (coordinator == nullptr)
+    mutation_log_size = caf::get_or(self->system().config(),
+                                    "broker.store.mutation-log-size",
+                                    defaults::store::mutation_log_size);
+  auto resolution = caf::get_or(self->system().config(),
+                                "broker.store.expiry-resolution",
+                                defaults::store::expiry_resolution);
+  if (resolution.count() <= 0)
+    resolution = defaults::store::expiry_resolution;
+  expirations = std::make_unique<timer_wheel>(resolution, clock->now());
+  batch_window = caf::get_or(self->system().config(),
+                             "broker.store.batch-window",
+                             defaults::store::batch_window);
+  auto schedule = [this](const data& key, timestamp expire_time) {
+    expirations->schedule(key, expire_time);
+  };
+  if (backend && !backend->for_each_expiry(schedule))
+    die("failed to get master expiries while initializing");
+  schedule_tick();
 }
 
 void master_state::broadcast(internal_command&& x) {
+  if (coordinator) {
+    std::vector<internal_command> xs;
+    xs.emplace_back(std::move(x));
+    self->send(coordinator, atom::publish_v, std::move(xs));
+    return;
+  }
+  if (batch_window.count() > 0) {
+    pending_commands.emplace_back(std::move(x));
+    schedule_publish();
+    return;
+  }
   self->send(core, atom::publish_v,
              make_command_message(clones_topic, std::move(x)));
 }
 
+void master_state::broadcast(std::vector<internal_command>&& xs) {
+  if (xs.empty())
+    return;
+  if (coordinator) {
+    self->send(coordinator, atom::publish_v, std::move(xs));
+    return;
+  }
+  if (batch_window.count() > 0) {
+    pending_commands.insert(pending_commands.end(),
+                            std::make_move_iterator(xs.begin()),
+                            std::make_move_iterator(xs.end()));
+    schedule_publish();
+    return;
+  }
+  publish(xs);
+}
+
+void master_state::publish(std::vector<internal_command>& xs) {
+  batch_commands(xs);
+  if (xs.size() == 1) {
+    self->send(core, atom::publish_v,
+               make_command_message(clones_topic, std::move(xs.front())));
+    return;
+  }
+  std::vector<command_message> msgs;
+  msgs.reserve(xs.size());
+  for (auto& x : xs)
+    msgs.emplace_back(make_command_message(clones_topic, std::move(x)));
+  self->send(core, atom::publish_v, std::move(msgs));
+}
+
+void master_state::publish_pending() {
+  publish_scheduled = false;
+  if (pending_commands.empty())
+    return;
+  auto xs = std::move(pending_commands);
+  pending_commands.clear();
+  BROKER_DEBUG("publish" << xs.size() << "pending commands to" << clones.size()
+                         << "clones");
+  if (!clones.empty())
+    publish(xs);
+}
+
+void master_state::schedule_publish() {
+  if (publish_scheduled)
+    return;
+  publish_scheduled = true;
+  clock->send_later(self, batch_window,
+                    caf::make_message(atom::tick_v, atom::publish_v));
+}
+
+void master_state::record(const internal_command& x) {
+  auto n = mutation_count(x.content);
+  if (n == 0)
+    return;
+  // We only record regular updates, i.e., each log entry has a count of 1.
+  BROKER_ASSERT(n == 1);
+  ++seq;
+  if (mutation_log_size == 0)
+    return;
+  mutation_log.emplace_back(x);
+  if (mutation_log.size() > mutation_log_size)
+    mutation_log.pop_front();
+}
+
+optional<std::vector<internal_command>>
+master_state::delta_since(uint64_t clone_seq) {
+  if (clone_seq > seq || seq - clone_seq > mutation_log.size())
+    return nil;
+  auto first = mutation_log.end() - static_cast<ptrdiff_t>(seq - clone_seq);
+  return std::vector<internal_command>(first, mutation_log.end());
+}
+
 void master_state::remind(timespan expiry, const data& key) {
-  auto msg = caf::make_message(atom::expire_v, key);
-  clock->send_later(self, expiry, std::move(msg));
-}
-
-void master_state::expire(data& key) {
-  BROKER_INFO("EXPIRE" << key);
-  if (auto result = backend->expire(key, clock->now()); !result) {
-    BROKER_ERROR("EXPIRE" << key << "(FAILED)" << to_string(result.error()));
-  } else if (!*result) {
-    BROKER_INFO("EXPIRE" << key << "(IGNORE/STALE)");
-  } else {
-    expire_command cmd{std::move(key), publisher_id{self->node(), self->id()}};
-    emit_expire_event(cmd);
-    broadcast_cmd_to_clones(std::move(cmd));
+  expirations->schedule(key, clock->now() + expiry);
+  schedule_tick();
+}
+
+void master_state::tick() {
+  tick_scheduled = false;
+  auto now = clock->now();
+  if (auto due = expirations->advance(now); !due.empty()) {
+    publisher_id publisher{self->node(), self->id()};
+    // The backend removes all due keys at once, including keys with reminders
+    // that fall into a later slot of the wheel.
+    auto keys = backend->expire_due(now);
+    if (!keys) {
+      BROKER_ERROR("EXPIRE (FAILED)" << to_string(keys.error()));
+      // Put the keys back into the wheel to try again at the next tick.
+      for (auto& key : due)
+        expirations->schedule(key, now);
+      schedule_tick();
+      return;
+    }
+    std::vector<internal_command> cmds;
+    for (auto& key : *keys) {
+      BROKER_INFO("EXPIRE" << key);
+      expire_command cmd{std::move(key), publisher};
+      emit_expire_event(cmd);
+      internal_command x{std::move(cmd)};
+      record(x);
+      if (replicates())
+        cmds.emplace_back(std::move(x));
+    }
+    BROKER_DEBUG("expired" << keys->size() << "keys, broadcast" << cmds.size()
+                           << "commands to" << clones.size() << "clones");
+    broadcast(std::move(cmds));
+    schedule_flush();
   }
+  schedule_tick();
+}
+
+void master_state::schedule_tick() {
+  if (tick_scheduled || expirations->empty())
+    return;
+  tick_scheduled = true;
+  auto now = clock->now();
+  clock->send_later(self, expirations->next_tick(now) - now,
+                    caf::make_message(atom::tick_v, atom::expire_v));
 }
 
 void master_state::command(internal_command& cmd) {
@@ -78,29 +238,219 @@ void master_state::command(internal_command& cmd) {
 }
 
 void master_state::command(internal_command::variant_type& cmd) {
+  if (!shards.empty()) {
+    route(cmd);
+    return;
+  }
   caf::visit(*this, cmd);
+  schedule_flush();
+}
+
+size_t master_state::shard_of(const data& key) const {
+  return std::hash<data>{}(key) % shards.size();
+}
+
+void master_state::route(internal_command::variant_type& cmd) {
+  auto send_to = [this](size_t i, auto x) {
+    self->send(shards[i], atom::local_v, internal_command{std::move(x)});
+  };
+  auto f = [&](auto& x) {
+    using type = std::decay_t<decltype(x)>;
+    if constexpr (std::is_same_v<type, put_command>
+                  || std::is_same_v<type, put_unique_command>
+                  || std::is_same_v<type, erase_command>
+                  || std::is_same_v<type, add_command>
+                  || std::is_same_v<type, subtract_command>) {
+      send_to(shard_of(x.key), std::move(x));
+    } else if constexpr (std::is_same_v<type, put_batch_command>) {
+      std::vector<std::vector<std::pair<data, data>>> entries(shards.size());
+      for (auto& kvp : x.entries)
+        entries[shard_of(kvp.first)].emplace_back(std::move(kvp));
+      for (size_t i = 0; i < shards.size(); ++i)
+        if (!entries[i].empty())
+          send_to(i, put_batch_command{std::move(entries[i]), x.expiry,
+                                       x.publisher});
+    } else if constexpr (std::is_same_v<type, clear_command>) {
+      for (size_t i = 0; i < shards.size(); ++i)
+        send_to(i, x);
+    } else {
+      // Snapshot requests and invalid commands.
+      (*this)(x);
+    }
+  };
+  caf::visit(f, cmd);
+}
+
+void master_state::replicate(size_t i, std::vector<internal_command>& xs) {
+  std::vector<internal_command> cmds;
+  for (auto& x : xs) {
+    if (pending_clears > 0 && cleared_shards[i]) {
+      held_commands[i].emplace_back(std::move(x));
+      continue;
+    }
+    if (caf::holds_alternative<clear_command>(x.content)) {
+      if (pending_clears == 0)
+        pending_clears = shards.size();
+      cleared_shards[i] = true;
+      if (--pending_clears > 0)
+        continue;
+      // All shards have cleared their backend. Clones receive all mutations
+      // from before the clear, the clear itself and then all mutations that
+      // we have held back in the meantime.
+      record(x);
+      if (!clones.empty())
+        cmds.emplace_back(std::move(x));
+      broadcast(std::move(cmds));
+      cmds.clear();
+      std::fill(cleared_shards.begin(), cleared_shards.end(), false);
+      auto held = std::move(held_commands);
+      held_commands.clear();
+      held_commands.resize(shards.size());
+      for (size_t j = 0; j < held.size(); ++j)
+        replicate(j, held[j]);
+      continue;
+    }
+    record(x);
+    if (!clones.empty())
+      cmds.emplace_back(std::move(x));
+  }
+  broadcast(std::move(cmds));
+}
+
+void master_state::start_snapshot(const caf::actor& clone) {
+  auto& t = snapshot_transfers[clone.address()];
+  t = snapshot_transfer{};
+  t.clone = clone;
+  t.id = ++next_transfer_id;
+  t.seq = seq;
+  send_snapshot_chunks(clone.address());
+}
+
+void master_state::send_snapshot_chunks(const caf::actor_addr& clone) {
+  auto i = snapshot_transfers.find(clone);
+  if (i == snapshot_transfers.end())
+    return;
+  auto& t = i->second;
+  if (!shards.empty()) {
+    // Each shard reads its chunks from its own backend. We only ask for the
+    // next chunk once the previous one has arrived.
+    if (t.fetching || t.in_flight >= snapshot_credit)
+      return;
+    t.fetching = true;
+    self->request(shards[t.shard], caf::infinite, atom::snapshot_v, t.next)
+      .then(
+        [this, clone, id{t.id}](broker::snapshot& chunk, optional<data>& next) {
+          relay_snapshot_chunk(clone, id, chunk, next);
+        },
+        [](const caf::error& err) {
+          die("failed to snapshot shard:", to_string(err));
+        });
+    return;
+  }
+  while (t.in_flight < snapshot_credit) {
+    broker::snapshot chunk;
+    auto last = read_snapshot_chunk(t.next, chunk);
+    self->send(t.clone, set_chunk_command{std::move(chunk), last, t.seq});
+    ++t.in_flight;
+    if (last) {
+      snapshot_transfers.erase(i);
+      return;
+    }
+  }
+}
+
+void master_state::ack_snapshot_chunk(const caf::actor_addr& clone) {
+  auto i = snapshot_transfers.find(clone);
+  if (i == snapshot_transfers.end())
+    return;
+  // A clone may still acknowledge chunks of a previous transfer.
+  if (i->second.in_flight > 0)
+    --i->second.in_flight;
+  send_snapshot_chunks(clone);
+}
+
+bool master_state::read_snapshot_chunk(optional<data>& next,
+                                       broker::snapshot& chunk) {
+  auto page = backend->scan(next, snapshot_chunk_size);
+  if (!page)
+    die("failed to snapshot master:", to_string(page.error()));
+  for (auto& [key, value] : page->entries)
+    chunk.emplace(std::move(key), std::move(value));
+  next = std::move(page->next);
+  return !next;
+}
+
+void master_state::relay_snapshot_chunk(const caf::actor_addr& clone,
+                                        uint64_t transfer,
+                                        broker::snapshot& chunk,
+                                        optional<data>& next) {
+  auto i = snapshot_transfers.find(clone);
+  if (i == snapshot_transfers.end() || i->second.id != transfer)
+    return;
+  auto& t = i->second;
+  t.fetching = false;
+  t.next = std::move(next);
+  auto last = !t.next && ++t.shard == shards.size();
+  if (!chunk.empty() || last) {
+    self->send(t.clone, set_chunk_command{std::move(chunk), last, t.seq});
+    ++t.in_flight;
+  }
+  if (last)
+    snapshot_transfers.erase(i);
+  else
+    send_snapshot_chunks(clone);
+}
+
+void master_state::schedule_flush() {
+  if (flush_scheduled)
+    return;
+  if (auto interval = backend->batch_interval()) {
+    flush_scheduled = true;
+    clock->send_later(self, *interval, caf::make_message(atom::flush_v));
+  }
+}
+
+void master_state::flush() {
+  flush_scheduled = false;
+  if (auto res = backend->flush(); !res)
+    BROKER_ERROR("failed to flush the backend:" << res.error());
 }
 
 void master_state::operator()(none) {
   BROKER_INFO("received empty command");
 }
 
-void master_state::operator()(put_command& x) {
+bool master_state::put(put_command& x) {
   BROKER_INFO("PUT" << x.key << "->" << x.value << "with expiry" << (x.expiry ? to_string(*x.expiry) : "none"));
   auto et = to_opt_timestamp(clock->now(), x.expiry);
-  auto old_value = backend->get(x.key);
-  auto result = backend->put(x.key, x.value, et);
-  if (!result) {
+  // Only event subscribers care about the previous value.
+  auto observed = has_event_subscribers();
+  optional<data> old_value;
+  if (observed) {
+    if (auto res = backend->put_returning_old(x.key, x.value, et); !res) {
+      BROKER_WARNING("failed to put" << x.key << "->" << x.value);
+      return false; // TODO: propagate failure? to all clones? as status msg?
+    } else {
+      old_value = std::move(*res);
+    }
+  } else if (auto res = backend->put(x.key, x.value, et); !res) {
     BROKER_WARNING("failed to put" << x.key << "->" << x.value);
-    return; // TODO: propagate failure? to all clones? as status msg?
+    return false; // TODO: propagate failure? to all clones? as status msg?
   }
   if (x.expiry)
     remind(*x.expiry, x.key);
-  if (old_value)
-    emit_update_event(x, *old_value);
-  else
-    emit_insert_event(x);
-  broadcast_cmd_to_clones(std::move(x));
+  if (observed) {
+    if (old_value)
+      emit_update_event(x, *old_value);
+    else
+      emit_insert_event(x);
+  }
+  return true;
+}
+
+void master_state::operator()(put_command& x) {
+  if (put(x))
+    broadcast_cmd_to_clones(std::move(x));
 }
 
 void master_state::operator()(put_unique_command& x) {
@@ -144,71 +494,60 @@ void master_state::operator()(expire_command&) {
 
 void master_state::operator()(add_command& x) {
   BROKER_INFO("ADD" << x);
-  auto old_value = backend->get(x.key);
   auto et = to_opt_timestamp(clock->now(), x.expiry);
-  if (auto res = backend->add(x.key, x.value, x.init_type, et); !res) {
+  auto observed = has_event_subscribers();
+  optional<data> old_value;
+  auto val = backend->add_returning_new(x.key, x.value, x.init_type, et,
+                                        observed ? &old_value : nullptr);
+  if (!val) {
     BROKER_WARNING("failed to add" << x.value << "to" << x.key << "->"
-                                   << res.error());
+                                   << val.error());
     return; // TODO: propagate failure? to all clones? as status msg?
   }
-  if (auto val = backend->get(x.key); !val) {
-    BROKER_ERROR("failed to get"
-                 << x.value << "after add() returned success:" << val.error());
-    return; // TODO: propagate failure? to all clones? as status msg?
-  } else {
-    if (x.expiry)
-      remind(*x.expiry, x.key);
-    // Broadcast a regular "put" command. Clones don't have to repeat the same
-    // processing again.
-    put_command cmd{std::move(x.key), std::move(*val), nil,
-                    std::move(x.publisher)};
+  if (x.expiry)
+    remind(*x.expiry, x.key);
+  // Broadcast a regular "put" command. Clones don't have to repeat the same
+  // processing again.
+  put_command cmd{std::move(x.key), std::move(*val), nil,
+                  std::move(x.publisher)};
+  if (observed) {
     if (old_value)
       emit_update_event(cmd, *old_value);
     else
       emit_insert_event(cmd);
-    broadcast_cmd_to_clones(std::move(cmd));
   }
+  broadcast_cmd_to_clones(std::move(cmd));
 }
 
 void master_state::operator()(subtract_command& x) {
   BROKER_INFO("SUBTRACT" << x);
   auto et = to_opt_timestamp(clock->now(), x.expiry);
-  auto old_value = backend->get(x.key);
-  if (!old_value) {
+  auto observed = has_event_subscribers();
+  data old_value;
+  auto val = backend->subtract_returning_new(x.key, x.value, et,
+                                             observed ? &old_value : nullptr);
+  if (!val) {
     // Unlike `add`, `subtract` fails if the key didn't exist previously.
-    BROKER_WARNING("cannot substract from non-existing value for key" << x.key);
-    return; // TODO: propagate failure? to all clones? as status msg?
-  }
-  if (auto res = backend->subtract(x.key, x.value, et); !res) {
-    BROKER_WARNING("failed to substract" << x.value << "from" << x.key);
-    return; // TODO: propagate failure? to all clones? as status msg?
-  }
-  if (auto val = backend->get(x.key); !val) {
-    BROKER_ERROR("failed to get"
-                 << x.value
-                 << "after subtract() returned success:" << val.error());
+    if (val.error() == ec::no_such_key) {
+      BROKER_WARNING("cannot substract from non-existing value for key"
+                     << x.key);
+    } else {
+      BROKER_WARNING("failed to substract" << x.value << "from" << x.key);
+    }
     return; // TODO: propagate failure? to all clones? as status msg?
-  } else {
-    if (x.expiry)
-      remind(*x.expiry, x.key);
-    // Broadcast a regular "put" command. Clones don't have to repeat the same
-    // processing again.
-    put_command cmd{std::move(x.key), std::move(*val), nil,
-                    std::move(x.publisher)};
-    emit_update_event(cmd, *old_value);
-    broadcast_cmd_to_clones(std::move(cmd));
   }
+  if (x.expiry)
+    remind(*x.expiry, x.key);
+  // Broadcast a regular "put" command. Clones don't have to repeat the same
+  // processing again.
+  put_command cmd{std::move(x.key), std::move(*val), nil,
+                  std::move(x.publisher)};
+  if (observed)
+    emit_update_event(cmd, old_value);
+  broadcast_cmd_to_clones(std::move(cmd));
 }
 
-void master_state::operator()(snapshot_command& x) {
-  BROKER_INFO("SNAPSHOT from" << to_string(x.remote_core));
-  if (x.remote_core == nullptr || x.remote_clone == nullptr) {
-    BROKER_INFO("snapshot command with invalid address received");
-    return;
-  }
-  auto ss = backend->snapshot();
-  if (!ss)
-    die("failed to snapshot master");
+bool master_state::add_clone(snapshot_command& x) {
   self->monitor(x.remote_core);
   clones.emplace(x.remote_core->address(), x.remote_clone);
 
@@ -218,19 +557,42 @@ void master_state::operator()(snapshot_command& x) {
   // received the now-outdated snapshot.
   broadcast_cmd_to_clones(snapshot_sync_command{x.remote_clone});
 
-  // TODO: possible improvements to do here
-  // (1) Use a separate *streaming* channel to send the snapshot.
-  //     A benefit of that would potentially be less latent queries
-  //     that go directly against the master store.
-  // (2) Always keep an updated snapshot in memory on the master to
-  //     avoid numerous expensive retrievals from persistent backends
-  //     in quick succession (e.g. at startup).
-  // (3) As an alternative to (2), give backends an API to stream
-  //     key-value pairs without ever needing the full snapshot in
-  //     memory.  Note that this would require halting the application
-  //     of updates on the master while there are any snapshot streams
-  //     still underway.
-  self->send(x.remote_clone, set_command{std::move(*ss)});
+  // Reconnecting clones may only need the mutations they missed.
+  auto clone_addr = x.remote_clone.address();
+  if (auto i = resync_offers.find(clone_addr); i != resync_offers.end()) {
+    auto clone_seq = i->second;
+    resync_offers.erase(i);
+    if (auto delta = delta_since(clone_seq)) {
+      BROKER_INFO("DELTA with" << delta->size() << "commands since"
+                                << clone_seq);
+      batch_commands(*delta);
+      self->send(x.remote_clone, delta_command{std::move(*delta), seq});
+      return true;
+    }
+    BROKER_INFO("mutation log lacks commands since" << clone_seq
+                                                    << "-> send snapshot");
+  }
+  return false;
+}
+
+void master_state::operator()(snapshot_command& x) {
+  BROKER_INFO("SNAPSHOT from" << to_string(x.remote_core));
+  if (x.remote_core == nullptr || x.remote_clone == nullptr) {
+    BROKER_INFO("snapshot command with invalid address received");
+    return;
+  }
+  if (add_clone(x))
+    return;
+
+  // We read the snapshot with a cursor and only send a few chunks ahead of
+  // the acknowledgements from the clone. Hence, we keep processing updates in
+  // between and neither side needs to hold the entire snapshot in memory. The
+  // chunks may already include some of the updates after the sync point. This
+  // is fine, since the clone applies all of these updates on top of the
+  // snapshot afterwards and each update replaces the previous state of a key.
+  // The coordinator of a sharded master collects the chunks from one shard
+  // after another.
+  start_snapshot(x.remote_clone);
 }
 
 void master_state::operator()(snapshot_sync_command&) {
@@ -243,18 +605,13 @@ void master_state::operator()(set_command& x) {
 
 void master_state::operator()(clear_command& x) {
   BROKER_INFO("CLEAR" << x);
-  if (auto keys_res = backend->keys(); !keys_res) {
-    BROKER_ERROR("unable to obtain keys:" << keys_res.error());
-    return;
-  } else {
-    if (auto keys = get_if<vector>(*keys_res)) {
-      for (auto& key : *keys)
-        emit_erase_event(key, x.publisher);
-    } else if (auto keys = get_if<set>(*keys_res)) {
-      for (auto& key : *keys)
-        emit_erase_event(key, x.publisher);
-    } else if (!is<none>(*keys_res)) {
-      BROKER_ERROR("backend->keys() returned an unexpected result type");
+  if (has_event_subscribers()) {
+    auto emit = [&](const data& key, data&, optional<timestamp>) {
+      emit_erase_event(key, x.publisher);
+    };
+    if (auto res = backend->for_each(emit); !res) {
+      BROKER_ERROR("unable to obtain keys:" << res.error());
+      return;
     }
   }
   if (auto res = backend->clear(); !res)
@@ -262,41 +619,345 @@ void master_state::operator()(clear_command& x) {
   broadcast_cmd_to_clones(std::move(x));
 }
 
+void master_state::operator()(put_batch_command& x) {
+  BROKER_INFO("PUT_BATCH" << x.entries.size() << "entries with expiry"
+                          << x.expiry);
+  // Clones receive a put for each entry. These go out in a single message and
+  // turn into a batch again if all clones support batch commands.
+  std::vector<internal_command> cmds;
+  cmds.reserve(x.entries.size());
+  for (auto& [key, value] : x.entries) {
+    put_command cmd{std::move(key), std::move(value), x.expiry, x.publisher};
+    if (!put(cmd))
+      continue;
+    internal_command y{std::move(cmd)};
+    record(y);
+    if (replicates())
+      cmds.emplace_back(std::move(y));
+  }
+  broadcast(std::move(cmds));
+}
+
+void master_state::operator()(erase_batch_command&) {
+  BROKER_ERROR("received an erase_batch_command in master actor");
+}
+
+void master_state::operator()(expire_batch_command&) {
+  BROKER_ERROR("received an expire_batch_command in master actor");
+}
+
 bool master_state::exists(const data& key) {
   if (auto res = backend->exists(key))
     return *res;
   return false;
 }
 
-caf::behavior master_actor(caf::stateful_actor<master_state>* self,
-                           caf::actor core, std::string id,
-                           master_state::backend_pointer backend,
-                           endpoint::clock* clock) {
-  self->monitor(core);
-  self->state.init(self, std::move(id), std::move(backend),
-                   std::move(core), clock);
-  self->set_down_handler(
-    [=](const caf::down_msg& msg) {
-      if (msg.source == core) {
-        BROKER_INFO("core is down, kill master as well");
-        self->quit(msg.reason);
-      } else {
-        BROKER_INFO("lost a clone");
-        self->state.clones.erase(msg.source);
+namespace {
+
+using master_actor_type = caf::stateful_actor<master_state>;
+
+// Stops the master when the core goes down and forgets lost clones.
+void set_master_down_handler(master_actor_type* self, caf::actor core) {
+  self->set_down_handler([=](const caf::down_msg& msg) {
+    if (msg.source == core) {
+      BROKER_INFO("core is down, kill master as well");
+      self->quit(msg.reason);
+    } else {
+      BROKER_INFO("lost a clone");
+      auto& st = self->state;
+      if (auto i = st.clones.find(msg.source); i != st.clones.end()) {
+        st.resync_offers.erase(i->second.address());
+        st.snapshot_transfers.erase(i->second.address());
+        st.clones.erase(i);
       }
     }
-  );
-  return {
+  });
+}
+
+// Returns the handlers for commands from the core, clones and the clock.
+// Regular and sharded masters process these messages in the same way.
+caf::message_handler master_handlers(master_actor_type* self) {
+  return caf::message_handler{
     // --- local communication -------------------------------------------------
     [=](atom::local, internal_command& x) {
       // treat locally and remotely received commands in the same way
       self->state.command(x);
     },
+    [=](atom::tick, atom::expire) {
+      self->state.tick();
+    },
+    [=](atom::tick, atom::publish) {
+      self->state.publish_pending();
+    },
+    [=](atom::clone, uint64_t clone_seq) {
+      // Reconnecting clones tell us the last mutation they have seen before
+      // requesting a snapshot.
+      BROKER_INFO("clone has seen mutations up to" << clone_seq);
+      auto addr = caf::actor_cast<caf::actor_addr>(self->current_sender());
+      self->state.resync_offers[addr] = clone_seq;
+    },
+    [=](atom::ack, atom::snapshot) {
+      // Clones acknowledge each snapshot chunk after applying it.
+      auto& st = self->state;
+      st.ack_snapshot_chunk(
+        caf::actor_cast<caf::actor_addr>(self->current_sender()));
+    },
+    [=](atom::get, atom::name) {
+      return self->state.id;
+    },
+    // --- stream handshake with core ------------------------------------------
+    [=](const store::stream_type& in) {
+      BROKER_DEBUG("received stream handshake from core");
+      attach_stream_sink(
+        self,
+        // input stream
+        in,
+        // initialize state
+        [](caf::unit_t&) {
+          // nop
+        },
+        // processing step
+        [=](caf::unit_t&, store::stream_type::value_type y) {
+          // TODO: our operator() overloads require mutable references, but
+          //       only a fraction actually benefit from it.
+          auto cmd = move_command(y);
+          self->state.command(cmd);
+        },
+        // cleanup
+        [](caf::unit_t&, const caf::error&) {
+          // nop
+        });
+    },
+  };
+}
+
+// -- fan-out to shards --------------------------------------------------------
+
+// Sends the request `req(i)` for each shard index `i` in `targets` and calls
+// `f` with all responses in the order of `targets` once every shard has
+// responded. Calls `g` with the first error instead.
+template <class T, class Request, class F, class G>
+void gather(master_actor_type* self, const std::vector<size_t>& targets,
+            Request req, F f, G g) {
+  struct responses {
+    std::vector<T> xs;
+    size_t pending;
+    bool failed;
+  };
+  auto rs = std::make_shared<responses>();
+  rs->xs.resize(targets.size());
+  rs->pending = targets.size();
+  rs->failed = false;
+  for (size_t pos = 0; pos < targets.size(); ++pos) {
+    req(targets[pos]).then(
+      [rs, pos, f](T& x) mutable {
+        if (rs->failed)
+          return;
+        rs->xs[pos] = std::move(x);
+        if (--rs->pending == 0)
+          f(rs->xs);
+      },
+      [rs, g](caf::error& err) mutable {
+        if (rs->failed)
+          return;
+        rs->failed = true;
+        g(err);
+      });
+  }
+}
+
+std::vector<size_t> all_shards(const master_state& st) {
+  std::vector<size_t> result(st.shards.size());
+  for (size_t i = 0; i < result.size(); ++i)
+    result[i] = i;
+  return result;
+}
+
+// Calls `f` with the union of the keys of all shards.
+template <class F>
+void fan_out_keys(master_actor_type* self, F f) {
+  gather<data>(
+    self, all_shards(self->state),
+    [self](size_t i) {
+      return self->request(self->state.shards[i], caf::infinite, atom::get_v,
+                           atom::keys_v);
+    },
+    [f](std::vector<data>& xs) mutable {
+      set result;
+      for (auto& x : xs)
+        if (auto keys = caf::get_if<set>(&x))
+          result.insert(std::make_move_iterator(keys->begin()),
+                        std::make_move_iterator(keys->end()));
+      expected<data> res{data{std::move(result)}};
+      f(res);
+    },
+    [f](caf::error& err) mutable {
+      expected<data> res{std::move(err)};
+      f(res);
+    });
+}
+
+// Calls `f` with the values of all `keys` that exist on any shard. Asks each
+// shard only for the keys it owns.
+template <class F>
+void fan_out_get_many(master_actor_type* self, const vector& keys, F f) {
+  auto& st = self->state;
+  std::vector<vector> parts(st.shards.size());
+  for (auto& key : keys)
+    parts[st.shard_of(key)].emplace_back(key);
+  std::vector<size_t> targets;
+  for (size_t i = 0; i < parts.size(); ++i)
+    if (!parts[i].empty())
+      targets.emplace_back(i);
+  if (targets.empty()) {
+    expected<data> res{data{table{}}};
+    f(res);
+    return;
+  }
+  gather<data>(
+    self, targets,
+    [&](size_t i) {
+      return self->request(st.shards[i], caf::infinite, atom::get_v,
+                           std::move(parts[i]));
+    },
+    [f](std::vector<data>& xs) mutable {
+      table result;
+      for (auto& x : xs)
+        if (auto entries = caf::get_if<table>(&x))
+          result.insert(std::make_move_iterator(entries->begin()),
+                        std::make_move_iterator(entries->end()));
+      expected<data> res{data{std::move(result)}};
+      f(res);
+    },
+    [f](caf::error& err) mutable {
+      expected<data> res{std::move(err)};
+      f(res);
+    });
+}
+
+// Calls `f` with a flag for each key in `keys` that tells whether any shard
+// has the key. Asks each shard only for the keys it owns.
+template <class F>
+void fan_out_exists_many(master_actor_type* self, const vector& keys, F f) {
+  auto& st = self->state;
+  std::vector<vector> parts(st.shards.size());
+  std::vector<std::vector<size_t>> positions(st.shards.size());
+  for (size_t pos = 0; pos < keys.size(); ++pos) {
+    auto i = st.shard_of(keys[pos]);
+    parts[i].emplace_back(keys[pos]);
+    positions[i].emplace_back(pos);
+  }
+  std::vector<size_t> targets;
+  for (size_t i = 0; i < parts.size(); ++i)
+    if (!parts[i].empty())
+      targets.emplace_back(i);
+  if (targets.empty()) {
+    expected<data> res{data{vector{}}};
+    f(res);
+    return;
+  }
+  gather<data>(
+    self, targets,
+    [&](size_t i) {
+      return self->request(st.shards[i], caf::infinite, atom::exists_v,
+                           std::move(parts[i]));
+    },
+    [f, n{keys.size()}, targets,
+     positions{std::move(positions)}](std::vector<data>& xs) mutable {
+      vector result(n);
+      for (size_t k = 0; k < xs.size(); ++k) {
+        auto flags = caf::get_if<vector>(&xs[k]);
+        auto& pos = positions[targets[k]];
+        if (flags == nullptr || flags->size() != pos.size()) {
+          expected<data> res{make_error(ec::invalid_data,
+                                        "unexpected response from shard")};
+          f(res);
+          return;
+        }
+        for (size_t j = 0; j < pos.size(); ++j)
+          result[pos[j]] = std::move((*flags)[j]);
+      }
+      expected<data> res{data{std::move(result)}};
+      f(res);
+    },
+    [f](caf::error& err) mutable {
+      expected<data> res{std::move(err)};
+      f(res);
+    });
+}
+
+// Calls `f` with the first page of `range` across all shards.
+template <class F>
+void fan_out_range(master_actor_type* self, const key_range& range, F f) {
+  gather<data>(
+    self, all_shards(self->state),
+    [&](size_t i) {
+      return self->request(self->state.shards[i], caf::infinite, atom::get_v,
+                           range);
+    },
+    [f, range, limit{self->state.range_page_size}](
+      std::vector<data>& xs) mutable {
+      // Each shard has returned all of its keys before the first key of its
+      // next page. Hence, the combined page must end before the smallest of
+      // these keys.
+      optional<data> next;
+      for (auto& x : xs)
+        if (auto page = caf::get_if<vector>(&x); page && page->size() > 1)
+          if (!next || (*page)[1] < *next)
+            next = (*page)[1];
+      range_page_builder builder{range, limit};
+      for (auto& x : xs)
+        if (auto page = caf::get_if<vector>(&x); page && !page->empty())
+          if (auto entries = caf::get_if<table>(&page->front()))
+            for (auto& [key, value] : *entries)
+              if (!next || key < *next)
+                builder.add(key, value);
+      auto result = std::move(builder).build();
+      if (!result.next)
+        result.next = std::move(next);
+      expected<data> res{make_range_page(std::move(result))};
+      f(res);
+    },
+    [f](caf::error& err) mutable {
+      expected<data> res{std::move(err)};
+      f(res);
+    });
+}
+
+void deliver(caf::response_promise& rp, expected<data>& x) {
+  if (x)
+    rp.deliver(std::move(*x));
+  else
+    rp.deliver(std::move(x.error()));
+}
+
+void deliver(caf::response_promise& rp, expected<data>& x, request_id id) {
+  if (x)
+    rp.deliver(std::move(*x), id);
+  else
+    rp.deliver(std::move(x.error()), id);
+}
+
+} // namespace
+
+caf::behavior master_actor(caf::stateful_actor<master_state>* self,
+                           caf::actor core, std::string id,
+                           master_state::backend_pointer backend,
+                           endpoint::clock* clock) {
+  self->monitor(core);
+  self->state.init(self, std::move(id), std::move(backend),
+                   caf::actor{core}, clock);
+  set_master_down_handler(self, std::move(core));
+  caf::message_handler handlers{
+    // --- local communication -------------------------------------------------
     [=](atom::sync_point, caf::actor& who) {
       self->send(who, atom::sync_point_v);
     },
-    [=](atom::expire, data& key) {
-      self->state.expire(key);
+    [=](atom::subscriptions, bool flag) {
+      self->state.event_subscribers = flag;
+    },
+    [=](atom::flush) {
+      self->state.flush();
     },
     [=](atom::get, atom::keys) -> caf::result<data> {
       auto x = self->state.backend->keys();
@@ -344,33 +1005,191 @@ caf::behavior master_actor(caf::stateful_actor<master_state>* self,
         return caf::make_message(std::move(*x), id);
       return caf::make_message(std::move(x.error()), id);
     },
-    [=](atom::get, atom::name) {
-      return self->state.id;
+    [=](atom::exists, const vector& keys) -> caf::result<data> {
+      auto x = self->state.backend->exists_many(keys);
+      BROKER_INFO("EXISTS" << keys.size() << "keys ->" << x);
+      return x;
     },
-    // --- stream handshake with core ------------------------------------------
-    [=](const store::stream_type& in) {
-      BROKER_DEBUG("received stream handshake from core");
-      attach_stream_sink(
-        self,
-        // input stream
-        in,
-        // initialize state
-        [](caf::unit_t&) {
-          // nop
+    [=](atom::exists, const vector& keys, request_id id) {
+      auto x = self->state.backend->exists_many(keys);
+      BROKER_INFO("EXISTS" << keys.size() << "keys with id:" << id << "->"
+                           << x);
+      if (x)
+        return caf::make_message(std::move(*x), id);
+      return caf::make_message(std::move(x.error()), id);
+    },
+    [=](atom::get, const vector& keys) -> caf::result<data> {
+      auto x = self->state.backend->get_many(keys);
+      BROKER_INFO("GET" << keys.size() << "keys ->" << x);
+      return x;
+    },
+    [=](atom::get, const vector& keys, request_id id) {
+      auto x = self->state.backend->get_many(keys);
+      BROKER_INFO("GET" << keys.size() << "keys with id:" << id << "->" << x);
+      if (x)
+        return caf::make_message(std::move(*x), id);
+      return caf::make_message(std::move(x.error()), id);
+    },
+    [=](atom::get, const key_range& range) -> caf::result<data> {
+      auto& st = self->state;
+      auto x = st.backend->range(range, st.range_page_size);
+      BROKER_INFO("RANGE" << range.lo << range.bound);
+      if (x)
+        return make_range_page(std::move(*x));
+      return std::move(x.error());
+    },
+    [=](atom::get, const key_range& range, request_id id) {
+      auto& st = self->state;
+      auto x = st.backend->range(range, st.range_page_size);
+      BROKER_INFO("RANGE" << range.lo << range.bound << "with id:" << id);
+      if (x)
+        return caf::make_message(make_range_page(std::move(*x)), id);
+      return caf::make_message(std::move(x.error()), id);
+    },
+    // --- communication with the coordinator of a sharded master --------------
+    [=](atom::sync_point) {
+      return atom::sync_point_v;
+    },
+    [=](atom::snapshot, optional<data>& next) {
+      broker::snapshot chunk;
+      self->state.read_snapshot_chunk(next, chunk);
+      return caf::make_message(std::move(chunk), std::move(next));
+    },
+  };
+  return handlers.or_else(master_handlers(self));
+}
+
+caf::behavior master_shard_actor(caf::stateful_actor<master_state>* self,
+                                 caf::actor core, caf::actor coordinator,
+                                 std::string id,
+                                 master_state::backend_pointer backend,
+                                 endpoint::clock* clock) {
+  self->state.coordinator = std::move(coordinator);
+  return master_actor(self, std::move(core), std::move(id), std::move(backend),
+                      clock);
+}
+
+caf::behavior
+sharded_master_actor(caf::stateful_actor<master_state>* self, caf::actor core,
+                     std::string id,
+                     std::vector<master_state::backend_pointer> backends,
+                     endpoint::clock* clock) {
+  self->monitor(core);
+  auto& st = self->state;
+  st.init(self, std::move(id), nullptr, caf::actor{core}, clock);
+  for (auto& backend : backends)
+    st.shards.emplace_back(self->spawn<caf::linked + caf::lazy_init>(
+      master_shard_actor, core, caf::actor_cast<caf::actor>(self), st.id,
+      std::move(backend), clock));
+  st.cleared_shards.resize(st.shards.size());
+  st.held_commands.resize(st.shards.size());
+  set_master_down_handler(self, std::move(core));
+  caf::message_handler handlers{
+    // --- communication with shards -------------------------------------------
+    [=](atom::publish, std::vector<internal_command>& xs) {
+      auto& shards = self->state.shards;
+      auto sender = caf::actor_cast<caf::actor_addr>(self->current_sender());
+      for (size_t i = 0; i < shards.size(); ++i) {
+        if (shards[i].address() == sender) {
+          self->state.replicate(i, xs);
+          return;
+        }
+      }
+      BROKER_ERROR("received mutations from an unknown shard");
+    },
+    // --- local communication -------------------------------------------------
+    [=](atom::sync_point, caf::actor& who) {
+      // Each shard has processed all previous commands once it responds.
+      gather<atom::sync_point>(
+        self, all_shards(self->state),
+        [=](size_t i) {
+          return self->request(self->state.shards[i], caf::infinite,
+                               atom::sync_point_v);
         },
-        // processing step
-        [=](caf::unit_t&, store::stream_type::value_type y) {
-          // TODO: our operator() overloads require mutable references, but
-          //       only a fraction actually benefit from it.
-          auto cmd = move_command(y);
-          self->state.command(cmd);
+        [=](std::vector<atom::sync_point>&) {
+          self->send(who, atom::sync_point_v);
         },
-        // cleanup
-        [](caf::unit_t&, const caf::error&) {
-          // nop
+        [](caf::error& err) {
+          BROKER_ERROR("failed to synchronize with shards:" << err);
         });
-    }
+    },
+    [=](atom::subscriptions, bool flag) {
+      self->state.event_subscribers = flag;
+      for (auto& shard : self->state.shards)
+        self->send(shard, atom::subscriptions_v, flag);
+    },
+    [=](atom::get, atom::keys) {
+      fan_out_keys(self, [rp{self->make_response_promise()}](
+                           expected<data>& x) mutable { deliver(rp, x); });
+    },
+    [=](atom::get, atom::keys, request_id id) {
+      fan_out_keys(self, [rp{self->make_response_promise()}, id](
+                           expected<data>& x) mutable { deliver(rp, x, id); });
+    },
+    [=](atom::exists, const data& key) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::exists_v, key);
+    },
+    [=](atom::exists, const data& key, request_id id) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::exists_v, key, id);
+    },
+    [=](atom::get, const data& key) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::get_v, key);
+    },
+    [=](atom::get, const data& key, const data& aspect) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::get_v, key, aspect);
+    },
+    [=](atom::get, const data& key, request_id id) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::get_v, key, id);
+    },
+    [=](atom::get, const data& key, const data& value, request_id id) {
+      auto& st = self->state;
+      auto& shard = st.shards[st.shard_of(key)];
+      return self->delegate(shard, atom::get_v, key, value, id);
+    },
+    [=](atom::exists, const vector& keys) {
+      fan_out_exists_many(self, keys,
+                          [rp{self->make_response_promise()}](
+                            expected<data>& x) mutable { deliver(rp, x); });
+    },
+    [=](atom::exists, const vector& keys, request_id id) {
+      fan_out_exists_many(self, keys,
+                          [rp{self->make_response_promise()}, id](
+                            expected<data>& x) mutable {
+                            deliver(rp, x, id);
+                          });
+    },
+    [=](atom::get, const vector& keys) {
+      fan_out_get_many(self, keys,
+                       [rp{self->make_response_promise()}](
+                         expected<data>& x) mutable { deliver(rp, x); });
+    },
+    [=](atom::get, const vector& keys, request_id id) {
+      fan_out_get_many(self, keys,
+                       [rp{self->make_response_promise()}, id](
+                         expected<data>& x) mutable { deliver(rp, x, id); });
+    },
+    [=](atom::get, const key_range& range) {
+      fan_out_range(self, range,
+                    [rp{self->make_response_promise()}](
+                      expected<data>& x) mutable { deliver(rp, x); });
+    },
+    [=](atom::get, const key_range& range, request_id id) {
+      fan_out_range(self, range,
+                    [rp{self->make_response_promise()}, id](
+                      expected<data>& x) mutable { deliver(rp, x, id); });
+    },
   };
+  return handlers.or_else(master_handlers(self));
 }
 
 } // namespace detail
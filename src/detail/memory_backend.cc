@@ -3,6 +3,7 @@
 #include <utility>
 
 #include "broker/detail/appliers.hh"
+#include "broker/detail/key_range.hh"
 #include "broker/detail/memory_backend.hh"
 
 namespace broker {
@@ -14,9 +15,29 @@ memory_backend::memory_backend(backend_options opts)
   // nop
 }
 
+void memory_backend::set_expiry(store_type::iterator i,
+                                optional<timestamp> expiry) {
+  auto& current = i->second.second;
+  if (current == expiry)
+    return;
+  if (current)
+    expirations_.erase(std::make_pair(*current, i->first));
+  if (expiry)
+    expirations_.emplace(*expiry, i->first);
+  current = expiry;
+}
+
+void memory_backend::erase(store_type::iterator i) {
+  if (auto& expiry = i->second.second)
+    expirations_.erase(std::make_pair(*expiry, i->first));
+  store_.erase(i);
+}
+
 expected<void>
 memory_backend::put(const data& key, data value, optional<timestamp> expiry) {
-  store_[key] = {std::move(value), std::move(expiry)};
+  auto i = store_.try_emplace(key).first;
+  i->second.first = std::move(value);
+  set_expiry(i, expiry);
   return {};
 }
 
@@ -27,12 +48,13 @@ expected<void> memory_backend::add(const data& key, const data& value,
   if (i == store_.end()) {
     if (init_type == data::type::none)
       return ec::type_clash;
-    auto newv = std::make_pair(data::from_type(init_type), expiry);
-    i = store_.emplace(std::move(key), std::move(newv)).first;
+    auto newv = std::make_pair(data::from_type(init_type),
+                               optional<timestamp>{});
+    i = store_.emplace(key, std::move(newv)).first;
   }
   auto result = caf::visit(adder{value}, i->second.first);
   if (result)
-    i->second.second = std::move(expiry);
+    set_expiry(i, expiry);
   return result;
 }
 
@@ -43,18 +65,70 @@ expected<void> memory_backend::subtract(const data& key, const data& value,
     return ec::no_such_key;
   auto result = caf::visit(remover{value}, i->second.first);
   if (result)
-    i->second.second = std::move(expiry);
+    set_expiry(i, expiry);
   return result;
 }
 
+expected<optional<data>>
+memory_backend::put_returning_old(const data& key, data value,
+                                  optional<timestamp> expiry) {
+  optional<data> old_value;
+  auto [i, added] = store_.try_emplace(key);
+  if (!added)
+    old_value = std::move(i->second.first);
+  i->second.first = std::move(value);
+  set_expiry(i, expiry);
+  return old_value;
+}
+
+expected<data> memory_backend::add_returning_new(const data& key,
+                                                 const data& value,
+                                                 data::type init_type,
+                                                 optional<timestamp> expiry,
+                                                 optional<data>* old_value) {
+  auto i = store_.find(key);
+  if (i == store_.end()) {
+    if (init_type == data::type::none)
+      return ec::type_clash;
+    if (old_value)
+      *old_value = nil;
+    auto newv = std::make_pair(data::from_type(init_type),
+                               optional<timestamp>{});
+    i = store_.emplace(key, std::move(newv)).first;
+  } else if (old_value) {
+    *old_value = i->second.first;
+  }
+  if (auto res = caf::visit(adder{value}, i->second.first); !res)
+    return res.error();
+  set_expiry(i, expiry);
+  return i->second.first;
+}
+
+expected<data>
+memory_backend::subtract_returning_new(const data& key, const data& value,
+                                       optional<timestamp> expiry,
+                                       data* old_value) {
+  auto i = store_.find(key);
+  if (i == store_.end())
+    return ec::no_such_key;
+  if (old_value)
+    *old_value = i->second.first;
+  if (auto res = caf::visit(remover{value}, i->second.first); !res)
+    return res.error();
+  set_expiry(i, expiry);
+  return i->second.first;
+}
+
 expected<void> memory_backend::erase(const data& key) {
-  store_.erase(key);
+  if (auto i = store_.find(key); i != store_.end())
+    erase(i);
   return {};
 }
 
 expected<void> memory_backend::clear() {
-   store_.clear();
-   return {};
+  store_.clear();
+  expirations_.clear();
+  return {};
 }
 
 expected<bool> memory_backend::expire(const data& key, timestamp ts) {
@@ -63,10 +137,21 @@ expected<bool> memory_backend::expire(const data& key, timestamp ts) {
     return false;
   if (!i->second.second || ts < i->second.second)
     return false;
-  store_.erase(i);
+  erase(i);
   return true;
 }
 
+expected<std::vector<data>> memory_backend::expire_due(timestamp ts) {
+  std::vector<data> result;
+  auto i = expirations_.begin();
+  for (; i != expirations_.end() && i->first <= ts; ++i) {
+    store_.erase(i->second);
+    result.emplace_back(i->second);
+  }
+  expirations_.erase(expirations_.begin(), i);
+  return {std::move(result)};
+}
+
 expected<data> memory_backend::get(const data& key) const {
   auto i = store_.find(key);
   if (i == store_.end())
@@ -108,13 +193,49 @@ expected<snapshot> memory_backend::snapshot() const {
 
 expected<expirables> memory_backend::expiries() const {
   expirables rval;
+  for (auto& [expiry, key] : expirations_)
+    rval.emplace_back(key, expiry);
+  return {std::move(rval)};
+}
 
-  for (auto& p : store_) {
-    if (p.second.second)
-      rval.emplace_back(expirable(p.first, *p.second.second));
+expected<void> memory_backend::for_each(const entry_visitor& f) const {
+  for (auto& [key, entry] : store_) {
+    auto value = entry.first;
+    f(key, value, entry.second);
   }
+  return {};
+}
 
-  return {std::move(rval)};
+expected<void>
+memory_backend::for_each_expiry(const expiry_visitor& f) const {
+  for (auto& [expiry, key] : expirations_)
+    f(key, expiry);
+  return {};
+}
+
+expected<scan_result> memory_backend::scan(const optional<data>& begin_key,
+                                           size_t limit) const {
+  auto i = begin_key ? store_.lower_bound(*begin_key) : store_.begin();
+  scan_result result;
+  for (; i != store_.end() && result.entries.size() < limit; ++i)
+    result.entries.emplace_back(i->first, i->second.first);
+  if (i != store_.end())
+    result.next = i->first;
+  return {std::move(result)};
+}
+
+expected<scan_result> memory_backend::range(const key_range& range,
+                                            size_t limit) const {
+  scan_result result;
+  auto i = store_.lower_bound(range.lo);
+  for (; i != store_.end() && range.before_end(i->first); ++i) {
+    if (result.entries.size() == limit) {
+      result.next = i->first;
+      break;
+    }
+    result.entries.emplace_back(i->first, i->second.first);
+  }
+  return {std::move(result)};
 }
 
 } // namespace detail
@@ -79,6 +79,24 @@ caf::error meta_command_writer::operator()(const clear_command& x) {
   return apply_tag(internal_command_uint_tag<clear_command>());
 }
 
+caf::error meta_command_writer::operator()(const put_batch_command& x) {
+  BROKER_TRY(apply_tag(internal_command_uint_tag<put_batch_command>()),
+             writer_.apply_container(x.entries));
+  return caf::none;
+}
+
+caf::error meta_command_writer::operator()(const erase_batch_command& x) {
+  BROKER_TRY(apply_tag(internal_command_uint_tag<erase_batch_command>()),
+             writer_.apply_container(x.keys));
+  return caf::none;
+}
+
+caf::error meta_command_writer::operator()(const expire_batch_command& x) {
+  BROKER_TRY(apply_tag(internal_command_uint_tag<expire_batch_command>()),
+             writer_.apply_container(x.keys));
+  return caf::none;
+}
+
 caf::error meta_command_writer::apply_tag(uint8_t tag) {
   auto& sink = writer_.sink();
   if (sink.value(tag))
@@ -0,0 +1,452 @@
+#include "broker/detail/ordered_encoding.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <caf/detail/type_list.hpp>
+
+#include "broker/address.hh"
+#include "broker/enum_value.hh"
+#include "broker/error.hh"
+#include "broker/port.hh"
+#include "broker/subnet.hh"
+#include "broker/time.hh"
+
+namespace broker::detail {
+
+namespace {
+
+// Marks the end of a container. Smaller than all type tags, which makes
+// shorter containers sort before longer containers with the same prefix.
+constexpr uint8_t end_of_container = 0;
+
+// Prefixes each value. Follows the order of the alternatives in `data`.
+template <class T>
+constexpr uint8_t tag_of
+  = static_cast<uint8_t>(caf::detail::tl_index_of<data::types, T>::value + 1);
+
+// Offset for the header byte of signed integers. Negative values use headers
+// below this offset and non-negative values use headers at or above it.
+constexpr uint8_t signed_offset = 0x80;
+
+constexpr uint64_t sign_bit = uint64_t{1} << 63;
+
+// Returns the minimum number of bytes for representing `x`.
+size_t byte_width(uint64_t x) {
+  size_t result = 0;
+  for (; x != 0; x >>= 8)
+    ++result;
+  return result;
+}
+
+class encoder {
+public:
+  explicit encoder(std::vector<uint8_t>& buf) : buf_(buf) {
+    // nop
+  }
+
+  void operator()(none) {
+    buf_.push_back(tag_of<none>);
+  }
+
+  void operator()(boolean x) {
+    buf_.push_back(tag_of<boolean>);
+    buf_.push_back(x ? 1 : 0);
+  }
+
+  void operator()(count x) {
+    buf_.push_back(tag_of<count>);
+    write_unsigned(x);
+  }
+
+  void operator()(integer x) {
+    buf_.push_back(tag_of<integer>);
+    write_signed(x);
+  }
+
+  void operator()(real x) {
+    buf_.push_back(tag_of<real>);
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    // Flip all bits of negative numbers to reverse their order and only the
+    // sign bit of positive numbers to move them after the negative ones.
+    bits = (bits & sign_bit) != 0 ? ~bits : bits | sign_bit;
+    write_bytes(bits, sizeof(bits));
+  }
+
+  void operator()(const std::string& x) {
+    buf_.push_back(tag_of<std::string>);
+    write_string(x);
+  }
+
+  void operator()(const address& x) {
+    buf_.push_back(tag_of<address>);
+    write_address(x);
+  }
+
+  void operator()(const subnet& x) {
+    buf_.push_back(tag_of<subnet>);
+    write_address(x.network());
+    buf_.push_back(x.length());
+  }
+
+  void operator()(const port& x) {
+    buf_.push_back(tag_of<port>);
+    write_bytes(x.number(), sizeof(port::number_type));
+    buf_.push_back(static_cast<uint8_t>(x.type()));
+  }
+
+  void operator()(timestamp x) {
+    buf_.push_back(tag_of<timestamp>);
+    write_signed(x.time_since_epoch().count());
+  }
+
+  void operator()(timespan x) {
+    buf_.push_back(tag_of<timespan>);
+    write_signed(x.count());
+  }
+
+  void operator()(const enum_value& x) {
+    buf_.push_back(tag_of<enum_value>);
+    write_string(x.name);
+  }
+
+  void operator()(const set& xs) {
+    buf_.push_back(tag_of<set>);
+    for (auto& x : xs)
+      (*this)(x);
+    buf_.push_back(end_of_container);
+  }
+
+  void operator()(const table& xs) {
+    buf_.push_back(tag_of<table>);
+    for (auto& [key, value] : xs) {
+      (*this)(key);
+      (*this)(value);
+    }
+    buf_.push_back(end_of_container);
+  }
+
+  void operator()(const vector& xs) {
+    buf_.push_back(tag_of<vector>);
+    for (auto& x : xs)
+      (*this)(x);
+    buf_.push_back(end_of_container);
+  }
+
+  void operator()(const data& x) {
+    caf::visit(*this, x);
+  }
+
+private:
+  // Writes the lower `n` bytes of `x` in network byte order.
+  void write_bytes(uint64_t x, size_t n) {
+    for (auto i = n; i > 0; --i)
+      buf_.push_back(static_cast<uint8_t>(x >> ((i - 1) * 8)));
+  }
+
+  // Writes the number of bytes followed by the bytes. Larger numbers need
+  // more bytes, so the header alone decides unless the widths are equal.
+  void write_unsigned(uint64_t x) {
+    auto n = byte_width(x);
+    buf_.push_back(static_cast<uint8_t>(n));
+    write_bytes(x, n);
+  }
+
+  // Writes non-negative numbers like unsigned numbers, but with an offset
+  // header. Negative numbers store the complement of their bitwise negation
+  // and a header that decreases with their width.
+  void write_signed(int64_t x) {
+    if (x >= 0) {
+      auto n = byte_width(static_cast<uint64_t>(x));
+      buf_.push_back(static_cast<uint8_t>(signed_offset + n));
+      write_bytes(static_cast<uint64_t>(x), n);
+    } else {
+      auto m = ~static_cast<uint64_t>(x);
+      auto n = byte_width(m);
+      buf_.push_back(static_cast<uint8_t>(signed_offset - 1 - n));
+      write_bytes(~m, n);
+    }
+  }
+
+  // Escapes zero bytes as `00 ff` and terminates the string with `00 01`.
+  void write_string(const std::string& x) {
+    for (auto c : x) {
+      auto byte = static_cast<uint8_t>(c);
+      buf_.push_back(byte);
+      if (byte == 0)
+        buf_.push_back(0xff);
+    }
+    buf_.push_back(0x00);
+    buf_.push_back(0x01);
+  }
+
+  void write_address(const address& x) {
+    auto& bytes = x.bytes();
+    buf_.insert(buf_.end(), bytes.begin(), bytes.end());
+  }
+
+  std::vector<uint8_t>& buf_;
+};
+
+class decoder {
+public:
+  decoder(const uint8_t* first, const uint8_t* last)
+    : pos_(first), end_(last) {
+    // nop
+  }
+
+  bool at_end() const {
+    return pos_ == end_;
+  }
+
+  bool read(data& x) {
+    uint8_t tag;
+    if (!read_byte(tag))
+      return false;
+    switch (tag) {
+      case tag_of<none>:
+        x = nil;
+        return true;
+      case tag_of<boolean>: {
+        uint8_t byte;
+        if (!read_byte(byte) || byte > 1)
+          return false;
+        x = byte == 1;
+        return true;
+      }
+      case tag_of<count>: {
+        uint64_t value;
+        if (!read_unsigned(value))
+          return false;
+        x = count{value};
+        return true;
+      }
+      case tag_of<integer>: {
+        int64_t value;
+        if (!read_signed(value))
+          return false;
+        x = integer{value};
+        return true;
+      }
+      case tag_of<real>: {
+        uint64_t bits;
+        if (!read_bytes(bits, sizeof(bits)))
+          return false;
+        bits = (bits & sign_bit) != 0 ? bits & ~sign_bit : ~bits;
+        real value;
+        std::memcpy(&value, &bits, sizeof(value));
+        x = value;
+        return true;
+      }
+      case tag_of<std::string>: {
+        std::string value;
+        if (!read_string(value))
+          return false;
+        x = std::move(value);
+        return true;
+      }
+      case tag_of<address>: {
+        address value;
+        if (!read_address(value))
+          return false;
+        x = value;
+        return true;
+      }
+      case tag_of<subnet>: {
+        address net;
+        uint8_t length;
+        if (!read_address(net) || !read_byte(length))
+          return false;
+        x = subnet{net, length};
+        return true;
+      }
+      case tag_of<port>: {
+        uint64_t number;
+        uint8_t protocol;
+        if (!read_bytes(number, sizeof(port::number_type))
+            || !read_byte(protocol)
+            || protocol > static_cast<uint8_t>(port::protocol::icmp))
+          return false;
+        x = port{static_cast<port::number_type>(number),
+                 static_cast<port::protocol>(protocol)};
+        return true;
+      }
+      case tag_of<timestamp>: {
+        int64_t value;
+        if (!read_signed(value))
+          return false;
+        x = timestamp{timespan{value}};
+        return true;
+      }
+      case tag_of<timespan>: {
+        int64_t value;
+        if (!read_signed(value))
+          return false;
+        x = timespan{value};
+        return true;
+      }
+      case tag_of<enum_value>: {
+        enum_value value;
+        if (!read_string(value.name))
+          return false;
+        x = std::move(value);
+        return true;
+      }
+      case tag_of<set>: {
+        set xs;
+        data element;
+        while (!read_end()) {
+          if (!read(element))
+            return false;
+          xs.emplace_hint(xs.end(), std::move(element));
+        }
+        x = std::move(xs);
+        return true;
+      }
+      case tag_of<table>: {
+        table xs;
+        data key;
+        data value;
+        while (!read_end()) {
+          if (!read(key) || !read(value))
+            return false;
+          xs.emplace_hint(xs.end(), std::move(key), std::move(value));
+        }
+        x = std::move(xs);
+        return true;
+      }
+      case tag_of<vector>: {
+        vector xs;
+        data element;
+        while (!read_end()) {
+          if (!read(element))
+            return false;
+          xs.emplace_back(std::move(element));
+        }
+        x = std::move(xs);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  // Returns whether decoding stopped at the end of a container. Also returns
+  // `true` when running out of input, which makes `read` fail afterwards.
+  bool read_end() {
+    if (pos_ != end_ && *pos_ != end_of_container)
+      return false;
+    if (pos_ == end_) {
+      failed_ = true;
+      return true;
+    }
+    ++pos_;
+    return true;
+  }
+
+  bool failed() const {
+    return failed_;
+  }
+
+private:
+  bool read_byte(uint8_t& x) {
+    if (pos_ == end_)
+      return false;
+    x = *pos_++;
+    return true;
+  }
+
+  bool read_bytes(uint64_t& x, size_t n) {
+    if (static_cast<size_t>(end_ - pos_) < n)
+      return false;
+    x = 0;
+    for (size_t i = 0; i < n; ++i)
+      x = (x << 8) | *pos_++;
+    return true;
+  }
+
+  bool read_unsigned(uint64_t& x) {
+    uint8_t n;
+    return read_byte(n) && n <= sizeof(uint64_t) && read_bytes(x, n);
+  }
+
+  bool read_signed(int64_t& x) {
+    uint8_t header;
+    if (!read_byte(header))
+      return false;
+    uint64_t bits;
+    if (header >= signed_offset) {
+      size_t n = header - signed_offset;
+      if (n > sizeof(uint64_t) || !read_bytes(bits, n))
+        return false;
+      x = static_cast<int64_t>(bits);
+      return x >= 0;
+    }
+    size_t n = signed_offset - 1 - header;
+    if (n > sizeof(uint64_t) || !read_bytes(bits, n))
+      return false;
+    // Undo the complement on the lower `n` bytes.
+    auto mask = n == sizeof(uint64_t) ? ~uint64_t{0}
+                                      : (uint64_t{1} << (n * 8)) - 1;
+    x = static_cast<int64_t>(~(~bits & mask));
+    return x < 0;
+  }
+
+  bool read_string(std::string& x) {
+    for (;;) {
+      uint8_t byte;
+      if (!read_byte(byte))
+        return false;
+      if (byte != 0) {
+        x.push_back(static_cast<char>(byte));
+        continue;
+      }
+      if (!read_byte(byte))
+        return false;
+      if (byte == 0x01)
+        return true;
+      if (byte != 0xff)
+        return false;
+      x.push_back('\0');
+    }
+  }
+
+  bool read_address(address& x) {
+    auto& bytes = x.bytes();
+    if (static_cast<size_t>(end_ - pos_) < bytes.size())
+      return false;
+    std::copy(pos_, pos_ + bytes.size(), bytes.begin());
+    pos_ += bytes.size();
+    return true;
+  }
+
+  const uint8_t* pos_;
+  const uint8_t* end_;
+  bool failed_ = false;
+};
+
+} // namespace
+
+void encode_ordered(const data& x, std::vector<uint8_t>& buf) {
+  encoder f{buf};
+  f(x);
+}
+
+std::vector<uint8_t> encode_ordered(const data& x) {
+  std::vector<uint8_t> result;
+  encode_ordered(x, result);
+  return result;
+}
+
+expected<data> decode_ordered(const void* buf, size_t size) {
+  auto first = static_cast<const uint8_t*>(buf);
+  decoder f{first, first + size};
+  data result;
+  if (!f.read(result) || f.failed() || !f.at_end())
+    return ec::invalid_data;
+  return {std::move(result)};
+}
+
+} // namespace broker::detail
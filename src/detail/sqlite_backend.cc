@@ -1,17 +1,20 @@
 #include "broker/logger.hh"
 
+#include <cctype>
+#include <chrono>
 #include <cstdio> // std::snprintf
 #include <utility>
 #include <cstdint>
 #include <set>
 #include <string>
+#include <tuple>
 #include <vector>
 
 #include <caf/binary_deserializer.hpp>
-#include <caf/binary_serializer.hpp>
 #include <caf/detail/scope_guard.hpp>
 
 #include "broker/config.hh"
+#include "broker/defaults.hh"
 #include "broker/version.hh"
 #include "broker/error.hh"
 #include "broker/expected.hh"
@@ -19,6 +22,8 @@
 #include "broker/detail/assert.hh"
 #include "broker/detail/appliers.hh"
 #include "broker/detail/filesystem.hh"
+#include "broker/detail/key_range.hh"
+#include "broker/detail/ordered_encoding.hh"
 #include "broker/detail/sqlite_backend.hh"
 
 #include "sqlite3.h"
@@ -31,15 +36,19 @@ auto make_statement_guard = [](sqlite3_stmt* stmt) {
   return caf::detail::make_scope_guard([=] { sqlite3_reset(stmt); });
 };
 
-template <class T>
-auto to_blob(const T& x) {
-  typename caf::binary_serializer::container_type buf;
-  caf::binary_serializer sink{nullptr, buf};
-  auto res = sink.apply(x);
-  return std::make_pair(res, std::move(buf));
+// Identifies the encoding of keys and values in the meta table.
+constexpr const char* encoding_key = "data_encoding";
+
+auto to_blob(const data& x) {
+  return std::make_pair(true, encode_ordered(x));
 }
 
 expected<data> from_blob(const void* buf, size_t size) {
+  return decode_ordered(buf, size);
+}
+
+// Decodes keys and values of databases that predate `encode_ordered`.
+expected<data> from_legacy_blob(const void* buf, size_t size) {
   caf::binary_deserializer sink{nullptr, buf, size};
   data result;
   if (sink.apply(result))
@@ -51,7 +60,11 @@ expected<data> from_blob(const void* buf, size_t size) {
 } // namespace
 
 struct sqlite_backend::impl {
+  using clock_type = std::chrono::steady_clock;
+
   impl(backend_options opts) : options{std::move(opts)} {
+    if (!read_batching_options())
+      return;
     auto i = options.find("path");
     if (i == options.end()) {
       BROKER_ERROR("SQLite backend options are missing required 'path' string");
@@ -68,6 +81,9 @@ struct sqlite_backend::impl {
   ~impl() {
     if (!db)
       return;
+    // Commit pending writes of the last batch.
+    if (in_transaction && !commit())
+      BROKER_ERROR("failed to commit pending writes to SQLite database");
     // Deallocate prepared statements.
     for (auto stmt : finalize)
       sqlite3_finalize(stmt);
@@ -96,6 +112,27 @@ struct sqlite_backend::impl {
       db = nullptr;
       return false;
     }
+    // Apply user-defined pragmas.
+    if (!journal_mode.empty()) {
+      auto sql = "pragma journal_mode=" + journal_mode + ";";
+      if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr)
+          != SQLITE_OK) {
+        BROKER_ERROR("failed to set journal mode" << journal_mode);
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+      }
+    }
+    if (!synchronous.empty()) {
+      auto sql = "pragma synchronous=" + synchronous + ";";
+      if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr)
+          != SQLITE_OK) {
+        BROKER_ERROR("failed to set synchronous mode" << synchronous);
+        sqlite3_close(db);
+        db = nullptr;
+        return false;
+      }
+    }
     // Create table for store meta data.
     result = sqlite3_exec(db,
                           "create table if not exists "
@@ -118,6 +155,23 @@ struct sqlite_backend::impl {
       db = nullptr;
       return false;
     }
+    // Convert keys and values of databases with an older encoding.
+    if (!migrate()) {
+      sqlite3_close(db);
+      db = nullptr;
+      return false;
+    }
+    // Index expiration times for expiring all due keys without a full scan.
+    result = sqlite3_exec(db,
+                          "create index if not exists store_expiry "
+                          "on store(expiry);",
+                          nullptr, nullptr, nullptr);
+    if (result != SQLITE_OK) {
+      BROKER_ERROR("failed to create expiry index");
+      sqlite3_close(db);
+      db = nullptr;
+      return false;
+    }
     // Store Broker version in meta table.
     char tmp[128];
     std::snprintf(tmp, sizeof(tmp),
@@ -137,6 +191,8 @@ struct sqlite_backend::impl {
       {&update, "update store set value = ?, expiry = ? where key = ?;"},
       {&erase, "delete from store where key = ?;"},
       {&expire, "delete from store where key = ? and expiry <= ?;"},
+      {&due, "select key from store where expiry <= ?;"},
+      {&expire_due, "delete from store where expiry <= ?;"},
 
       {&lookup, "select value from store where key = ?;"},
       {&exists, "select 1 from store where key = ?;"},
@@ -144,7 +200,16 @@ struct sqlite_backend::impl {
       {&snapshot, "select key, value from store;"},
       {&expiries, "select key, expiry from store where expiry is not null;"},
       {&clear, "delete from store;"},
+      {&begin, "begin transaction;"},
+      {&commit_stmt, "commit transaction;"},
       {&keys, "select key from store;"},
+      {&entries, "select key, value, expiry from store;"},
+      {&scan_first,
+       "select key, value from store order by key limit ?;"},
+      {&scan_from,
+       "select key, value from store where key >= ? order by key limit ?;"},
+      {&range_from,
+       "select key, value from store where key >= ? order by key;"},
     };
     auto prepare = [&](sqlite3_stmt** stmt, const char* sql) {
       finalize.push_back(*stmt);
@@ -160,6 +225,118 @@ struct sqlite_backend::impl {
     return true;
   }
 
+  bool exec(const char* sql) {
+    return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+  }
+
+  // Reads the version of the encoding for keys and values from the meta
+  // table. Databases without a version use the CAF binary serializer.
+  bool read_encoding_version(uint32_t& version) {
+    sqlite3_stmt* stmt = nullptr;
+    auto guard = caf::detail::make_scope_guard([&] {
+      sqlite3_finalize(stmt);
+    });
+    if (sqlite3_prepare_v2(db, "select value from meta where key = ?;", -1,
+                           &stmt, nullptr)
+          != SQLITE_OK
+        || sqlite3_bind_text(stmt, 1, encoding_key, -1, SQLITE_STATIC)
+             != SQLITE_OK)
+      return false;
+    switch (sqlite3_step(stmt)) {
+      case SQLITE_ROW:
+        version = static_cast<uint32_t>(sqlite3_column_int64(stmt, 0));
+        return true;
+      case SQLITE_DONE:
+        version = 0;
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Re-encodes all rows of the store table into a new table and replaces the
+  // store table with it.
+  bool convert_legacy_rows() {
+    if (!exec("create table store_converted"
+              "(key blob primary key, value blob, expiry integer);"))
+      return false;
+    sqlite3_stmt* select = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    auto guard = caf::detail::make_scope_guard([&] {
+      sqlite3_finalize(select);
+      sqlite3_finalize(insert);
+    });
+    if (sqlite3_prepare_v2(db, "select key, value, expiry from store;", -1,
+                           &select, nullptr)
+          != SQLITE_OK
+        || sqlite3_prepare_v2(db,
+                              "insert into store_converted(key, value, expiry) "
+                              "values(?, ?, ?);",
+                              -1, &insert, nullptr)
+             != SQLITE_OK)
+      return false;
+    auto result = SQLITE_DONE;
+    while ((result = sqlite3_step(select)) == SQLITE_ROW) {
+      auto key = from_legacy_blob(sqlite3_column_blob(select, 0),
+                                  sqlite3_column_bytes(select, 0));
+      auto value = from_legacy_blob(sqlite3_column_blob(select, 1),
+                                    sqlite3_column_bytes(select, 1));
+      if (!key || !value)
+        return false;
+      auto key_blob = encode_ordered(*key);
+      auto value_blob = encode_ordered(*value);
+      if (sqlite3_bind_blob64(insert, 1, key_blob.data(), key_blob.size(),
+                              SQLITE_STATIC)
+          != SQLITE_OK)
+        return false;
+      if (sqlite3_bind_blob64(insert, 2, value_blob.data(), value_blob.size(),
+                              SQLITE_STATIC)
+          != SQLITE_OK)
+        return false;
+      auto bound = SQLITE_OK;
+      if (sqlite3_column_type(select, 2) == SQLITE_NULL)
+        bound = sqlite3_bind_null(insert, 3);
+      else
+        bound = sqlite3_bind_int64(insert, 3, sqlite3_column_int64(select, 2));
+      if (bound != SQLITE_OK || sqlite3_step(insert) != SQLITE_DONE)
+        return false;
+      sqlite3_reset(insert);
+    }
+    return result == SQLITE_DONE && exec("drop table store;")
+           && exec("alter table store_converted rename to store;");
+  }
+
+  // Converts keys and values to the current encoding if necessary. Runs in a
+  // single transaction, i.e., either converts all rows or leaves the database
+  // untouched.
+  bool migrate() {
+    uint32_t version = 0;
+    if (!read_encoding_version(version)) {
+      BROKER_ERROR("failed to read the data encoding version");
+      return false;
+    }
+    if (version == ordered_encoding_version)
+      return true;
+    if (version > ordered_encoding_version) {
+      BROKER_ERROR("unsupported data encoding version" << version);
+      return false;
+    }
+    BROKER_INFO("convert SQLite database from data encoding"
+                << version << "to" << ordered_encoding_version);
+    char sql[128];
+    std::snprintf(sql, sizeof(sql),
+                  "replace into meta(key, value) values('%s', '%u');",
+                  encoding_key, ordered_encoding_version);
+    if (!exec("begin transaction;"))
+      return false;
+    if (!convert_legacy_rows() || !exec(sql) || !exec("commit transaction;")) {
+      BROKER_ERROR("failed to convert SQLite database:" << sqlite3_errmsg(db));
+      exec("rollback transaction;");
+      return false;
+    }
+    return true;
+  }
+
   bool modify(const data& key, const data& value,
               optional<timestamp> expiry) {
     auto [key_ok, key_blob] = to_blob(key);
@@ -203,19 +380,119 @@ struct sqlite_backend::impl {
     return sqlite3_step(update) == SQLITE_DONE;
   }
 
+  // Reads `batch-size`, `batch-interval`, `journal-mode` and `synchronous`.
+  bool read_batching_options() {
+    if (auto i = options.find("batch-size"); i != options.end()) {
+      if (auto n = caf::get_if<count>(&i->second)) {
+        batch_size = static_cast<size_t>(*n);
+      } else if (auto n = caf::get_if<integer>(&i->second); n && *n >= 0) {
+        batch_size = static_cast<size_t>(*n);
+      } else {
+        BROKER_ERROR("SQLite backend option 'batch-size' is not a count");
+        return false;
+      }
+    }
+    if (auto i = options.find("batch-interval"); i != options.end()) {
+      if (auto dt = caf::get_if<timespan>(&i->second)) {
+        batch_interval = *dt;
+      } else {
+        BROKER_ERROR("SQLite backend option 'batch-interval' is not a "
+                     "timespan");
+        return false;
+      }
+    }
+    auto read_enum = [&](const char* key, std::string& dst,
+                         std::initializer_list<const char*> choices) {
+      auto i = options.find(key);
+      if (i == options.end())
+        return true;
+      if (auto str = caf::get_if<std::string>(&i->second)) {
+        for (auto choice : choices) {
+          if (to_upper(*str) == choice) {
+            dst = choice;
+            return true;
+          }
+        }
+      }
+      BROKER_ERROR("SQLite backend option" << key << "has an invalid value");
+      return false;
+    };
+    return read_enum("journal-mode", journal_mode,
+                     {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"})
+           && read_enum("synchronous", synchronous,
+                        {"OFF", "NORMAL", "FULL", "EXTRA"});
+  }
+
+  static std::string to_upper(std::string str) {
+    for (auto& c : str)
+      c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    return str;
+  }
+
+  bool batching() const {
+    return batch_size > 1;
+  }
+
+  // Opens a new transaction if batching writes and none is active yet.
+  bool begin_write() {
+    if (!batching() || in_transaction)
+      return true;
+    auto guard = make_statement_guard(begin);
+    if (sqlite3_step(begin) != SQLITE_DONE)
+      return false;
+    in_transaction = true;
+    pending_writes = 0;
+    batch_start = clock_type::now();
+    return true;
+  }
+
+  // Commits the current transaction once reaching the size or time limit.
+  bool end_write() {
+    if (!in_transaction)
+      return true;
+    if (++pending_writes < batch_size
+        && clock_type::now() - batch_start < batch_interval)
+      return true;
+    return commit();
+  }
+
+  bool commit() {
+    auto guard = make_statement_guard(commit_stmt);
+    if (sqlite3_step(commit_stmt) != SQLITE_DONE)
+      return false;
+    in_transaction = false;
+    pending_writes = 0;
+    return true;
+  }
+
   backend_options options;
+  size_t batch_size = 1;
+  timespan batch_interval = defaults::store::sqlite_batch_interval;
+  std::string journal_mode;
+  std::string synchronous;
+  bool in_transaction = false;
+  size_t pending_writes = 0;
+  clock_type::time_point batch_start;
   sqlite3* db = nullptr;
   sqlite3_stmt* replace = nullptr;
   sqlite3_stmt* update = nullptr;
   sqlite3_stmt* erase = nullptr;
   sqlite3_stmt* expire = nullptr;
+  sqlite3_stmt* due = nullptr;
+  sqlite3_stmt* expire_due = nullptr;
   sqlite3_stmt* lookup = nullptr;
   sqlite3_stmt* exists = nullptr;
   sqlite3_stmt* size = nullptr;
   sqlite3_stmt* snapshot = nullptr;
   sqlite3_stmt* expiries = nullptr;
   sqlite3_stmt* clear = nullptr;
+  sqlite3_stmt* begin = nullptr;
+  sqlite3_stmt* commit_stmt = nullptr;
   sqlite3_stmt* keys = nullptr;
+  sqlite3_stmt* entries = nullptr;
+  sqlite3_stmt* scan_first = nullptr;
+  sqlite3_stmt* scan_from = nullptr;
+  sqlite3_stmt* range_from = nullptr;
   std::vector<sqlite3_stmt*> finalize;
 };
 
@@ -264,7 +541,8 @@ expected<void> sqlite_backend::put(const data& key, data value,
   if (result != SQLITE_OK)
     return ec::backend_failure;
   // Execute statement.
-  if (sqlite3_step(impl_->replace) != SQLITE_DONE)
+  if (!impl_->begin_write() || sqlite3_step(impl_->replace) != SQLITE_DONE
+      || !impl_->end_write())
     return ec::backend_failure;
   return {};
 }
@@ -272,32 +550,33 @@ expected<void> sqlite_backend::put(const data& key, data value,
 expected<void> sqlite_backend::add(const data& key, const data& value,
                                    data::type init_type,
                                    optional<timestamp> expiry) {
-  auto v = get(key);
-  data vv;
-  if (!v) {
-    if (v.error() != ec::no_such_key)
-      return v.error();
-    vv = data::from_type(init_type);
-  } else {
-    vv = std::move(*v);
-  }
-  auto result = caf::visit(adder{value}, vv);
-  if (!result)
-    return result;
-  return put(key, std::move(vv), expiry);
+  if (auto res = add_returning_new(key, value, init_type, expiry); !res)
+    return res.error();
+  return {};
 }
 
 expected<void> sqlite_backend::subtract(const data& key, const data& value,
                                         optional<timestamp> expiry) {
+  if (auto res = subtract_returning_new(key, value, expiry); !res)
+    return res.error();
+  return {};
+}
+
+expected<data>
+sqlite_backend::subtract_returning_new(const data& key, const data& value,
+                                       optional<timestamp> expiry,
+                                       data* old_value) {
   auto v = get(key);
   if (!v)
-    return v.error();
-  auto result = caf::visit(remover{value}, *v);
-  if (!result)
-    return result;
-  if (!impl_->modify(key, *v, expiry))
+    return v;
+  if (old_value)
+    *old_value = *v;
+  if (auto res = caf::visit(remover{value}, *v); !res)
+    return res.error();
+  if (!impl_->begin_write() || !impl_->modify(key, *v, expiry)
+      || !impl_->end_write())
     return ec::backend_failure;
-  return {};
+  return v;
 }
 
 expected<void> sqlite_backend::erase(const data& key) {
@@ -313,8 +592,10 @@ expected<void> sqlite_backend::erase(const data& key) {
                                     key_blob.size(), SQLITE_STATIC);
   if (result != SQLITE_OK)
     return ec::backend_failure;
-	result = sqlite3_step(impl_->erase);
-  if (result != SQLITE_DONE)
+  if (!impl_->begin_write())
+    return ec::backend_failure;
+  result = sqlite3_step(impl_->erase);
+  if (result != SQLITE_DONE || !impl_->end_write())
     return ec::backend_failure;
   //if (sqlite3_changes(impl_->db) == 0)
   //  return ec::no_such_key;
@@ -325,8 +606,10 @@ expected<void> sqlite_backend::clear() {
   if (!impl_->db)
     return ec::backend_failure;
   auto guard = make_statement_guard(impl_->clear);
+  if (!impl_->begin_write())
+    return ec::backend_failure;
   auto result = sqlite3_step(impl_->clear);
-  if (result != SQLITE_DONE)
+  if (result != SQLITE_DONE || !impl_->end_write())
     return ec::backend_failure;
   return {};
 }
@@ -350,10 +633,46 @@ expected<bool> sqlite_backend::expire(const data& key, timestamp ts) {
   if (result != SQLITE_OK)
     return ec::backend_failure;
   // Execute query.
-	result = sqlite3_step(impl_->expire);
+  if (!impl_->begin_write())
+    return ec::backend_failure;
+  result = sqlite3_step(impl_->expire);
   if (result != SQLITE_DONE)
     return ec::backend_failure;
-  return sqlite3_changes(impl_->db) == 1;
+  auto expired = sqlite3_changes(impl_->db) == 1;
+  if (!impl_->end_write())
+    return ec::backend_failure;
+  return expired;
+}
+
+expected<std::vector<data>> sqlite_backend::expire_due(timestamp ts) {
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto ts_count = ts.time_since_epoch().count();
+  // Collect the keys first, since the delete statement cannot return them.
+  std::vector<data> keys;
+  {
+    auto guard = make_statement_guard(impl_->due);
+    if (sqlite3_bind_int64(impl_->due, 1, ts_count) != SQLITE_OK)
+      return ec::backend_failure;
+    auto result = SQLITE_DONE;
+    while ((result = sqlite3_step(impl_->due)) == SQLITE_ROW) {
+      auto key = from_blob(sqlite3_column_blob(impl_->due, 0),
+                           sqlite3_column_bytes(impl_->due, 0));
+      if (!key)
+        return key.error();
+      keys.emplace_back(std::move(*key));
+    }
+    if (result != SQLITE_DONE)
+      return ec::backend_failure;
+  }
+  if (keys.empty())
+    return {std::move(keys)};
+  auto guard = make_statement_guard(impl_->expire_due);
+  if (sqlite3_bind_int64(impl_->expire_due, 1, ts_count) != SQLITE_OK
+      || !impl_->begin_write() || sqlite3_step(impl_->expire_due) != SQLITE_DONE
+      || !impl_->end_write())
+    return ec::backend_failure;
+  return {std::move(keys)};
 }
 
 expected<data> sqlite_backend::get(const data& key) const {
@@ -479,4 +798,144 @@ expected<expirables> sqlite_backend::expiries() const {
   return ec::backend_failure;
 }
 
+optional<timespan> sqlite_backend::batch_interval() const {
+  if (impl_->batching())
+    return impl_->batch_interval;
+  return nil;
+}
+
+expected<void> sqlite_backend::flush() {
+  if (!impl_->db)
+    return ec::backend_failure;
+  if (impl_->in_transaction && !impl_->commit())
+    return ec::backend_failure;
+  return {};
+}
+
+expected<void> sqlite_backend::for_each(const entry_visitor& f) const {
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto stmt = impl_->entries;
+  auto guard = make_statement_guard(stmt);
+  auto result = SQLITE_DONE;
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto key = from_blob(sqlite3_column_blob(stmt, 0),
+                         sqlite3_column_bytes(stmt, 0));
+    if (!key)
+      return key.error();
+    auto value = from_blob(sqlite3_column_blob(stmt, 1),
+                           sqlite3_column_bytes(stmt, 1));
+    if (!value)
+      return value.error();
+    optional<timestamp> expiry;
+    if (sqlite3_column_type(stmt, 2) != SQLITE_NULL)
+      expiry = timestamp{timespan{sqlite3_column_int64(stmt, 2)}};
+    f(*key, *value, expiry);
+  }
+  if (result != SQLITE_DONE)
+    return ec::backend_failure;
+  return {};
+}
+
+expected<void>
+sqlite_backend::for_each_expiry(const expiry_visitor& f) const {
+  if (!impl_->db)
+    return ec::backend_failure;
+  auto stmt = impl_->expiries;
+  auto guard = make_statement_guard(stmt);
+  auto result = SQLITE_DONE;
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto key = from_blob(sqlite3_column_blob(stmt, 0),
+                         sqlite3_column_bytes(stmt, 0));
+    if (!key)
+      return key.error();
+    f(*key, timestamp{timespan{sqlite3_column_int64(stmt, 1)}});
+  }
+  if (result != SQLITE_DONE)
+    return ec::backend_failure;
+  return {};
+}
+
+expected<scan_result> sqlite_backend::scan(const optional<data>& begin_key,
+                                           size_t limit) const {
+  if (!impl_->db)
+    return ec::backend_failure;
+  // Fetch one extra row to learn where the next page begins.
+  auto stmt = begin_key ? impl_->scan_from : impl_->scan_first;
+  auto guard = make_statement_guard(stmt);
+  auto result = SQLITE_OK;
+  auto pos = 1;
+  std::vector<uint8_t> key_blob;
+  if (begin_key) {
+    bool key_ok = false;
+    std::tie(key_ok, key_blob) = to_blob(*begin_key);
+    if (!key_ok) {
+      BROKER_DEBUG("sqlite_backend::scan: to_blob(key) failed");
+      return ec::invalid_data;
+    }
+    result = sqlite3_bind_blob64(stmt, pos++, key_blob.data(), key_blob.size(),
+                                 SQLITE_STATIC);
+    if (result != SQLITE_OK)
+      return ec::backend_failure;
+  }
+  result = sqlite3_bind_int64(stmt, pos, static_cast<int64_t>(limit) + 1);
+  if (result != SQLITE_OK)
+    return ec::backend_failure;
+  scan_result page;
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto key = from_blob(sqlite3_column_blob(stmt, 0),
+                         sqlite3_column_bytes(stmt, 0));
+    if (!key)
+      return key.error();
+    if (page.entries.size() == limit) {
+      page.next = std::move(*key);
+      break;
+    }
+    auto value = from_blob(sqlite3_column_blob(stmt, 1),
+                           sqlite3_column_bytes(stmt, 1));
+    if (!value)
+      return value.error();
+    page.entries.emplace_back(std::move(*key), std::move(*value));
+  }
+  if (result != SQLITE_DONE && result != SQLITE_ROW)
+    return ec::backend_failure;
+  return {std::move(page)};
+}
+
+expected<scan_result> sqlite_backend::range(const key_range& range,
+                                            size_t limit) const {
+  if (!impl_->db)
+    return ec::backend_failure;
+  // Keys sort in the order of `data`, so the range starts at the first key
+  // not less than `range.lo` and ends at the first key beyond its end.
+  auto stmt = impl_->range_from;
+  auto guard = make_statement_guard(stmt);
+  auto lo_blob = encode_ordered(range.lo);
+  auto result = sqlite3_bind_blob64(stmt, 1, lo_blob.data(), lo_blob.size(),
+                                    SQLITE_STATIC);
+  if (result != SQLITE_OK)
+    return ec::backend_failure;
+  scan_result page;
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    auto key = from_blob(sqlite3_column_blob(stmt, 0),
+                         sqlite3_column_bytes(stmt, 0));
+    if (!key)
+      return key.error();
+    if (!range.before_end(*key))
+      break;
+    if (page.entries.size() == limit) {
+      page.next = std::move(*key);
+      break;
+    }
+    auto value = from_blob(sqlite3_column_blob(stmt, 1),
+                           sqlite3_column_bytes(stmt, 1));
+    if (!value)
+      return value.error();
+    page.entries.emplace_back(std::move(*key), std::move(*value));
+  }
+  if (result != SQLITE_DONE && result != SQLITE_ROW)
+    return ec::backend_failure;
+  return {std::move(page)};
+}
+
 } // namespace broker::detail
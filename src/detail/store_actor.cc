@@ -1,5 +1,11 @@
 #include "broker/detail/store_actor.hh"
 
+#include <algorithm>
+
+#include <caf/actor_system_config.hpp>
+
+#include "broker/defaults.hh"
+
 using namespace std::string_literals;
 
 namespace broker::detail {
@@ -57,11 +63,17 @@ void store_actor_state::init(caf::event_based_actor* self,
   this->id = std::move(id);
   this->core = std::move(core);
   this->dst = topics::store_events / this->id;
+  range_page_size = std::max(caf::get_or(self->system().config(),
+                                         "broker.store.range-page-size",
+                                         defaults::store::range_page_size),
+                             size_t{1});
 }
 
 void store_actor_state::emit_insert_event(const data& key, const data& value,
                                           const optional<timespan>& expiry,
                                           const publisher_id& publisher) {
+  if (!event_subscribers)
+    return;
   vector xs;
   fill_vector(xs, "insert"s, id, key, value, expiry, publisher);
   self->send(core, atom::publish_v, atom::local_v,
@@ -73,6 +85,8 @@ void store_actor_state::emit_update_event(const data& key,
                                           const data& new_value,
                                           const optional<timespan>& expiry,
                                           const publisher_id& publisher) {
+  if (!event_subscribers)
+    return;
   vector xs;
   fill_vector(xs, "update"s, id, key, old_value, new_value, expiry, publisher);
   self->send(core, atom::publish_v, atom::local_v,
@@ -81,6 +95,8 @@ void store_actor_state::emit_update_event(const data& key,
 
 void store_actor_state::emit_erase_event(const data& key,
                                          const publisher_id& publisher) {
+  if (!event_subscribers)
+    return;
   vector xs;
   fill_vector(xs, "erase"s, id, key, publisher);
   self->send(core, atom::publish_v, atom::local_v,
@@ -89,6 +105,8 @@ void store_actor_state::emit_erase_event(const data& key,
 
 void store_actor_state::emit_expire_event(const data& key,
                                           const publisher_id& publisher) {
+  if (!event_subscribers)
+    return;
   vector xs;
   fill_vector(xs, "expire"s, id, key, publisher);
   self->send(core, atom::publish_v, atom::local_v,
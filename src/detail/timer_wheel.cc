@@ -0,0 +1,144 @@
+#include "broker/detail/timer_wheel.hh"
+
+#include <algorithm>
+#include <utility>
+
+#include "broker/detail/assert.hh"
+
+namespace broker::detail {
+
+timer_wheel::timer_wheel(timespan resolution, timestamp now)
+  : resolution_(resolution) {
+  BROKER_ASSERT(resolution.count() > 0);
+  next_ = tick_floor(now) + 1;
+}
+
+void timer_wheel::schedule(const data& key, timestamp deadline) {
+  auto t = tick_ceil(deadline);
+  auto [i, added] = deadlines_.emplace(key, t);
+  if (added) {
+    add(entry{key, t});
+  } else if (t < i->second) {
+    // The entry for the previous deadline becomes outdated.
+    i->second = t;
+    add(entry{key, t});
+  } else {
+    // The entry for the previous deadline moves itself when it comes up.
+    i->second = t;
+  }
+}
+
+std::vector<data> timer_wheel::advance(timestamp now) {
+  std::vector<data> fired;
+  auto target = tick_floor(now);
+  while (next_ <= target && !deadlines_.empty())
+    if (!skip_empty(target + 1))
+      step(fired);
+  if (deadlines_.empty() && next_ <= target) {
+    // Skip ahead. All remaining entries are outdated.
+    for (auto& lvl : levels_)
+      for (auto& xs : lvl)
+        xs.clear();
+    level_sizes_.fill(0);
+    overflow_.clear();
+    next_ = target + 1;
+  }
+  return fired;
+}
+
+timestamp timer_wheel::next_tick(timestamp now) const noexcept {
+  auto n = static_cast<timespan::rep>(tick_floor(now) + 1);
+  return timestamp{timespan{n * resolution_.count()}};
+}
+
+uint64_t timer_wheel::tick_ceil(timestamp t) const noexcept {
+  auto n = t.time_since_epoch().count();
+  if (n <= 0)
+    return 0;
+  auto r = resolution_.count();
+  return static_cast<uint64_t>((n + r - 1) / r);
+}
+
+uint64_t timer_wheel::tick_floor(timestamp t) const noexcept {
+  auto n = t.time_since_epoch().count();
+  if (n <= 0)
+    return 0;
+  return static_cast<uint64_t>(n / resolution_.count());
+}
+
+void timer_wheel::add(entry x) {
+  // Entries for past ticks go to the next slot, but keep their deadline.
+  auto t = std::max(x.tick, next_);
+  auto delta = t - next_;
+  for (size_t lvl = 0; lvl < num_levels; ++lvl) {
+    if (delta < (uint64_t{1} << (slot_bits * (lvl + 1)))) {
+      auto idx = (t >> (slot_bits * lvl)) & (slots_per_level - 1);
+      levels_[lvl][idx].emplace_back(std::move(x));
+      ++level_sizes_[lvl];
+      return;
+    }
+  }
+  overflow_.emplace_back(std::move(x));
+}
+
+size_t timer_wheel::cascade(size_t lvl) {
+  auto idx = (next_ >> (slot_bits * lvl)) & (slots_per_level - 1);
+  slot xs;
+  xs.swap(levels_[lvl][idx]);
+  level_sizes_[lvl] -= xs.size();
+  for (auto& x : xs)
+    add(std::move(x));
+  return idx;
+}
+
+void timer_wheel::step(std::vector<data>& fired) {
+  auto idx = next_ & (slots_per_level - 1);
+  if (idx == 0) {
+    // Move entries from higher levels down whenever a level wraps around.
+    size_t lvl = 1;
+    while (lvl < num_levels && cascade(lvl) == 0)
+      ++lvl;
+    if (lvl == num_levels) {
+      std::vector<entry> xs;
+      xs.swap(overflow_);
+      for (auto& x : xs)
+        add(std::move(x));
+    }
+  }
+  slot xs;
+  xs.swap(levels_[0][idx]);
+  level_sizes_[0] -= xs.size();
+  ++next_;
+  for (auto& x : xs) {
+    auto i = deadlines_.find(x.key);
+    if (i == deadlines_.end() || i->second < x.tick) {
+      // Outdated entry.
+      continue;
+    }
+    if (i->second > x.tick) {
+      // Someone moved the deadline.
+      x.tick = i->second;
+      add(std::move(x));
+      continue;
+    }
+    deadlines_.erase(i);
+    fired.emplace_back(std::move(x.key));
+  }
+}
+
+bool timer_wheel::skip_empty(uint64_t limit) {
+  // If the levels 0 to n are empty, nothing happens until the next tick that
+  // cascades entries from level n + 1 (or from the overflow list).
+  size_t n = 0;
+  while (n < num_levels && level_sizes_[n] == 0)
+    ++n;
+  if (n == 0)
+    return false;
+  auto block = uint64_t{1} << (slot_bits * n);
+  if (next_ % block == 0)
+    return false;
+  next_ = std::min((next_ / block + 1) * block, limit);
+  return true;
+}
+
+} // namespace broker::detail
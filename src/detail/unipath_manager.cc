@@ -80,16 +80,19 @@ public:
       super::dropped_messages(cache_.size());
   }
 
-  bool enqueue(item_scope scope, caf::span<const node_message> messages,
+  bool enqueue(item_scope scope, caf::span<const node_message* const> messages,
                long pending_handshakes) {
     BROKER_TRACE(BROKER_ARG(scope)
                  << BROKER_ARG(pending_handshakes)
                  << BROKER_ARG2("num-messages", messages.size()));
+    // Note: the central dispatcher selects messages for this path by looking
+    //       up the topic in its filter index. Hence, we don't need to check
+    //       our filter again.
     if (is_eligible<T>(scope)) {
-      prefix_matcher matches_filter;
       auto old_size = cache_.size();
-      for (const auto& msg : messages) {
-        if (is_eligible<T>(msg) && matches_filter(filter_, msg)) {
+      for (auto ptr : messages) {
+        const auto& msg = *ptr;
+        if (is_eligible<T>(msg)) {
           if constexpr (std::is_same<T, data_message>::value) {
             cache_.emplace_back(caf::get<data_message>(msg.content));
           } else if constexpr (std::is_same<T, command_message>::value) {
@@ -248,7 +251,7 @@ public:
   }
 
   bool enqueue(const unipath_manager* source, item_scope scope,
-               caf::span<const node_message> xs) override {
+               caf::span<const node_message* const> xs) override {
     if (source != this) {
       return out_.enqueue(scope, xs, pending_handshakes_);
     } else {
@@ -262,6 +265,7 @@ public:
 
   void filter(filter_type new_filter) override {
     BROKER_TRACE(BROKER_ARG(new_filter));
+    super::dispatcher_->filter_changed(this, out_.filter_, new_filter);
     out_.filter_ = std::move(new_filter);
   }
 
@@ -332,7 +336,7 @@ public:
   }
 
   bool enqueue(const unipath_manager*, item_scope,
-               caf::span<const node_message>) override {
+               caf::span<const node_message* const>) override {
     return false;
   }
 
@@ -15,6 +15,7 @@
 
 #include "broker/core_actor.hh"
 #include "broker/defaults.hh"
+#include "broker/detail/clone_view.hh"
 #include "broker/detail/die.hh"
 #include "broker/detail/filesystem.hh"
 #include "broker/endpoint.hh"
@@ -357,20 +358,35 @@ void endpoint::publish(const endpoint_info& dst, topic t, data d) {
                  make_data_message(std::move(t), std::move(d)));
 }
 
+void endpoint::publish(topic t, std::initializer_list<data> xs) {
+  publish(std::move(t), std::vector<data>{xs});
+}
+
+void endpoint::publish(topic t, std::vector<data> xs) {
+  BROKER_INFO("publishing" << xs.size() << "messages on" << t);
+  if (xs.empty())
+    return;
+  caf::anon_send(core(), atom::publish_v, std::move(t), std::move(xs));
+}
+
 void endpoint::publish(data_message x){
   BROKER_INFO("publishing" << x);
   caf::anon_send(core(), atom::publish_v, std::move(x));
 }
 
-
 void endpoint::publish(std::vector<data_message> xs) {
   BROKER_INFO("publishing" << xs.size() << "messages");
-  for (auto& x : xs)
-    publish(std::move(x));
+  if (xs.empty())
+    return;
+  caf::anon_send(core(), atom::publish_v, std::move(xs));
 }
 
 publisher endpoint::make_publisher(topic ts) {
-  publisher result{*this, std::move(ts)};
+  return make_publisher(std::move(ts), publisher_queue_type::locked);
+}
+
+publisher endpoint::make_publisher(topic ts, publisher_queue_type qtype) {
+  publisher result{*this, std::move(ts), qtype};
   children_.emplace_back(result.worker());
   return result;
 }
@@ -382,6 +398,10 @@ status_subscriber endpoint::make_status_subscriber(bool receive_statuses) {
 }
 
 subscriber endpoint::make_subscriber(std::vector<topic> ts, size_t max_qsize) {
+  if (max_qsize == 0)
+    max_qsize = std::max(get_or(config_, "broker.subscriber.queue-size",
+                                defaults::subscriber::queue_size),
+                         size_t{1});
   subscriber result{*this, std::move(ts), max_qsize};
   children_.emplace_back(result.worker());
   return result;
@@ -432,8 +452,8 @@ expected<store> endpoint::attach_clone(std::string name,
   self->request(core(), caf::infinite, atom::store_v, atom::clone_v,
                 atom::attach_v, name, resync_interval, stale_interval,
                 mutation_buffer_interval).receive(
-    [&](caf::actor& clone) {
-      res = store{std::move(clone), std::move(name)};
+    [&](caf::actor& clone, detail::clone_view_ptr& view) {
+      res = store{std::move(clone), std::move(name), std::move(view)};
     },
     [&](caf::error& e) {
       res = std::move(e);
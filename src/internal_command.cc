@@ -1,9 +1,108 @@
 #include "broker/internal_command.hh"
 
+#include <type_traits>
+
 namespace broker {
 
 internal_command::internal_command(variant_type x) : content(std::move(x)) {
   // nop
 }
 
+namespace {
+
+put_batch_command to_batch(put_command&& x) {
+  put_batch_command result{{}, x.expiry, std::move(x.publisher)};
+  result.entries.emplace_back(std::move(x.key), std::move(x.value));
+  return result;
+}
+
+erase_batch_command to_batch(erase_command&& x) {
+  erase_batch_command result{{}, std::move(x.publisher)};
+  result.keys.emplace_back(std::move(x.key));
+  return result;
+}
+
+expire_batch_command to_batch(expire_command&& x) {
+  expire_batch_command result{{}, std::move(x.publisher)};
+  result.keys.emplace_back(std::move(x.key));
+  return result;
+}
+
+void append(put_batch_command& xs, put_command&& x) {
+  xs.entries.emplace_back(std::move(x.key), std::move(x.value));
+}
+
+void append(erase_batch_command& xs, erase_command&& x) {
+  xs.keys.emplace_back(std::move(x.key));
+}
+
+void append(expire_batch_command& xs, expire_command&& x) {
+  xs.keys.emplace_back(std::move(x.key));
+}
+
+/// Tries to merge `next` into `prev`, turning `prev` into a batch if needed.
+template <class Batch, class Command>
+bool merge(internal_command::variant_type& prev, Command& next) {
+  auto compatible = [&next](const auto& x) {
+    if constexpr (std::is_same<Command, put_command>::value)
+      return x.publisher == next.publisher && x.expiry == next.expiry;
+    else
+      return x.publisher == next.publisher;
+  };
+  if (auto batch = caf::get_if<Batch>(&prev); batch && compatible(*batch)) {
+    append(*batch, std::move(next));
+    return true;
+  }
+  if (auto single = caf::get_if<Command>(&prev); single && compatible(*single)) {
+    auto batch = to_batch(std::move(*single));
+    append(batch, std::move(next));
+    prev = std::move(batch);
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+size_t mutation_count(const internal_command::variant_type& x) {
+  auto f = [](const auto& cmd) -> size_t {
+    using type = std::decay_t<decltype(cmd)>;
+    if constexpr (std::is_same<type, put_batch_command>::value)
+      return cmd.entries.size();
+    else if constexpr (std::is_same<type, erase_batch_command>::value
+                       || std::is_same<type, expire_batch_command>::value)
+      return cmd.keys.size();
+    else if constexpr (std::is_same<type, put_command>::value
+                       || std::is_same<type, erase_command>::value
+                       || std::is_same<type, expire_command>::value
+                       || std::is_same<type, clear_command>::value)
+      return 1;
+    else
+      return 0;
+  };
+  return caf::visit(f, x);
+}
+
+void batch_commands(std::vector<internal_command>& xs) {
+  if (xs.size() < 2)
+    return;
+  std::vector<internal_command> result;
+  result.reserve(xs.size());
+  for (auto& x : xs) {
+    auto merged = false;
+    if (!result.empty()) {
+      auto& prev = result.back().content;
+      if (auto put = caf::get_if<put_command>(&x.content))
+        merged = merge<put_batch_command>(prev, *put);
+      else if (auto erase = caf::get_if<erase_command>(&x.content))
+        merged = merge<erase_batch_command>(prev, *erase);
+      else if (auto expire = caf::get_if<expire_command>(&x.content))
+        merged = merge<expire_batch_command>(prev, *expire);
+    }
+    if (!merged)
+      result.emplace_back(std::move(x));
+  }
+  xs = std::move(result);
+}
+
 } // namespace broker
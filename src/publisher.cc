@@ -7,6 +7,7 @@
 #include <caf/send.hpp>
 
 #include "broker/data.hh"
+#include "broker/defaults.hh"
 #include "broker/endpoint.hh"
 #include "broker/message.hh"
 #include "broker/topic.hh"
@@ -17,19 +18,15 @@ namespace broker {
 
 namespace {
 
-// TODO: make these constants configurable
-
-/// Defines how many seconds are averaged for the computation of the send rate.
-constexpr size_t sample_size = 10;
-
-/// Defines how many items are stored in the queue.
-constexpr size_t queue_size = 30;
-
 struct publisher_worker_state {
   std::vector<size_t> buf;
   size_t counter = 0;
   bool shutting_down = false;
 
+  /// Defines how many seconds are averaged for the computation of the send
+  /// rate.
+  size_t sample_size = defaults::publisher::rate_sample_size;
+
   static const char* name;
 
   void tick() {
@@ -51,9 +48,14 @@ struct publisher_worker_state {
 
 const char* publisher_worker_state::name = "publisher_worker";
 
+template <class QueuePtr>
 behavior publisher_worker(stateful_actor<publisher_worker_state>* self,
-                          endpoint* ep,
-                          detail::shared_publisher_queue_ptr<> qptr) {
+                          endpoint* ep, QueuePtr qptr) {
+  self->state.sample_size
+    = std::max(get_or(self->system().config(),
+                      "broker.publisher.rate-sample-size",
+                      defaults::publisher::rate_sample_size),
+               size_t{1});
   auto handler
     = attach_stream_source(
         self, ep->core(),
@@ -96,12 +98,23 @@ behavior publisher_worker(stateful_actor<publisher_worker_state>* self,
 
 } // namespace <anonymous>
 
-publisher::publisher(endpoint& ep, topic t)
-  : drop_on_destruction_(false),
-    queue_(detail::make_shared_publisher_queue(queue_size)),
-    worker_(ep.system().spawn(publisher_worker, &ep, queue_)),
-    topic_(std::move(t)) {
-  // nop
+publisher::publisher(endpoint& ep, topic t, publisher_queue_type qtype)
+  : drop_on_destruction_(false), topic_(std::move(t)) {
+  auto& cfg = ep.system().config();
+  auto queue_size = std::max(get_or(cfg, "broker.publisher.queue-size",
+                                    defaults::publisher::queue_size),
+                             size_t{1});
+  auto max_queue_size = get_or(cfg, "broker.publisher.max-queue-size",
+                               defaults::publisher::max_queue_size);
+  auto spawn_worker = [&](auto qptr) {
+    worker_ = ep.system().spawn(publisher_worker<decltype(qptr)>, &ep, qptr);
+    queue_ = std::move(qptr);
+  };
+  if (qtype == publisher_queue_type::lock_free)
+    spawn_worker(detail::make_spsc_publisher_queue(queue_size));
+  else
+    spawn_worker(detail::make_shared_publisher_queue(queue_size,
+                                                     max_queue_size));
 }
 
 publisher::~publisher() {
@@ -109,16 +122,15 @@ publisher::~publisher() {
 }
 
 size_t publisher::demand() const {
-  return static_cast<size_t>(queue_->pending());
+  return visit_queue([](auto& q) { return static_cast<size_t>(q.pending()); });
 }
 
 size_t publisher::buffered() const {
-  return queue_->buffer_size();
-
+  return visit_queue([](auto& q) { return q.buffer_size(); });
 }
 
 size_t publisher::capacity() const {
-  return queue_->capacity();
+  return visit_queue([](auto& q) { return q.capacity(); });
 }
 
 size_t publisher::free_capacity() const {
@@ -128,7 +140,7 @@ size_t publisher::free_capacity() const {
 }
 
 size_t publisher::send_rate() const {
-  return static_cast<size_t>(queue_->rate());
+  return visit_queue([](auto& q) { return q.rate(); });
 }
 
 void publisher::drop_all_on_destruction() {
@@ -137,12 +149,13 @@ void publisher::drop_all_on_destruction() {
 
 void publisher::publish(data x) {
   BROKER_INFO("publishing" << std::make_pair(topic_, x));
-  if (queue_->produce(topic_, std::move(x)))
+  auto produce = [&](auto& q) { return q.produce(topic_, std::move(x)); };
+  if (visit_queue(produce))
     anon_send(worker_, atom::resume_v);
 }
 
 void publisher::publish(std::vector<data> xs) {
-  auto t = static_cast<ptrdiff_t>(queue_->capacity());
+  auto t = static_cast<ptrdiff_t>(capacity());
   auto i = xs.begin();
   auto e = xs.end();
   while (i != e) {
@@ -153,7 +166,8 @@ void publisher::publish(std::vector<data> xs) {
       BROKER_INFO("publishing" << std::make_pair(topic_, *l));
     }
 #endif
-    if (queue_->produce(topic_, i, j))
+    auto produce = [&](auto& q) { return q.produce(topic_, i, j); };
+    if (visit_queue(produce))
       anon_send(worker_, atom::resume_v);
     i = j;
   }
@@ -7,13 +7,14 @@
 #include <caf/actor_cast.hpp>
 #include <caf/error.hpp>
 #include <caf/make_message.hpp>
-#include <caf/scoped_actor.hpp>
 #include <caf/send.hpp>
 
 #include "broker/store.hh"
 #include "broker/expected.hh"
 #include "broker/internal_command.hh"
+#include "broker/detail/clone_view.hh"
 #include "broker/detail/flare_actor.hh"
+#include "broker/detail/key_range.hh"
 
 using namespace broker::detail;
 
@@ -37,6 +38,20 @@ request_id store::proxy::get(data key) {
   return id_;
 }
 
+request_id store::proxy::exists_many(std::vector<data> keys) {
+  if (!frontend_)
+    return 0;
+  send_as(proxy_, frontend_, atom::exists_v, std::move(keys), ++id_);
+  return id_;
+}
+
+request_id store::proxy::get_many(std::vector<data> keys) {
+  if (!frontend_)
+    return 0;
+  send_as(proxy_, frontend_, atom::get_v, std::move(keys), ++id_);
+  return id_;
+}
+
 request_id store::proxy::put_unique(data key, data val, optional<timespan> expiry) {
   if (!frontend_)
     return 0;
@@ -108,46 +123,89 @@ const std::string& store::name() const {
 }
 
 expected<data> store::exists(data key) const {
-  return request<data>(atom::exists_v, std::move(key));
+  if (view_)
+    return view_->exists(key);
+  return request(atom::exists_v, std::move(key));
 }
 
 expected<data> store::get(data key) const {
-  return request<data>(atom::get_v, std::move(key));
+  if (view_)
+    return view_->get(key);
+  return request(atom::get_v, std::move(key));
 }
 
-expected<data> store::put_unique(data key, data val, optional<timespan> expiry) const {
-  if (!frontend_)
-    return make_error(ec::unspecified, "store not initialized");
+expected<data> store::exists_many(std::vector<data> keys) const {
+  return request(atom::exists_v, std::move(keys));
+}
 
-  expected<data> res{ec::unspecified};
-  caf::scoped_actor self{frontend_->home_system()};
-  auto cmd = make_internal_command<put_unique_command>(
-    std::move(key), std::move(val), expiry, self, request_id(-1),
-    frontend_id());
-  auto msg = caf::make_message(atom::local_v, std::move(cmd));
-
-  self->send(frontend_, std::move(msg));
-  self->delayed_send(self, timeout::frontend, atom::tick_v);
-  self->receive(
-    [&](data& x, request_id) {
-      res = std::move(x);
-    },
-    [&](atom::tick) {
-    },
-    [&](caf::error& e) {
-      res = std::move(e);
-    }
-  );
+expected<data> store::get_many(std::vector<data> keys) const {
+  return request(atom::get_v, std::move(keys));
+}
+
+expected<data> store::get_range(data lo, data hi) const {
+  return get_pages(key_range::between(std::move(lo), std::move(hi)));
+}
+
+expected<data> store::get_prefix(data prefix) const {
+  return get_pages(key_range::starting_with(std::move(prefix)));
+}
+
+expected<void> store::for_each_range_page(data lo, data hi,
+                                          const page_handler& f) const {
+  return for_each_page(key_range::between(std::move(lo), std::move(hi)), f);
+}
+
+expected<void> store::for_each_prefix_page(data prefix,
+                                           const page_handler& f) const {
+  return for_each_page(key_range::starting_with(std::move(prefix)), f);
+}
 
-  return res;
+expected<data> store::get_pages(key_range range) const {
+  table result;
+  auto res = for_each_page(std::move(range), [&](table& page) {
+    result.merge(page);
+    return true;
+  });
+  if (!res)
+    return res.error();
+  return {std::move(result)};
+}
+
+expected<void> store::for_each_page(key_range range,
+                                    const page_handler& f) const {
+  for (;;) {
+    auto page = request(atom::get_v, range);
+    if (!page)
+      return page.error();
+    auto xs = caf::get_if<vector>(&*page);
+    if (xs == nullptr || xs->empty() || xs->size() > 2)
+      return make_error(ec::invalid_data, "invalid range page");
+    auto entries = caf::get_if<table>(&xs->front());
+    if (entries == nullptr)
+      return make_error(ec::invalid_data, "invalid range page");
+    if (!f(*entries) || xs->size() == 1)
+      return {};
+    range = range.resume_at(std::move(xs->back()));
+  }
+}
+
+expected<data> store::put_unique(data key, data val, optional<timespan> expiry) const {
+  if (!requester_)
+    return make_error(ec::unspecified, "store not initialized");
+  return requester_->request_with(
+    [&](const caf::actor& self, request_id id) {
+      auto cmd = make_internal_command<put_unique_command>(
+        std::move(key), std::move(val), expiry, self, id, frontend_id());
+      return caf::make_message(atom::local_v, std::move(cmd));
+    });
 }
 
 expected<data> store::get_index_from_value(data key, data index) const {
-  return request<data>(atom::get_v, std::move(key), std::move(index));
+  return request(atom::get_v, std::move(key), std::move(index));
 }
 
 expected<data> store::keys() const {
-  return request<data>(atom::get_v, atom::keys_v);
+  return request(atom::get_v, atom::keys_v);
 }
 
 void store::put(data key, data value, optional<timespan> expiry) const {
@@ -156,6 +214,13 @@ void store::put(data key, data value, optional<timespan> expiry) const {
                                                expiry, frontend_id()));
 }
 
+void store::put_many(std::vector<std::pair<data, data>> entries,
+                     optional<timespan> expiry) const {
+  anon_send(frontend_, atom::local_v,
+            make_internal_command<put_batch_command>(std::move(entries), expiry,
+                                                     frontend_id()));
+}
+
 void store::erase(data key) const {
   anon_send(
     frontend_, atom::local_v,
@@ -181,12 +246,17 @@ void store::clear() const {
             make_internal_command<clear_command>(frontend_id()));
 }
 
-store::store(caf::actor actor, std::string name)
-  : frontend_{std::move(actor)}, name_{std::move(name)} {
-  // nop
+store::store(caf::actor actor, std::string name, clone_view_ptr view)
+  : frontend_{std::move(actor)},
+    name_{std::move(name)},
+    view_{std::move(view)} {
+  if (frontend_)
+    requester_ = std::make_shared<detail::blocking_requester>(frontend_);
 }
 
 void store::reset() {
+  requester_.reset();
+  view_.reset();
 }
 
 } // namespace broker
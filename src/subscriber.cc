@@ -10,6 +10,7 @@
 #include <caf/send.hpp>
 
 #include "broker/atoms.hh"
+#include "broker/defaults.hh"
 #include "broker/endpoint.hh"
 #include "broker/filter_type.hh"
 #include "broker/logger.hh"
@@ -22,13 +23,14 @@ namespace broker {
 
 namespace {
 
-/// Defines how many seconds are averaged for the computation of the send rate.
-constexpr size_t sample_size = 10;
-
 struct subscriber_worker_state {
   std::vector<size_t> buf;
   size_t counter = 0;
 
+  /// Defines how many seconds are averaged for the computation of the receive
+  /// rate.
+  size_t sample_size = defaults::subscriber::rate_sample_size;
+
   bool calculate_rate = true;
 
   static const char* name;
@@ -80,10 +82,8 @@ protected:
     using vec_type = std::vector<data_message>;
     if (x.xs.match_elements<vec_type>()) {
       auto& xs = x.xs.get_mutable_as<vec_type>(0);
-      auto xs_size = xs.size();
-      state_->counter += xs_size;
-      queue_->produce(xs_size, std::make_move_iterator(xs.begin()),
-                      std::make_move_iterator(xs.end()));
+      state_->counter += xs.size();
+      queue_->produce(std::move(xs));
       return;
     }
     BROKER_ERROR("received unexpected batch type (dropped)");
@@ -99,6 +99,11 @@ behavior subscriber_worker(stateful_actor<subscriber_worker_state>* self,
                            endpoint* ep,
                            detail::shared_subscriber_queue_ptr<> qptr,
                            std::vector<topic> ts, size_t max_qsize) {
+  self->state.sample_size
+    = std::max(get_or(self->system().config(),
+                      "broker.subscriber.rate-sample-size",
+                      defaults::subscriber::rate_sample_size),
+               size_t{1});
   self->send(self * ep->core(), atom::join_v, std::move(ts));
   self->set_default_handler(skip);
   return {
@@ -0,0 +1,105 @@
+// Compares the store backends on put, get and expire workloads. Each workload
+// touches every key once and the benchmark prints the throughput per backend.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "broker/backend.hh"
+#include "broker/backend_options.hh"
+#include "broker/data.hh"
+#include "broker/detail/abstract_backend.hh"
+#include "broker/detail/filesystem.hh"
+#include "broker/detail/make_backend.hh"
+#include "broker/time.hh"
+
+using namespace broker;
+
+namespace {
+
+using fractional_seconds = std::chrono::duration<double>;
+
+template <class F>
+bool measure(const char* workload, uint64_t num_keys, F f) {
+  auto t0 = std::chrono::steady_clock::now();
+  auto ok = f();
+  auto t1 = std::chrono::steady_clock::now();
+  if (!ok) {
+    std::cerr << "  " << workload << " failed\n";
+    return false;
+  }
+  auto seconds = std::chrono::duration_cast<fractional_seconds>(t1 - t0);
+  std::cout << "  " << std::left << std::setw(8) << workload << std::right
+            << std::fixed << std::setprecision(3) << std::setw(10)
+            << seconds.count() << "s" << std::setw(14) << std::setprecision(0)
+            << num_keys / seconds.count() << " ops/s\n";
+  return true;
+}
+
+bool run(const char* name, backend type, uint64_t num_keys) {
+  auto path = detail::make_temp_file_name();
+  auto db = detail::make_backend(type, backend_options{{"path", path}});
+  if (!db) {
+    std::cerr << "unable to create the " << name << " backend\n";
+    return false;
+  }
+  std::cout << name << " backend:\n";
+  auto value = data{std::string(32, 'x')};
+  auto result
+    = measure("put", num_keys,
+              [&] {
+                for (uint64_t i = 0; i < num_keys; ++i)
+                  if (!db->put(data{i}, value, nil))
+                    return false;
+                return true;
+              })
+      && measure("get", num_keys,
+                 [&] {
+                   for (uint64_t i = 0; i < num_keys; ++i)
+                     if (!db->get(data{i}))
+                       return false;
+                   return true;
+                 })
+      && measure("expire", num_keys, [&] {
+           // Re-insert all keys with an expiry in the past and expire them in
+           // bulk, as the master does on each tick.
+           auto t = broker::now();
+           for (uint64_t i = 0; i < num_keys; ++i)
+             if (!db->put(data{i}, value, t))
+               return false;
+           auto keys = db->expire_due(t);
+           return keys && keys->size() == num_keys;
+         });
+  db.reset();
+  detail::remove_all(path);
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  uint64_t num_keys = 10000;
+  if (argc > 1)
+    num_keys = std::strtoull(argv[1], nullptr, 10);
+  if (num_keys == 0) {
+    std::cerr << "usage: " << argv[0] << " [NUM-KEYS]\n";
+    return EXIT_FAILURE;
+  }
+  std::cout << "run each workload with " << num_keys << " keys\n";
+  std::vector<std::pair<const char*, backend>> backends{
+    {"memory", backend::memory},
+    {"sqlite", backend::sqlite},
+    {"log", backend::log},
+  };
+  auto result = EXIT_SUCCESS;
+  for (auto& [name, type] : backends)
+    if (!run(name, type, num_keys))
+      result = EXIT_FAILURE;
+  return result;
+}
@@ -0,0 +1,153 @@
+// Compares the mutex-based `shared_publisher_queue` with the lock-free
+// `spsc_publisher_queue`. Reuses the timing and threading utilities from the
+// readerwriterqueue benchmark harness.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "readerwriterqueue/benchmarks/systemtime.h"
+#include "readerwriterqueue/tests/common/simplethread.h"
+
+#include "broker/data.hh"
+#include "broker/detail/shared_publisher_queue.hh"
+#include "broker/detail/spsc_publisher_queue.hh"
+#include "broker/message.hh"
+#include "broker/topic.hh"
+
+using namespace broker;
+
+namespace {
+
+using counter_t = uint64_t;
+
+constexpr int test_count = 10;
+
+constexpr size_t queue_size = 30;
+
+constexpr size_t batch_size = 10;
+
+enum benchmark_type {
+  bench_single_threaded,
+  bench_concurrent,
+  bench_concurrent_batched,
+  benchmark_count,
+};
+
+const char* benchmark_name(benchmark_type x) {
+  switch (x) {
+    case bench_single_threaded:
+      return "Single-threaded";
+    case bench_concurrent:
+      return "Concurrent";
+    case bench_concurrent_batched:
+      return "Concurrent batches";
+    default:
+      return "???";
+  }
+}
+
+// Pulls `num` items out of `q`, spinning if the queue runs empty.
+template <class Queue>
+void drain(Queue& q, counter_t num) {
+  counter_t total = 0;
+  while (total < num) {
+    auto n = q.consume(batch_size, [](data_message&&) {});
+    if (n == 0)
+      std::this_thread::yield();
+    total += n;
+  }
+}
+
+// Returns the elapsed time in milliseconds and stores the number of performed
+// operations in `ops`.
+template <class Queue>
+double run_benchmark(benchmark_type benchmark, double& ops) {
+  topic t{"/benchmark/events"};
+  moodycamel::SystemTime start;
+  double result = 0;
+  switch (benchmark) {
+    case bench_single_threaded: {
+      const counter_t max = 1000 * 1000;
+      ops = max * 2;
+      auto q = caf::make_counted<Queue>(queue_size);
+      start = moodycamel::getSystemTime();
+      for (counter_t i = 0; i != max; ++i) {
+        q->produce(t, data{i});
+        q->consume(1, [](data_message&&) {});
+      }
+      result = moodycamel::getTimeDelta(start);
+      break;
+    }
+    case bench_concurrent: {
+      const counter_t max = 1000 * 1000;
+      ops = max * 2;
+      auto q = caf::make_counted<Queue>(queue_size);
+      start = moodycamel::getSystemTime();
+      SimpleThread consumer([&] { drain(*q, max); });
+      SimpleThread producer([&] {
+        for (counter_t i = 0; i != max; ++i)
+          q->produce(t, data{i});
+      });
+      producer.join();
+      consumer.join();
+      result = moodycamel::getTimeDelta(start);
+      break;
+    }
+    case bench_concurrent_batched: {
+      const counter_t max = 1000 * 1000;
+      ops = max * 2;
+      auto q = caf::make_counted<Queue>(queue_size);
+      start = moodycamel::getSystemTime();
+      SimpleThread consumer([&] { drain(*q, max); });
+      SimpleThread producer([&] {
+        std::vector<data> xs;
+        for (counter_t i = 0; i != max; i += batch_size) {
+          xs.clear();
+          for (counter_t j = i; j < std::min(max, i + batch_size); ++j)
+            xs.emplace_back(j);
+          q->produce(t, xs.begin(), xs.end());
+        }
+      });
+      producer.join();
+      consumer.join();
+      result = moodycamel::getTimeDelta(start);
+      break;
+    }
+    default:
+      break;
+  }
+  return result;
+}
+
+template <class Queue>
+void run_all(const char* name) {
+  std::cout << name << '\n';
+  for (int i = 0; i < benchmark_count; ++i) {
+    auto benchmark = static_cast<benchmark_type>(i);
+    std::vector<double> times;
+    double ops = 0;
+    for (int j = 0; j < test_count; ++j)
+      times.emplace_back(run_benchmark<Queue>(benchmark, ops));
+    std::sort(times.begin(), times.end());
+    auto best = times.front();
+    auto median = times[times.size() / 2];
+    std::cout << "  " << std::left << std::setw(20) << benchmark_name(benchmark)
+              << " | best: " << std::setw(9) << std::fixed
+              << std::setprecision(2) << best << "ms"
+              << " | median: " << std::setw(9) << median << "ms"
+              << " | " << std::setprecision(0) << (ops / (median / 1000.0))
+              << " ops/s\n";
+  }
+}
+
+} // namespace
+
+int main() {
+  run_all<detail::shared_publisher_queue<>>("shared_publisher_queue");
+  run_all<detail::spsc_publisher_queue<>>("spsc_publisher_queue");
+}
@@ -0,0 +1,141 @@
+// Measures how long a clone takes for applying a full snapshot while holding
+// a populated store. The snapshot arrives in chunks, as masters send it, and
+// shares half of its keys with the store. Hence, the clone emits erase, update
+// and insert events for half of the keys each.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <caf/behavior.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/scoped_actor.hpp>
+#include <caf/stateful_actor.hpp>
+
+#include "broker/atoms.hh"
+#include "broker/data.hh"
+#include "broker/defaults.hh"
+#include "broker/detail/clone_actor.hh"
+#include "broker/endpoint.hh"
+#include "broker/internal_command.hh"
+#include "broker/message.hh"
+
+using namespace broker;
+
+namespace {
+
+using fractional_seconds = std::chrono::duration<double>;
+
+// Counts the events of the clone in place of a core actor.
+struct event_sink_state {
+  uint64_t events = 0;
+
+  static inline constexpr const char* name = "event_sink";
+};
+
+caf::behavior event_sink(caf::stateful_actor<event_sink_state>* self) {
+  return {
+    [=](atom::publish, atom::local, const data_message&) {
+      ++self->state.events;
+    },
+    [=](atom::get) { return self->state.events; },
+  };
+}
+
+std::unordered_map<data, data> make_state(uint64_t first, uint64_t last) {
+  std::unordered_map<data, data> result;
+  result.reserve(last - first);
+  for (auto i = first; i < last; ++i)
+    result.emplace(data{i}, data{std::to_string(i)});
+  return result;
+}
+
+// Splits the keys in [first, last) into snapshot chunks of `chunk_size`.
+std::vector<set_chunk_command>
+make_chunks(uint64_t first, uint64_t last, uint64_t chunk_size) {
+  std::vector<set_chunk_command> result;
+  for (auto i = first; i < last; i += chunk_size) {
+    auto chunk_last = std::min(i + chunk_size, last);
+    set_chunk_command cmd;
+    cmd.state = make_state(i, chunk_last);
+    cmd.last = chunk_last == last;
+    result.emplace_back(std::move(cmd));
+  }
+  return result;
+}
+
+caf::behavior bench_clone(caf::stateful_actor<detail::clone_state>* self,
+                          caf::actor sink, endpoint::clock* clock) {
+  // The clone uses its master as publisher for the events. Any valid handle
+  // does the job here.
+  self->state.master = sink;
+  self->state.init(self, "benchmark", std::move(sink), clock);
+  self->state.event_subscribers = true;
+  return {
+    [=](atom::snapshot, uint64_t num_keys, uint64_t chunk_size) {
+      auto& st = self->state;
+      st.store = make_state(0, num_keys);
+      auto chunks = make_chunks(num_keys / 2, num_keys + num_keys / 2,
+                                chunk_size);
+      auto t0 = std::chrono::steady_clock::now();
+      for (auto& chunk : chunks)
+        st(chunk);
+      auto t1 = std::chrono::steady_clock::now();
+      return std::chrono::duration_cast<fractional_seconds>(t1 - t0).count();
+    },
+  };
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  uint64_t num_keys = 1000 * 1000;
+  uint64_t chunk_size = defaults::store::snapshot_chunk_size;
+  if (argc > 1)
+    num_keys = std::strtoull(argv[1], nullptr, 10);
+  if (argc > 2)
+    chunk_size = std::strtoull(argv[2], nullptr, 10);
+  if (num_keys == 0 || chunk_size == 0) {
+    std::cerr << "usage: " << argv[0] << " [NUM-KEYS [CHUNK-SIZE]]\n";
+    return EXIT_FAILURE;
+  }
+  endpoint ep;
+  auto& sys = ep.system();
+  endpoint::clock clock{&sys, true};
+  auto sink = sys.spawn(event_sink);
+  auto clone = sys.spawn(bench_clone, sink, &clock);
+  std::cout << "apply a snapshot with " << num_keys << " keys in chunks of "
+            << chunk_size << " to a clone with " << num_keys << " keys\n";
+  caf::scoped_actor self{sys};
+  auto result = EXIT_SUCCESS;
+  self->request(clone, caf::infinite, atom::snapshot_v, num_keys, chunk_size)
+    .receive(
+      [&](double seconds) {
+        std::cout << "  applied the snapshot in " << std::fixed
+                  << std::setprecision(3) << seconds << "s\n";
+      },
+      [&](const caf::error& err) {
+        std::cerr << "  failed to apply the snapshot: " << caf::to_string(err)
+                  << '\n';
+        result = EXIT_FAILURE;
+      });
+  self->request(sink, caf::infinite, atom::get_v)
+    .receive(
+      [&](uint64_t events) {
+        std::cout << "  the clone emitted " << events << " events\n";
+      },
+      [&](const caf::error& err) {
+        std::cerr << "  failed to count events: " << caf::to_string(err)
+                  << '\n';
+        result = EXIT_FAILURE;
+      });
+  self->send_exit(clone, caf::exit_reason::user_shutdown);
+  self->send_exit(sink, caf::exit_reason::user_shutdown);
+  return result;
+}
@@ -7,7 +7,9 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <fstream>
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -21,6 +23,8 @@
 #include "broker/detail/abstract_backend.hh"
 #include "broker/detail/assert.hh"
 #include "broker/detail/filesystem.hh"
+#include "broker/detail/key_range.hh"
+#include "broker/detail/log_backend.hh"
 #include "broker/detail/make_backend.hh"
 #include "broker/detail/memory_backend.hh"
 #include "broker/detail/sqlite_backend.hh"
@@ -44,11 +48,15 @@ class meta_backend : public detail::abstract_backend {
 public:
   meta_backend(backend_options opts) {
     backends_.push_back(detail::make_backend(backend::memory, opts));
-    auto& path = caf::get<std::string>(opts["path"]);
-    // Make sure both backends have their own filesystem storage to work with.
-    path += ".sqlite";
-    paths_.push_back(path);
-    backends_.push_back(detail::make_backend(backend::sqlite, opts));
+    // Make sure all backends have their own filesystem storage to work with.
+    auto base = caf::get<std::string>(opts["path"]);
+    for (auto [type, suffix] : {std::make_pair(backend::sqlite, ".sqlite"),
+                                std::make_pair(backend::log, ".log")}) {
+      auto path = base + suffix;
+      opts["path"] = path;
+      paths_.push_back(path);
+      backends_.push_back(detail::make_backend(type, opts));
+    }
   }
 
   ~meta_backend() {
@@ -83,6 +91,58 @@ public:
     );
   }
 
+  expected<optional<data>> put_returning_old(const data& key, data value,
+                                             optional<timestamp> expiry) override {
+    return perform<optional<data>>(
+      [&](detail::abstract_backend& backend) {
+        return backend.put_returning_old(key, value, expiry);
+      }
+    );
+  }
+
+  expected<data> add_returning_new(const data& key, const data& value,
+                                   data::type init_type,
+                                   optional<timestamp> expiry,
+                                   optional<data>* old_value) override {
+    using result_type = std::pair<data, optional<data>>;
+    auto res = perform<result_type>(
+      [&](detail::abstract_backend& backend) -> expected<result_type> {
+        optional<data> old;
+        auto val = backend.add_returning_new(key, value, init_type, expiry,
+                                             old_value ? &old : nullptr);
+        if (!val)
+          return val.error();
+        return result_type{std::move(*val), std::move(old)};
+      }
+    );
+    if (!res)
+      return res.error();
+    if (old_value)
+      *old_value = std::move(res->second);
+    return std::move(res->first);
+  }
+
+  expected<data> subtract_returning_new(const data& key, const data& value,
+                                        optional<timestamp> expiry,
+                                        data* old_value) override {
+    using result_type = std::pair<data, data>;
+    auto res = perform<result_type>(
+      [&](detail::abstract_backend& backend) -> expected<result_type> {
+        data old;
+        auto val = backend.subtract_returning_new(key, value, expiry,
+                                                  old_value ? &old : nullptr);
+        if (!val)
+          return val.error();
+        return result_type{std::move(*val), std::move(old)};
+      }
+    );
+    if (!res)
+      return res.error();
+    if (old_value)
+      *old_value = std::move(res->second);
+    return std::move(res->first);
+  }
+
   expected<void> erase(const data& key) override {
     return perform<void>(
       [&](detail::abstract_backend& backend) {
@@ -107,6 +167,18 @@ public:
     );
   }
 
+  expected<std::vector<data>> expire_due(timestamp ts) override {
+    // Backends may return the expired keys in any order.
+    return perform<std::vector<data>>(
+      [&](detail::abstract_backend& backend) -> expected<std::vector<data>> {
+        auto keys = backend.expire_due(ts);
+        if (keys)
+          std::sort(keys->begin(), keys->end());
+        return keys;
+      }
+    );
+  }
+
   expected<data> get(const data& key) const override {
     return perform<data>(
       [&](detail::abstract_backend& backend) {
@@ -155,10 +227,69 @@ public:
     );
   }
 
+  expected<void> for_each(const detail::entry_visitor& f) const override {
+    using entries = std::map<data, std::pair<data, optional<timestamp>>>;
+    auto xs = perform<entries>(
+      [&](detail::abstract_backend& backend) -> expected<entries> {
+        entries result;
+        auto collect = [&](const data& key, data& value,
+                           optional<timestamp> expiry) {
+          result.emplace(key, std::make_pair(std::move(value), expiry));
+        };
+        if (auto res = backend.for_each(collect); !res)
+          return res.error();
+        return result;
+      }
+    );
+    if (!xs)
+      return xs.error();
+    for (auto& [key, entry] : *xs)
+      f(key, entry.first, entry.second);
+    return {};
+  }
+
+  expected<detail::scan_result> scan(const optional<data>& begin_key,
+                                     size_t limit) const override {
+    // All backends return the same pages, since scans are ordered.
+    using page = std::pair<std::vector<std::pair<data, data>>, optional<data>>;
+    auto res = perform<page>(
+      [&](detail::abstract_backend& backend) -> expected<page> {
+        auto x = backend.scan(begin_key, limit);
+        if (!x)
+          return x.error();
+        return page{std::move(x->entries), std::move(x->next)};
+      }
+    );
+    if (!res)
+      return res.error();
+    return detail::scan_result{std::move(res->first), std::move(res->second)};
+  }
+
+  expected<detail::scan_result> range(const detail::key_range& range,
+                                      size_t limit) const override {
+    // All backends return the same pages, since ranges are ordered.
+    using page = std::pair<std::vector<std::pair<data, data>>, optional<data>>;
+    auto res = perform<page>(
+      [&](detail::abstract_backend& backend) -> expected<page> {
+        auto x = backend.range(range, limit);
+        if (!x)
+          return x.error();
+        return page{std::move(x->entries), std::move(x->next)};
+      }
+    );
+    if (!res)
+      return res.error();
+    return detail::scan_result{std::move(res->first), std::move(res->second)};
+  }
+
   expected<broker::detail::expirables> expiries() const override {
+    // Backends may return the expiries in any order.
     return perform<broker::detail::expirables>(
       [](detail::abstract_backend& backend) {
-        return backend.expiries();
+        auto xs = backend.expiries();
+        if (xs)
+          std::sort(xs->begin(), xs->end());
+        return xs;
       }
     );
   }
@@ -255,6 +386,29 @@ TEST(add/remove) {
   CHECK_EQUAL(*get, data{34});
 }
 
+TEST(modifications returning old and new values) {
+  auto old = RUN(backend->put_returning_old("foo", 1));
+  CHECK(!old);
+  old = RUN(backend->put_returning_old("foo", 2));
+  CHECK_EQUAL(old, data{1});
+  optional<data> old_value;
+  auto val = RUN(backend->add_returning_new("foo", 40, data::type::integer, nil,
+                                            &old_value));
+  CHECK_EQUAL(val, data{42});
+  CHECK_EQUAL(old_value, data{2});
+  val = RUN(backend->add_returning_new("bar", 3, data::type::integer, nil,
+                                       &old_value));
+  CHECK_EQUAL(val, data{3});
+  CHECK(!old_value);
+  data prev;
+  val = RUN(backend->subtract_returning_new("foo", 2, nil, &prev));
+  CHECK_EQUAL(val, data{40});
+  CHECK_EQUAL(prev, data{42});
+  CHECK_EQUAL(backend->subtract_returning_new("baz", 1), ec::no_such_key);
+  CHECK_EQUAL(RUN(backend->get("foo")), data{40});
+  CHECK_EQUAL(RUN(backend->get("bar")), data{3});
+}
+
 TEST(erase/exists) {
   using namespace std::chrono;
   auto exists = backend->exists("foo");
@@ -278,6 +432,17 @@ TEST(erase/exists) {
   REQUIRE(erase);
 }
 
+TEST(get_many/exists_many) {
+  RUN(backend->put("foo", 1));
+  RUN(backend->put("bar", 2));
+  auto keys = vector{"foo", "baz", "bar"};
+  CHECK_EQUAL(RUN(backend->get_many(keys)),
+              data(table{{"bar", 2}, {"foo", 1}}));
+  CHECK_EQUAL(RUN(backend->exists_many(keys)),
+              data(vector{true, false, true}));
+  CHECK_EQUAL(RUN(backend->get_many(vector{})), data{table{}});
+}
+
 TEST(clear/keys) {
   using namespace std::chrono;
   auto put = backend->put("foo", "1");
@@ -325,6 +490,39 @@ TEST(expiration without expiry) {
   REQUIRE(!*expire); // no expiry with key associated
 }
 
+TEST(expiring all due keys at once) {
+  using namespace std::chrono;
+  auto t0 = broker::now();
+  REQUIRE(backend->put("a", 1, t0 + seconds{1}));
+  REQUIRE(backend->put("b", 2, t0 + seconds{3}));
+  REQUIRE(backend->put("c", 3));
+  REQUIRE(backend->put("d", 4, t0 + seconds{2}));
+  REQUIRE(backend->put("e", 5, t0 + seconds{1}));
+  // Overriding the expiry must drop the previous expiration time.
+  REQUIRE(backend->put("e", 5));
+  REQUIRE(backend->add("c", 1, data::type::none, t0 + seconds{2}));
+  auto keys = backend->expire_due(t0);
+  REQUIRE(keys);
+  CHECK(keys->empty());
+  keys = backend->expire_due(t0 + seconds{2});
+  REQUIRE(keys);
+  CHECK_EQUAL(*keys, std::vector<data>({"a", "c", "d"}));
+  auto size = backend->size();
+  REQUIRE(size);
+  CHECK_EQUAL(*size, 2u);
+  auto expiries = backend->expiries();
+  REQUIRE(expiries);
+  REQUIRE_EQUAL(expiries->size(), 1u);
+  CHECK_EQUAL(expiries->front().first, data{"b"});
+  REQUIRE(backend->erase("b"));
+  keys = backend->expire_due(t0 + seconds{10});
+  REQUIRE(keys);
+  CHECK(keys->empty());
+  auto exists = backend->exists("e");
+  REQUIRE(exists);
+  CHECK(*exists);
+}
+
 TEST(size/snapshot) {
   using namespace std::chrono;
   auto put = backend->put("foo", "bar");
@@ -342,4 +540,190 @@ TEST(size/snapshot) {
   CHECK_EQUAL(ss->count("foo"), 1u);
 }
 
+TEST(for_each) {
+  using namespace std::chrono;
+  auto expiry = broker::now() + seconds{10};
+  REQUIRE(backend->put("foo", "bar"));
+  REQUIRE(backend->put("bar", 4.2, expiry));
+  std::map<data, data> xs;
+  size_t expiring = 0;
+  auto collect = [&](const data& key, data& value,
+                     optional<timestamp> ts) {
+    xs.emplace(key, value);
+    if (ts) {
+      CHECK_EQUAL(*ts, expiry);
+      ++expiring;
+    }
+  };
+  REQUIRE(backend->for_each(collect));
+  CHECK_EQUAL(xs, (std::map<data, data>{{"bar", 4.2}, {"foo", "bar"}}));
+  CHECK_EQUAL(expiring, 1u);
+  std::vector<data> keys;
+  auto collect_expiry = [&](const data& key, timestamp ts) {
+    keys.emplace_back(key);
+    CHECK_EQUAL(ts, expiry);
+  };
+  REQUIRE(backend->for_each_expiry(collect_expiry));
+  CHECK_EQUAL(keys, std::vector<data>{"bar"});
+}
+
+TEST(scan) {
+  for (int i = 0; i < 5; ++i)
+    REQUIRE(backend->put(i, i * 2));
+  for (size_t limit : {1u, 2u, 5u, 10u}) {
+    MESSAGE("scan with limit " << limit);
+    std::map<data, data> xs;
+    optional<data> pos;
+    do {
+      auto page = backend->scan(pos, limit);
+      REQUIRE(page);
+      CHECK_LESS_EQUAL(page->entries.size(), limit);
+      for (auto& [key, value] : page->entries)
+        CHECK(xs.emplace(key, value).second);
+      pos = std::move(page->next);
+    } while (pos);
+    CHECK_EQUAL(xs.size(), 5u);
+    CHECK_EQUAL(xs[data{3}], data{6});
+  }
+}
+
+TEST(range) {
+  for (int i = 0; i < 5; ++i)
+    REQUIRE(backend->put(i, i * 2));
+  REQUIRE(backend->put("a/1", 1));
+  REQUIRE(backend->put("a/2", 2));
+  REQUIRE(backend->put("b/1", 3));
+  for (size_t limit : {1u, 2u, 10u}) {
+    MESSAGE("range [1, 4) with limit " << limit);
+    std::vector<std::pair<data, data>> xs;
+    auto range = detail::key_range::between(1, 4);
+    for (;;) {
+      auto page = RUN(backend->range(range, limit));
+      CHECK_LESS_EQUAL(page.entries.size(), limit);
+      xs.insert(xs.end(), page.entries.begin(), page.entries.end());
+      if (!page.next)
+        break;
+      range = range.resume_at(std::move(*page.next));
+    }
+    using kvp = std::pair<data, data>;
+    CHECK_EQUAL(xs, std::vector<kvp>({{1, 2}, {2, 4}, {3, 6}}));
+  }
+  auto page = RUN(backend->range(detail::key_range::starting_with("a/"), 10));
+  CHECK_EQUAL(page.entries.size(), 2u);
+  CHECK(!page.next);
+}
+
+TEST(scans resume after erasing their next key) {
+  for (int i = 0; i < 5; ++i)
+    REQUIRE(backend->put(i, i * 2));
+  auto page = RUN(backend->scan(nil, 2));
+  using kvp = std::pair<data, data>;
+  CHECK_EQUAL(page.entries, std::vector<kvp>({{0, 0}, {1, 2}}));
+  REQUIRE(page.next);
+  CHECK_EQUAL(*page.next, data{2});
+  REQUIRE(backend->erase(2));
+  REQUIRE(backend->put(7, 14));
+  page = RUN(backend->scan(page.next, 10));
+  CHECK_EQUAL(page.entries, std::vector<kvp>({{3, 6}, {4, 8}, {7, 14}}));
+  CHECK(!page.next);
+}
+
+TEST(sqlite group commits) {
+  auto path = detail::make_temp_file_name();
+  backend_options opts{{"path", path},
+                       {"batch-size", count{3}},
+                       {"batch-interval", timespan{std::chrono::hours{1}}},
+                       {"journal-mode", "wal"},
+                       {"synchronous", "normal"}};
+  {
+    detail::sqlite_backend db{opts};
+    REQUIRE(!db.init_failed());
+    CHECK(db.batch_interval());
+    for (int i = 0; i < 5; ++i)
+      REQUIRE(db.put(i, i));
+    // Reads see writes of the current batch.
+    CHECK_EQUAL(db.get(4), data{4});
+    REQUIRE(db.erase(0));
+    REQUIRE(db.flush());
+  }
+  {
+    detail::sqlite_backend db{opts};
+    REQUIRE(!db.init_failed());
+    CHECK_EQUAL(*db.size(), 4u);
+    CHECK_EQUAL(db.exists(0), false);
+  }
+  opts["journal-mode"] = "bogus";
+  CHECK(detail::sqlite_backend{opts}.init_failed());
+  detail::remove_all(path);
+}
+
+TEST(log persistence and compaction) {
+  using namespace std::chrono;
+  auto path = detail::make_temp_file_name();
+  backend_options opts{{"path", path}, {"compaction-threshold", count{0}}};
+  auto expiry = broker::now() + hours{1};
+  uint64_t full_size = 0;
+  {
+    detail::log_backend db{opts};
+    REQUIRE(!db.init_failed());
+    for (int i = 0; i < 10; ++i)
+      REQUIRE(db.put(i, i, expiry));
+    REQUIRE(db.add(0, 10, data::type::integer, nil));
+    REQUIRE(db.subtract(1, 1, nil));
+    REQUIRE(db.erase(9));
+    CHECK_EQUAL(db.get(0), data{10});
+    // Stale records still take up less space than the live records.
+    full_size = db.file_size();
+    REQUIRE(db.flush());
+  }
+  {
+    MESSAGE("reopen the log");
+    detail::log_backend db{opts};
+    REQUIRE(!db.init_failed());
+    CHECK_EQUAL(*db.size(), 9u);
+    CHECK_EQUAL(db.get(0), data{10});
+    CHECK_EQUAL(db.get(1), data{0});
+    CHECK_EQUAL(db.exists(9), false);
+    CHECK_EQUAL(db.expiries()->size(), 7u);
+    CHECK_EQUAL(db.file_size(), full_size);
+    MESSAGE("overwriting most entries compacts the log");
+    for (int i = 0; i < 8; ++i)
+      REQUIRE(db.put(i, "x"));
+    CHECK_LESS(db.file_size(), full_size);
+    CHECK_EQUAL(db.get(0), data{"x"});
+    CHECK_EQUAL(db.get(8), data{8});
+    CHECK_EQUAL(db.expiries()->size(), 1u);
+  }
+  MESSAGE("drop a partially written record at the end of the log");
+  {
+    std::ofstream out{path, std::ios::binary | std::ios::app};
+    out.put(1);
+    out.put(0);
+  }
+  {
+    detail::log_backend db{opts};
+    REQUIRE(!db.init_failed());
+    CHECK_EQUAL(*db.size(), 9u);
+    REQUIRE(db.put("foo", "bar"));
+  }
+  uint64_t valid_size = 0;
+  {
+    detail::log_backend db{opts};
+    REQUIRE(!db.init_failed());
+    CHECK_EQUAL(db.get("foo"), data{"bar"});
+    valid_size = db.file_size();
+  }
+  MESSAGE("refuse to open a log with an invalid record");
+  {
+    // A complete record header with an unknown record type.
+    std::ofstream out{path, std::ios::binary | std::ios::app};
+    out.put(7);
+    for (int i = 0; i < 17; ++i)
+      out.put(0);
+  }
+  CHECK(detail::log_backend{opts}.init_failed());
+  CHECK_EQUAL(detail::read(path).size(), valid_size + 18);
+  detail::remove_all(path);
+}
+
 FIXTURE_SCOPE_END()
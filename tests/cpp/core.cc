@@ -215,6 +215,24 @@ CAF_TEST(local_peers) {
       CAF_REQUIRE_EQUAL(xs, expected);
     }
   );
+  CAF_MESSAGE("publish a batch of messages with a single message to core1");
+  anon_send(core1, atom::publish_v, topic("b"),
+            std::vector<data>{data{false}, data{true}});
+  expect((atom::publish, topic, std::vector<data>),
+         from(_).to(core1).with(_, _, _));
+  run();
+  CAF_MESSAGE("check log of the consumer after the batch");
+  self->send(leaf, atom::get_v);
+  sched.prioritize(leaf);
+  consume_message();
+  self->receive(
+    [](const buf& xs) {
+      auto expected = data_msgs({{"b", true}, {"b", false}, {"b", true},
+                                 {"b", false}, {"b", true}, {"b", false},
+                                 {"b", true}});
+      CAF_REQUIRE_EQUAL(xs, expected);
+    }
+  );
   CAF_MESSAGE("unpeer core1 from core2");
   anon_send(core1, atom::unpeer_v, core2);
   run();
@@ -0,0 +1,70 @@
+#define SUITE detail.blocking_requester
+
+#include "broker/detail/blocking_requester.hh"
+
+#include "test.hh"
+
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <caf/actor_cast.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/send.hpp>
+
+#include "broker/atoms.hh"
+#include "broker/endpoint.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+// Answers lookups only after receiving two of them and then answers in
+// reverse order. Hence, requests can only succeed if two of them are in
+// flight at the same time.
+caf::behavior pairing_frontend(caf::event_based_actor* self) {
+  using request = std::tuple<caf::actor, data, request_id>;
+  auto requests = std::make_shared<std::vector<request>>();
+  return {
+    [=](atom::get, data& key, request_id id) {
+      auto hdl = caf::actor_cast<caf::actor>(self->current_sender());
+      requests->emplace_back(std::move(hdl), std::move(key), id);
+      if (requests->size() < 2)
+        return;
+      for (auto i = requests->rbegin(); i != requests->rend(); ++i) {
+        auto& [sender, value, rid] = *i;
+        self->send(sender, std::move(value), rid);
+      }
+      requests->clear();
+    },
+  };
+}
+
+struct fixture {
+  endpoint ep;
+};
+
+} // namespace
+
+FIXTURE_SCOPE(blocking_requester_tests, fixture)
+
+TEST(threads sharing a requester have their requests in flight concurrently) {
+  auto frontend = ep.system().spawn(pairing_frontend);
+  blocking_requester uut{frontend};
+  std::vector<expected<data>> results(2, expected<data>{ec::unspecified});
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < results.size(); ++t)
+    threads.emplace_back([&, t] {
+      results[t] = uut.request(atom::get_v, data{static_cast<count>(t)});
+    });
+  for (auto& th : threads)
+    th.join();
+  for (size_t t = 0; t < results.size(); ++t)
+    CHECK_EQUAL(value_of(results[t]), data{static_cast<count>(t)});
+  caf::anon_send_exit(frontend, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
@@ -0,0 +1,129 @@
+#define SUITE detail.caching_backend
+
+#include "broker/detail/caching_backend.hh"
+
+#include "test.hh"
+
+#include "broker/detail/memory_backend.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+struct fixture {
+  caching_backend uut{std::make_unique<memory_backend>(), 2};
+
+  // Returns the value for `key` or `nil` if the lookup fails.
+  data get(const data& key) {
+    if (auto res = uut.get(key))
+      return std::move(*res);
+    return nil;
+  }
+
+  bool exists(const data& key) {
+    auto res = uut.exists(key);
+    return res && *res;
+  }
+};
+
+} // namespace
+
+FIXTURE_SCOPE(caching_backend_tests, fixture)
+
+TEST(repeated lookups hit the cache) {
+  REQUIRE(uut.put("foo", 42, nil));
+  CHECK_EQUAL(get("foo"), data{42});
+  CHECK_EQUAL(uut.misses(), 1u);
+  CHECK_EQUAL(get("foo"), data{42});
+  CHECK(exists("foo"));
+  CHECK_EQUAL(uut.hits(), 2u);
+}
+
+TEST(the cache remembers missing keys) {
+  CHECK_EQUAL(uut.get("foo"), ec::no_such_key);
+  CHECK(!exists("foo"));
+  CHECK_EQUAL(uut.get("foo"), ec::no_such_key);
+  CHECK_EQUAL(uut.hits(), 2u);
+  CHECK_EQUAL(uut.misses(), 1u);
+}
+
+TEST(the cache remembers existing keys) {
+  REQUIRE(uut.put("foo", 42, nil));
+  CHECK(exists("foo"));
+  CHECK(exists("foo"));
+  CHECK_EQUAL(uut.hits(), 1u);
+  CHECK_EQUAL(uut.misses(), 1u);
+  MESSAGE("get fetches the value after exists");
+  CHECK_EQUAL(get("foo"), data{42});
+  CHECK_EQUAL(uut.misses(), 2u);
+  CHECK_EQUAL(get("foo"), data{42});
+  CHECK_EQUAL(uut.hits(), 2u);
+  CHECK_EQUAL(uut.cached(), 1u);
+  MESSAGE("erasing the key invalidates the cached result");
+  REQUIRE(uut.erase("foo"));
+  CHECK(!exists("foo"));
+  CHECK_EQUAL(uut.misses(), 3u);
+}
+
+TEST(modifications invalidate cached values) {
+  REQUIRE(uut.put("foo", 1, nil));
+  CHECK_EQUAL(get("foo"), data{1});
+  REQUIRE(uut.put("foo", 2, nil));
+  CHECK_EQUAL(get("foo"), data{2});
+  REQUIRE(uut.add("foo", 3, data::type::integer, nil));
+  CHECK_EQUAL(get("foo"), data{5});
+  REQUIRE(uut.subtract("foo", 1, nil));
+  CHECK_EQUAL(get("foo"), data{4});
+  REQUIRE(uut.erase("foo"));
+  CHECK(!exists("foo"));
+  REQUIRE(uut.put("foo", 6, nil));
+  CHECK(exists("foo"));
+  REQUIRE(uut.clear());
+  CHECK_EQUAL(uut.cached(), 0u);
+  CHECK_EQUAL(uut.get("foo"), ec::no_such_key);
+  CHECK_EQUAL(uut.hits(), 0u);
+}
+
+TEST(expired keys leave the cache) {
+  auto now = broker::now();
+  REQUIRE(uut.put("foo", 1, now + std::chrono::seconds(1)));
+  CHECK_EQUAL(get("foo"), data{1});
+  auto res = uut.expire("foo", now);
+  REQUIRE(res);
+  CHECK(!*res);
+  CHECK_EQUAL(get("foo"), data{1});
+  res = uut.expire("foo", now + std::chrono::seconds(2));
+  REQUIRE(res);
+  CHECK(*res);
+  CHECK(!exists("foo"));
+}
+
+TEST(the cache evicts the least recently used key) {
+  REQUIRE(uut.put("a", 1, nil));
+  REQUIRE(uut.put("b", 2, nil));
+  REQUIRE(uut.put("c", 3, nil));
+  CHECK_EQUAL(get("a"), data{1});
+  CHECK_EQUAL(get("b"), data{2});
+  CHECK_EQUAL(get("a"), data{1});
+  CHECK_EQUAL(get("c"), data{3});
+  CHECK_EQUAL(uut.cached(), 2u);
+  CHECK_EQUAL(uut.misses(), 3u);
+  // "b" was the least recently used key when "c" entered the cache.
+  CHECK_EQUAL(get("a"), data{1});
+  CHECK_EQUAL(get("b"), data{2});
+  CHECK_EQUAL(uut.misses(), 4u);
+}
+
+TEST(cursors and sizes bypass the cache) {
+  REQUIRE(uut.put("a", 1, nil));
+  REQUIRE(uut.put("b", 2, nil));
+  REQUIRE(uut.put("c", 3, nil));
+  CHECK_EQUAL(*uut.size(), 3u);
+  size_t n = 0;
+  REQUIRE(uut.for_each([&](const data&, data&, optional<timestamp>) { ++n; }));
+  CHECK_EQUAL(n, 3u);
+  CHECK_EQUAL(uut.cached(), 0u);
+}
+
+FIXTURE_SCOPE_END()
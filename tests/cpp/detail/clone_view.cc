@@ -0,0 +1,116 @@
+#define SUITE detail.clone_view
+
+#include "broker/detail/clone_view.hh"
+
+#include "test.hh"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "broker/error.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+TEST(views start out stale and empty) {
+  clone_view view;
+  CHECK_EQUAL(view.get("foo"), ec::stale_data);
+  CHECK_EQUAL(view.exists("foo"), ec::stale_data);
+  CHECK_EQUAL(view.size(), 0u);
+  view.stale(false);
+  view.publish();
+  CHECK_EQUAL(view.get("foo"), ec::no_such_key);
+  CHECK_EQUAL(view.exists("foo"), data{false});
+}
+
+TEST(readers only see published changes) {
+  clone_view view;
+  view.stale(false);
+  view.put("foo", 1);
+  view.put("bar", 2);
+  CHECK_EQUAL(view.get("foo"), ec::stale_data);
+  view.publish();
+  CHECK_EQUAL(view.get("foo"), data{1});
+  CHECK_EQUAL(view.get("bar"), data{2});
+  CHECK_EQUAL(view.exists("bar"), data{true});
+  CHECK_EQUAL(view.size(), 2u);
+  view.put("foo", 3);
+  view.erase("bar");
+  CHECK_EQUAL(view.get("foo"), data{1});
+  CHECK_EQUAL(view.get("bar"), data{2});
+  view.publish();
+  CHECK_EQUAL(view.get("foo"), data{3});
+  CHECK_EQUAL(view.get("bar"), ec::no_such_key);
+  CHECK_EQUAL(view.size(), 1u);
+  view.stale(true);
+  view.publish();
+  CHECK_EQUAL(view.get("foo"), ec::stale_data);
+}
+
+TEST(assign replaces the entire content) {
+  clone_view view;
+  view.stale(false);
+  view.put("foo", 1);
+  view.publish();
+  clone_view::map_type xs;
+  for (integer i = 0; i < 10000; ++i)
+    xs.emplace(i, i * 2);
+  view.assign(xs);
+  view.publish();
+  CHECK_EQUAL(view.size(), 10000u);
+  CHECK_EQUAL(view.get("foo"), ec::no_such_key);
+  CHECK_EQUAL(view.get(integer{42}), data{integer{84}});
+  view.assign({});
+  view.publish();
+  CHECK_EQUAL(view.size(), 0u);
+  CHECK_EQUAL(view.get(integer{42}), ec::no_such_key);
+}
+
+TEST(views keep all entries when adding buckets) {
+  clone_view view;
+  view.stale(false);
+  for (integer i = 0; i < 20000; ++i)
+    view.put(i, i);
+  view.publish();
+  CHECK_EQUAL(view.size(), 20000u);
+  size_t missing = 0;
+  for (integer i = 0; i < 20000; ++i)
+    if (view.get(i) != data{i})
+      ++missing;
+  CHECK_EQUAL(missing, 0u);
+}
+
+TEST(readers on other threads never observe partial updates) {
+  // The writer always updates both keys to the same value before publishing.
+  clone_view view;
+  view.stale(false);
+  view.put("a", integer{0});
+  view.put("b", integer{0});
+  view.publish();
+  std::atomic<bool> done{false};
+  std::vector<std::thread> readers;
+  std::vector<size_t> failures(4);
+  for (size_t t = 0; t < failures.size(); ++t) {
+    readers.emplace_back([&, t] {
+      while (!done) {
+        auto a = view.get("a");
+        auto b = view.get("b");
+        // Each read loads the latest snapshot, so `b` can be newer than `a`.
+        if (!a || !b || caf::get<integer>(*b) < caf::get<integer>(*a))
+          ++failures[t];
+      }
+    });
+  }
+  for (integer i = 1; i <= 10000; ++i) {
+    view.put("a", i);
+    view.put("b", i);
+    view.publish();
+  }
+  done = true;
+  for (auto& th : readers)
+    th.join();
+  for (auto n : failures)
+    CHECK_EQUAL(n, 0u);
+  CHECK_EQUAL(view.get("a"), data{integer{10000}});
+}
@@ -0,0 +1,79 @@
+#define SUITE detail.filter_index
+
+#include "broker/detail/filter_index.hh"
+
+#include "test.hh"
+
+#include <algorithm>
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+// We never dereference the managers, so we can simply use fake addresses.
+const auto* mgr1 = reinterpret_cast<const unipath_manager*>(0x01);
+const auto* mgr2 = reinterpret_cast<const unipath_manager*>(0x02);
+
+struct fixture {
+  filter_index uut;
+
+  std::vector<const unipath_manager*> matches(const topic& t) {
+    std::vector<const unipath_manager*> result;
+    uut.for_each_match(t, [&](const unipath_manager* x) {
+      if (std::find(result.begin(), result.end(), x) == result.end())
+        result.emplace_back(x);
+    });
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  std::vector<const unipath_manager*> none() {
+    return {};
+  }
+
+  std::vector<const unipath_manager*> only(const unipath_manager* x) {
+    return {x};
+  }
+
+  std::vector<const unipath_manager*> both() {
+    return {mgr1, mgr2};
+  }
+};
+
+} // namespace
+
+FIXTURE_SCOPE(filter_index_tests, fixture)
+
+TEST(the index selects all managers with a matching prefix) {
+  uut.add(mgr1, filter_type{"/foo", "/zeek/logs"});
+  uut.add(mgr2, filter_type{"/foo/bar"});
+  CHECK(matches("/foo") == only(mgr1));
+  CHECK(matches("/foo/bar/baz") == both());
+  CHECK(matches("/zeek/logs/conn") == only(mgr1));
+  CHECK(matches("/zeek") == none());
+  CHECK(matches("/bar") == none());
+}
+
+TEST(updates only change the affected entries) {
+  uut.add(mgr1, filter_type{"/foo", "/bar"});
+  uut.add(mgr2, filter_type{"/foo"});
+  uut.update(mgr1, filter_type{"/foo", "/bar"}, filter_type{"/bar", "/baz"});
+  CHECK(matches("/foo") == only(mgr2));
+  CHECK(matches("/bar") == only(mgr1));
+  CHECK(matches("/baz") == only(mgr1));
+  CHECK_EQUAL(uut.size(), 3u);
+}
+
+TEST(erasing all entries of a manager removes empty topics) {
+  uut.add(mgr1, filter_type{"/foo", "/bar"});
+  uut.add(mgr2, filter_type{"/foo"});
+  uut.erase(mgr1, filter_type{"/foo", "/bar"});
+  CHECK(matches("/foo") == only(mgr2));
+  CHECK(matches("/bar") == none());
+  CHECK_EQUAL(uut.size(), 1u);
+  uut.erase(mgr2, filter_type{"/foo"});
+  CHECK(uut.empty());
+}
+
+FIXTURE_SCOPE_END()
@@ -0,0 +1,68 @@
+#define SUITE detail.flare
+
+#include "broker/detail/flare.hh"
+
+#include "test.hh"
+
+#include <poll.h>
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+struct fixture {
+  flare uut;
+
+  bool ready() {
+    pollfd p = {uut.fd(), POLLIN, 0};
+    return ::poll(&p, 1, 0) == 1;
+  }
+};
+
+} // namespace
+
+FIXTURE_SCOPE(flare_tests, fixture)
+
+TEST(a new flare is not ready) {
+  CHECK(!ready());
+  CHECK(!uut.extinguish_one());
+  CHECK_EQUAL(uut.extinguish(), 0u);
+}
+
+TEST(extinguish resets the flare) {
+  uut.fire(1000);
+  CHECK(ready());
+  CHECK_EQUAL(uut.extinguish(), 1000u);
+  CHECK(!ready());
+}
+
+TEST(extinguish_one consumes one fire at a time) {
+  uut.fire();
+  uut.fire();
+  CHECK(uut.extinguish_one());
+  CHECK(ready());
+  CHECK(uut.extinguish_one());
+  CHECK(!ready());
+  CHECK(!uut.extinguish_one());
+}
+
+TEST(extinguish_some consumes at most the requested amount) {
+  uut.fire(10);
+  CHECK_EQUAL(uut.extinguish_some(3), 3u);
+  CHECK(ready());
+  CHECK_EQUAL(uut.extinguish_some(20), 7u);
+  CHECK(!ready());
+}
+
+TEST(await_one returns once the flare is ready) {
+  uut.fire();
+  uut.await_one();
+  CHECK(uut.await_one(std::chrono::steady_clock::now()
+                      + std::chrono::milliseconds(10)));
+  CHECK(uut.extinguish_one());
+  CHECK(!uut.await_one(std::chrono::steady_clock::now()
+                       + std::chrono::milliseconds(10)));
+}
+
+FIXTURE_SCOPE_END()
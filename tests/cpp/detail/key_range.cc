@@ -0,0 +1,86 @@
+#define SUITE detail.key_range
+
+#include "broker/detail/key_range.hh"
+
+#include "test.hh"
+
+#include <map>
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+// Pages through `range` with a builder over `xs` and returns the number of
+// pages. Stores the entries of all pages in `result`.
+size_t page_through(const std::map<data, data>& xs, key_range range,
+                    size_t limit, std::vector<data>& result) {
+  size_t pages = 0;
+  for (;;) {
+    range_page_builder builder{range, limit};
+    // Feed the entries in reverse order to make sure the builder does not
+    // rely on sorted input.
+    for (auto i = xs.rbegin(); i != xs.rend(); ++i)
+      builder.add(i->first, i->second);
+    auto page = std::move(builder).build();
+    ++pages;
+    if (page.entries.size() > limit)
+      FAIL("page exceeds the limit");
+    for (auto& kvp : page.entries)
+      result.emplace_back(kvp.first);
+    if (!page.next)
+      return pages;
+    range = range.resume_at(std::move(*page.next));
+  }
+}
+
+} // namespace
+
+TEST(bounded ranges include the lower bound but not the upper bound) {
+  auto range = key_range::between(data{2}, data{5});
+  CHECK(!range.contains(data{1}));
+  CHECK(range.contains(data{2}));
+  CHECK(range.contains(data{4}));
+  CHECK(!range.contains(data{5}));
+}
+
+TEST(prefix ranges match strings and vectors by their leading elements) {
+  CHECK(has_prefix(data{"foo/bar"}, data{"foo/"}));
+  CHECK(has_prefix(data{"foo/"}, data{"foo/"}));
+  CHECK(!has_prefix(data{"fo"}, data{"foo/"}));
+  CHECK(!has_prefix(data{"bar/foo"}, data{"foo/"}));
+  CHECK(has_prefix(data{vector{1, 2, 3}}, data{vector{1, 2}}));
+  CHECK(!has_prefix(data{vector{1, 3}}, data{vector{1, 2}}));
+  CHECK(!has_prefix(data{vector{1}}, data{vector{1, 2}}));
+  CHECK(!has_prefix(data{"foo"}, data{vector{1}}));
+  CHECK(has_prefix(data{42}, data{42}));
+  CHECK(!has_prefix(data{42}, data{4}));
+  auto range = key_range::starting_with(data{"foo/"});
+  CHECK(range.contains(data{"foo/bar"}));
+  CHECK(!range.contains(data{"foo"}));
+  CHECK(!range.contains(data{"fop"}));
+}
+
+TEST(page builders return sorted pages that cover the range once) {
+  std::map<data, data> xs;
+  for (int i = 0; i < 10; ++i)
+    xs.emplace(data{i}, data{i * 2});
+  for (size_t limit : {1u, 3u, 6u, 10u}) {
+    MESSAGE("page through [2, 8) with limit " << limit);
+    std::vector<data> keys;
+    page_through(xs, key_range::between(data{2}, data{8}), limit, keys);
+    CHECK_EQUAL(keys, vector({2, 3, 4, 5, 6, 7}));
+  }
+  CHECK_EQUAL(
+    make_range_page(scan_result{{{data{1}, data{2}}}, data{3}}),
+    data(vector({table{{data{1}, data{2}}}, data{3}})));
+}
+
+TEST(prefix pages only include matching keys) {
+  std::map<data, data> xs;
+  for (auto key : {"a", "a/1", "a/2", "a/3", "ab", "b/1"})
+    xs.emplace(data{key}, data{key});
+  std::vector<data> keys;
+  page_through(xs, key_range::starting_with(data{"a/"}), 2, keys);
+  CHECK_EQUAL(keys, vector({"a/1", "a/2", "a/3"}));
+}
@@ -137,4 +137,28 @@ CAF_TEST(set_command) {
   CHECK(at_end());
 }
 
+CAF_TEST(put_batch_command) {
+  push(put_batch_command{{{data{"key"}, data{"value"}}}, nil, {}});
+  CHECK_EQUAL(pull<internal_command::type>(),
+              internal_command::type::put_batch_command);
+  CHECK_EQUAL(pull<uint32_t>(), 1u);
+  CHECK_EQUAL(pull<data::type>(), data::type::string);
+  CHECK_EQUAL(pull<uint32_t>(), 3u);
+  CHECK_EQUAL(pull<data::type>(), data::type::string);
+  CHECK_EQUAL(pull<uint32_t>(), 5u);
+  CHECK(at_end());
+}
+
+CAF_TEST(erase_batch_command) {
+  push(erase_batch_command{{data{"a"}, data{"bc"}}, {}});
+  CHECK_EQUAL(pull<internal_command::type>(),
+              internal_command::type::erase_batch_command);
+  CHECK_EQUAL(pull<uint32_t>(), 2u);
+  CHECK_EQUAL(pull<data::type>(), data::type::string);
+  CHECK_EQUAL(pull<uint32_t>(), 1u);
+  CHECK_EQUAL(pull<data::type>(), data::type::string);
+  CHECK_EQUAL(pull<uint32_t>(), 2u);
+  CHECK(at_end());
+}
+
 CAF_TEST_FIXTURE_SCOPE_END()
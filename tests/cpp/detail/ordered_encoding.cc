@@ -0,0 +1,157 @@
+#define SUITE detail.ordered_encoding
+
+#include "broker/detail/ordered_encoding.hh"
+
+#include "test.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "broker/address.hh"
+#include "broker/enum_value.hh"
+#include "broker/port.hh"
+#include "broker/subnet.hh"
+#include "broker/time.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+address make_address(const std::string& str) {
+  address result;
+  if (!convert(str, result))
+    FAIL("invalid address: " << str);
+  return result;
+}
+
+// Lists values of each type in ascending order.
+std::vector<data> sorted_values() {
+  using namespace std::chrono;
+  auto int_min = std::numeric_limits<integer>::min();
+  auto int_max = std::numeric_limits<integer>::max();
+  auto addr1 = make_address("10.0.0.1");
+  auto addr2 = make_address("192.168.0.1");
+  auto addr3 = make_address("::1");
+  return {
+    data{},
+    data{false},
+    data{true},
+    data{count{0}},
+    data{count{1}},
+    data{count{255}},
+    data{count{256}},
+    data{std::numeric_limits<count>::max()},
+    data{int_min},
+    data{integer{-65536}},
+    data{integer{-256}},
+    data{integer{-255}},
+    data{integer{-1}},
+    data{integer{0}},
+    data{integer{1}},
+    data{integer{256}},
+    data{int_max},
+    data{-std::numeric_limits<real>::infinity()},
+    data{-1e10},
+    data{-0.5},
+    data{0.0},
+    data{0.25},
+    data{1e10},
+    data{std::numeric_limits<real>::infinity()},
+    data{""},
+    data{std::string{"\0", 1}},
+    data{std::string{"\0\0", 2}},
+    data{std::string{"\x01", 1}},
+    data{"a"},
+    data{std::string{"a\0", 2}},
+    data{"ab"},
+    data{"b"},
+    data{"\xff"},
+    data{addr3},
+    data{addr1},
+    data{addr2},
+    data{subnet{addr1, 8}},
+    data{subnet{make_address("10.1.0.0"), 16}},
+    data{subnet{addr2, 16}},
+    data{port{22, port::protocol::tcp}},
+    data{port{53, port::protocol::tcp}},
+    data{port{53, port::protocol::udp}},
+    data{port{65535, port::protocol::icmp}},
+    data{timestamp{timespan{-5}}},
+    data{timestamp{}},
+    data{timestamp{seconds{1}}},
+    data{timespan{-1}},
+    data{timespan{0}},
+    data{timespan{hours{1}}},
+    data{enum_value{"a"}},
+    data{enum_value{"b"}},
+    data{set{}},
+    data{set{1, 2}},
+    data{set{1, 3}},
+    data{set{2}},
+    data{table{}},
+    data{table{{1, "a"}}},
+    data{table{{1, "b"}}},
+    data{table{{1, "b"}, {2, "a"}}},
+    data{table{{2, "a"}}},
+    data{vector{}},
+    data{vector{nil}},
+    data{vector{count{1}}},
+    data{vector{1}},
+    data{vector{1, 2}},
+    data{vector{1, vector{}}},
+    data{vector{1, vector{1}}},
+    data{vector{"a", "b"}},
+    data{vector{"ab"}},
+  };
+}
+
+} // namespace
+
+TEST(all values survive a round trip) {
+  for (auto& x : sorted_values()) {
+    auto buf = encode_ordered(x);
+    auto y = decode_ordered(buf.data(), buf.size());
+    REQUIRE(y);
+    CHECK_EQUAL(*y, x);
+  }
+}
+
+TEST(encoded values sort in the order of data) {
+  auto xs = sorted_values();
+  REQUIRE(std::is_sorted(xs.begin(), xs.end()));
+  std::vector<std::vector<uint8_t>> encoded;
+  for (auto& x : xs)
+    encoded.emplace_back(encode_ordered(x));
+  for (size_t i = 1; i < encoded.size(); ++i) {
+    MESSAGE("compare " << xs[i - 1] << " and " << xs[i]);
+    CHECK(encoded[i - 1] < encoded[i]);
+  }
+}
+
+TEST(small values have short encodings) {
+  CHECK_EQUAL(encode_ordered(data{count{0}}).size(), 2u);
+  CHECK_EQUAL(encode_ordered(data{count{200}}).size(), 3u);
+  CHECK_EQUAL(encode_ordered(data{integer{-1}}).size(), 2u);
+  CHECK_EQUAL(encode_ordered(data{integer{100}}).size(), 3u);
+  CHECK_EQUAL(encode_ordered(data{"foo"}).size(), 6u);
+  CHECK_EQUAL(encode_ordered(data{vector{1, 2}}).size(), 8u);
+}
+
+TEST(decoding rejects malformed input) {
+  auto buf = encode_ordered(data{vector{1, "foo"}});
+  auto decode = [](const std::vector<uint8_t>& xs) {
+    return decode_ordered(xs.data(), xs.size());
+  };
+  for (size_t n = 0; n < buf.size(); ++n) {
+    std::vector<uint8_t> prefix(buf.begin(), buf.begin() + n);
+    CHECK_EQUAL(decode(prefix), ec::invalid_data);
+  }
+  auto trailing = buf;
+  trailing.push_back(0);
+  CHECK_EQUAL(decode(trailing), ec::invalid_data);
+  CHECK_EQUAL(decode(std::vector<uint8_t>{0xff}), ec::invalid_data);
+}
@@ -0,0 +1,59 @@
+#define SUITE detail.shared_subscriber_queue
+
+#include "broker/detail/shared_subscriber_queue.hh"
+
+#include "test.hh"
+
+using namespace broker;
+using namespace broker::detail;
+
+namespace {
+
+using chunk_type = std::vector<int>;
+
+struct fixture {
+  shared_subscriber_queue_ptr<int> uut = make_shared_subscriber_queue<int>();
+};
+
+} // namespace
+
+FIXTURE_SCOPE(shared_subscriber_queue_tests, fixture)
+
+TEST(consumers may take out more or less than a chunk) {
+  uut->produce(chunk_type{1, 2, 3});
+  uut->produce(chunk_type{});
+  uut->produce(4);
+  uut->produce(chunk_type{5, 6});
+  CHECK_EQUAL(uut->buffer_size(), 6u);
+  chunk_type xs;
+  size_t prev_size = 0;
+  CHECK_EQUAL(uut->consume(2, &prev_size, xs), 2u);
+  CHECK_EQUAL(prev_size, 6u);
+  CHECK_EQUAL(xs, chunk_type({1, 2}));
+  CHECK_EQUAL(uut->consume(3, nullptr, xs), 3u);
+  CHECK_EQUAL(xs, chunk_type({1, 2, 3, 4, 5}));
+  CHECK_EQUAL(uut->consume_all(), chunk_type({6}));
+  CHECK_EQUAL(uut->buffer_size(), 0u);
+  CHECK_EQUAL(uut->consume_all(), chunk_type{});
+}
+
+TEST(consumers receive whole chunks without copying) {
+  chunk_type xs{1, 2, 3};
+  auto addr = xs.data();
+  uut->produce(std::move(xs));
+  auto ys = uut->consume_all();
+  CHECK_EQUAL(ys, chunk_type({1, 2, 3}));
+  CHECK(ys.data() == addr);
+}
+
+TEST(element-wise consumers see all values in order) {
+  uut->produce(chunk_type{1, 2});
+  uut->produce(chunk_type{3, 4});
+  chunk_type xs;
+  auto f = [&](int&& x) { xs.emplace_back(x); };
+  CHECK_EQUAL(uut->consume(3, nullptr, f), 3u);
+  CHECK_EQUAL(uut->consume(3, nullptr, f), 1u);
+  CHECK_EQUAL(xs, chunk_type({1, 2, 3, 4}));
+}
+
+FIXTURE_SCOPE_END()
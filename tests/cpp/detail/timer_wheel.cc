@@ -0,0 +1,80 @@
+#define SUITE detail.timer_wheel
+
+#include "broker/detail/timer_wheel.hh"
+
+#include "test.hh"
+
+#include <algorithm>
+
+using namespace broker;
+using namespace broker::detail;
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct fixture {
+  timestamp t0 = timestamp{timespan{1s}};
+
+  timer_wheel uut{100ms, t0};
+
+  // Advances the wheel to `t0 + dt` and returns the sorted keys.
+  std::vector<data> advance(timespan dt) {
+    auto result = uut.advance(t0 + dt);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+};
+
+using data_list = std::vector<data>;
+
+} // namespace
+
+FIXTURE_SCOPE(timer_wheel_tests, fixture)
+
+TEST(keys fire at the first tick after their deadline) {
+  uut.schedule("a", t0 + 250ms);
+  uut.schedule("b", t0 + 300ms);
+  CHECK_EQUAL(uut.size(), 2u);
+  CHECK_EQUAL(advance(200ms), data_list{});
+  CHECK_EQUAL(advance(299ms), data_list{});
+  CHECK_EQUAL(advance(300ms), data_list({"a", "b"}));
+  CHECK(uut.empty());
+}
+
+TEST(the wheel rounds ticks to multiples of its resolution) {
+  CHECK_EQUAL(uut.next_tick(t0), t0 + 100ms);
+  CHECK_EQUAL(uut.next_tick(t0 + 150ms), t0 + 200ms);
+}
+
+TEST(rescheduling a key replaces its deadline) {
+  uut.schedule("a", t0 + 1s);
+  uut.schedule("a", t0 + 2s);
+  CHECK_EQUAL(uut.size(), 1u);
+  CHECK_EQUAL(advance(1s), data_list{});
+  CHECK_EQUAL(advance(2s), data_list({"a"}));
+  uut.schedule("b", t0 + 5s);
+  uut.schedule("b", t0 + 3s);
+  CHECK_EQUAL(advance(3s), data_list({"b"}));
+  CHECK_EQUAL(advance(5s), data_list{});
+}
+
+TEST(deadlines in the past fire at the next tick) {
+  uut.schedule("a", t0 - 1s);
+  CHECK_EQUAL(advance(0s), data_list{});
+  CHECK_EQUAL(advance(100ms), data_list({"a"}));
+}
+
+TEST(the wheel handles deadlines far in the future) {
+  auto days = [](int n) { return std::chrono::hours{24 * n}; };
+  uut.schedule("a", t0 + 10s);
+  uut.schedule("b", t0 + 1h);
+  uut.schedule("c", t0 + days(40));
+  CHECK_EQUAL(advance(20s), data_list({"a"}));
+  CHECK_EQUAL(advance(days(1)), data_list({"b"}));
+  CHECK_EQUAL(advance(days(40) - 1s), data_list{});
+  CHECK_EQUAL(advance(days(40)), data_list({"c"}));
+  CHECK(uut.empty());
+}
+
+FIXTURE_SCOPE_END()
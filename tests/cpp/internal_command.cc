@@ -0,0 +1,121 @@
+#define SUITE internal_command
+
+#include "broker/internal_command.hh"
+
+#include "test.hh"
+
+#include <vector>
+
+#include <caf/deep_to_string.hpp>
+
+using namespace broker;
+
+namespace {
+
+struct fixture {
+  publisher_id alice{caf::node_id{}, 1};
+
+  publisher_id bob{caf::node_id{}, 2};
+
+  std::vector<internal_command> cmds;
+
+  template <class T>
+  void add(T x) {
+    cmds.emplace_back(internal_command{std::move(x)});
+  }
+
+  template <class T>
+  const T& at(size_t index) {
+    if (index >= cmds.size())
+      FAIL("index out of range");
+    auto ptr = caf::get_if<T>(&cmds[index].content);
+    if (ptr == nullptr)
+      FAIL("unexpected command: " << caf::deep_to_string(cmds[index]));
+    return *ptr;
+  }
+};
+
+} // namespace
+
+FIXTURE_SCOPE(internal_command_tests, fixture)
+
+TEST(single commands remain unchanged) {
+  add(put_command{data{"a"}, data{1}, nil, alice});
+  batch_commands(cmds);
+  REQUIRE_EQUAL(cmds.size(), 1u);
+  CHECK_EQUAL(at<put_command>(0).key, data{"a"});
+}
+
+TEST(consecutive commands of the same kind turn into a batch) {
+  add(put_command{data{"a"}, data{1}, nil, alice});
+  add(put_command{data{"b"}, data{2}, nil, alice});
+  add(put_command{data{"c"}, data{3}, nil, alice});
+  add(erase_command{data{"a"}, alice});
+  add(erase_command{data{"b"}, alice});
+  add(expire_command{data{"c"}, alice});
+  add(expire_command{data{"d"}, alice});
+  batch_commands(cmds);
+  REQUIRE_EQUAL(cmds.size(), 3u);
+  auto& puts = at<put_batch_command>(0);
+  REQUIRE_EQUAL(puts.entries.size(), 3u);
+  CHECK_EQUAL(puts.entries[0].first, data{"a"});
+  CHECK_EQUAL(puts.entries[1].first, data{"b"});
+  CHECK_EQUAL(puts.entries[2].first, data{"c"});
+  CHECK_EQUAL(puts.entries[2].second, data{3});
+  CHECK_EQUAL(puts.publisher, alice);
+  CHECK_EQUAL(at<erase_batch_command>(1).keys, vector({data{"a"}, data{"b"}}));
+  CHECK_EQUAL(at<expire_batch_command>(2).keys,
+              vector({data{"c"}, data{"d"}}));
+}
+
+TEST(batches never reorder commands) {
+  add(put_command{data{"a"}, data{1}, nil, alice});
+  add(erase_command{data{"a"}, alice});
+  add(put_command{data{"a"}, data{2}, nil, alice});
+  add(clear_command{alice});
+  add(erase_command{data{"b"}, alice});
+  batch_commands(cmds);
+  REQUIRE_EQUAL(cmds.size(), 5u);
+  CHECK_EQUAL(at<put_command>(0).value, data{1});
+  CHECK_EQUAL(at<erase_command>(1).key, data{"a"});
+  CHECK_EQUAL(at<put_command>(2).value, data{2});
+  CHECK_EQUAL(at<clear_command>(3).publisher, alice);
+  CHECK_EQUAL(at<erase_command>(4).key, data{"b"});
+}
+
+TEST(batches only combine commands with the same publisher and expiry) {
+  add(put_command{data{"a"}, data{1}, nil, alice});
+  add(put_command{data{"b"}, data{2}, nil, bob});
+  add(put_command{data{"c"}, data{3}, timespan{1}, bob});
+  add(put_command{data{"d"}, data{4}, timespan{1}, bob});
+  add(erase_command{data{"a"}, alice});
+  add(erase_command{data{"b"}, bob});
+  batch_commands(cmds);
+  REQUIRE_EQUAL(cmds.size(), 5u);
+  CHECK_EQUAL(at<put_command>(0).publisher, alice);
+  CHECK_EQUAL(at<put_command>(1).publisher, bob);
+  CHECK_EQUAL(at<put_batch_command>(2).entries.size(), 2u);
+  CHECK_EQUAL(at<put_batch_command>(2).expiry, timespan{1});
+  CHECK_EQUAL(at<erase_command>(3).publisher, alice);
+  CHECK_EQUAL(at<erase_command>(4).publisher, bob);
+}
+
+TEST(mutation counts reflect the number of updates per command) {
+  auto count = [](auto x) {
+    return mutation_count(internal_command{std::move(x)}.content);
+  };
+  CHECK_EQUAL(count(put_command{data{"a"}, data{1}, nil, alice}), 1u);
+  CHECK_EQUAL(count(erase_command{data{"a"}, alice}), 1u);
+  CHECK_EQUAL(count(expire_command{data{"a"}, alice}), 1u);
+  CHECK_EQUAL(count(clear_command{alice}), 1u);
+  CHECK_EQUAL(count(snapshot_sync_command{}), 0u);
+  CHECK_EQUAL(count(erase_batch_command{{data{"a"}, data{"b"}}, alice}), 2u);
+  add(put_command{data{"a"}, data{1}, nil, alice});
+  add(put_command{data{"b"}, data{2}, nil, alice});
+  add(put_command{data{"c"}, data{3}, nil, alice});
+  batch_commands(cmds);
+  REQUIRE_EQUAL(cmds.size(), 1u);
+  CHECK_EQUAL(mutation_count(cmds[0].content), 3u);
+}
+
+FIXTURE_SCOPE_END()
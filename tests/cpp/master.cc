@@ -7,13 +7,18 @@
 #include <chrono>
 #include <regex>
 
+#include <caf/send.hpp>
 #include <caf/test/io_dsl.hpp>
 
 #include "broker/atoms.hh"
 #include "broker/backend.hh"
+#include "broker/backend_options.hh"
 #include "broker/data.hh"
 #include "broker/defaults.hh"
+#include "broker/detail/abstract_backend.hh"
 #include "broker/detail/clone_actor.hh"
+#include "broker/detail/clone_view.hh"
+#include "broker/detail/key_range.hh"
 #include "broker/detail/master_actor.hh"
 #include "broker/endpoint.hh"
 #include "broker/error.hh"
@@ -174,6 +179,142 @@ TEST(local_master) {
 
 FIXTURE_SCOPE_END()
 
+FIXTURE_SCOPE(clone_snapshots, fixture)
+
+TEST(clones emit the difference to a full snapshot as events) {
+  auto core = ep.core();
+  endpoint::clock clock{&sys, false};
+  auto clone = sys.spawn(
+    [&](caf::stateful_actor<clone_state>* self) -> caf::behavior {
+      self->state.master = core;
+      self->state.init(self, "foo", caf::actor{core}, &clock);
+      self->state.store = {{data{"a"}, data{1}}, {data{"b"}, data{2}}};
+      return {
+        [=](set_command& x) { self->state(x); },
+      };
+    });
+  run(tick_interval);
+  anon_send(clone, set_command{{{data{"b"}, data{3}}, {data{"c"}, data{4}}}});
+  run(tick_interval);
+  CHECK_EQUAL(log, pattern_list({
+                     "erase\\(foo, a, .+\\)",
+                     "update\\(foo, b, 2, 3, (null|none), .+\\)",
+                     "insert\\(foo, c, 4, (null|none), .+\\)",
+                   }));
+  auto& st = deref<caf::stateful_actor<clone_state>>(clone).state;
+  CHECK_EQUAL(st.store.size(), 2u);
+  // done
+  anon_send_exit(clone, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+TEST(clones emit the difference to a chunked snapshot as events) {
+  auto core = ep.core();
+  endpoint::clock clock{&sys, false};
+  auto clone = sys.spawn(
+    [&](caf::stateful_actor<clone_state>* self) -> caf::behavior {
+      self->state.master = core;
+      self->state.init(self, "foo", caf::actor{core}, &clock);
+      self->state.store = {{data{"a"}, data{1}}, {data{"b"}, data{2}}};
+      return {
+        [=](set_chunk_command& x) { self->state(x); },
+      };
+    });
+  run(tick_interval);
+  anon_send(clone, set_chunk_command{{{data{"b"}, data{3}}}, false, 0});
+  run(tick_interval);
+  anon_send(clone, set_chunk_command{{{data{"c"}, data{4}}}, true, 0});
+  run(tick_interval);
+  CHECK_EQUAL(log, pattern_list({
+                     "update\\(foo, b, 2, 3, (null|none), .+\\)",
+                     "insert\\(foo, c, 4, (null|none), .+\\)",
+                     "erase\\(foo, a, .+\\)",
+                   }));
+  auto& st = deref<caf::stateful_actor<clone_state>>(clone).state;
+  CHECK_EQUAL(st.store.size(), 2u);
+  CHECK(st.snapshot_keys.empty());
+  // done
+  anon_send_exit(clone, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+TEST(clones answer range queries from an ordered index) {
+  auto core = ep.core();
+  endpoint::clock clock{&sys, false};
+  auto clone = sys.spawn(
+    [&](caf::stateful_actor<clone_state>* self) -> caf::behavior {
+      self->state.master = core;
+      self->state.init(self, "foo", caf::actor{core}, &clock);
+      self->state.range_page_size = 2;
+      return {
+        [=](put_command& x) { self->state(x); },
+        [=](erase_command& x) { self->state(x); },
+      };
+    });
+  run(tick_interval);
+  for (integer i = 0; i < 5; ++i)
+    anon_send(clone, put_command{data{i}, data{i * 2}, nil, publisher_id{}});
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<clone_state>>(clone).state;
+  CHECK(!st.has_ordered_keys);
+  auto range = key_range::between(data{1}, data{10});
+  CHECK_EQUAL(st.range(range),
+              data(vector{table{{1, 2}, {2, 4}}, data{3}}));
+  CHECK_EQUAL(st.ordered_keys.size(), 5u);
+  MESSAGE("the index follows all updates after the first range query");
+  anon_send(clone, erase_command{data{3}, publisher_id{}});
+  anon_send(clone, put_command{data{7}, data{14}, nil, publisher_id{}});
+  run(tick_interval);
+  CHECK_EQUAL(st.range(range.resume_at(data{3})),
+              data(vector{table{{4, 8}, {7, 14}}}));
+  // done
+  anon_send_exit(clone, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+TEST(clones mirror their content into their view) {
+  auto core = ep.core();
+  endpoint::clock clock{&sys, false};
+  auto view = std::make_shared<clone_view>();
+  auto clone = sys.spawn(
+    [&](caf::stateful_actor<clone_state>* self) -> caf::behavior {
+      self->state.master = core;
+      self->state.init(self, "foo", caf::actor{core}, &clock);
+      self->state.view = view;
+      self->state.is_stale = false;
+      return {
+        [=](set_command& x) {
+          self->state(x);
+          self->state.publish_view();
+        },
+        [=](put_command& x) {
+          self->state(x);
+          self->state.publish_view();
+        },
+        [=](erase_command& x) {
+          self->state(x);
+          self->state.publish_view();
+        },
+      };
+    });
+  run(tick_interval);
+  anon_send(clone, set_command{{{data{"a"}, data{1}}, {data{"b"}, data{2}}}});
+  run(tick_interval);
+  CHECK_EQUAL(view->get("a"), data{1});
+  CHECK_EQUAL(view->get("b"), data{2});
+  anon_send(clone, put_command{data{"a"}, data{3}, nil, publisher_id{}});
+  anon_send(clone, erase_command{data{"b"}, publisher_id{}});
+  run(tick_interval);
+  CHECK_EQUAL(view->get("a"), data{3});
+  CHECK_EQUAL(view->get("b"), ec::no_such_key);
+  CHECK_EQUAL(view->size(), 1u);
+  // done
+  anon_send_exit(clone, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
+
 FIXTURE_SCOPE(store_master, net_fixture<fixture>)
 
 TEST(master_with_clone) {
@@ -267,4 +408,366 @@ TEST(master_with_clone) {
                         }));
 }
 
+TEST(masters send batched updates to their clones) {
+  caf::timespan tick_interval = defaults::store::tick_interval;
+  MESSAGE("connect mars and earth");
+  auto core1 = earth.ep.core();
+  auto core2 = mars.ep.core();
+  prepare_connection(mars, earth, "mars", 8080u);
+  run(tick_interval);
+  mars.sched.inline_next_enqueue(); // listen() calls middleman().publish()
+  CHECK_EQUAL(mars.ep.listen("", 8080u), 8080u);
+  run(tick_interval);
+  auto core2_proxy = earth.remote_actor("mars", 8080u);
+  run(tick_interval);
+  MESSAGE("attach a master with a batch window on earth");
+  earth.sched.inline_next_enqueue();
+  auto expected_ds_earth = earth.ep.attach_master("foo", backend::memory);
+  REQUIRE(expected_ds_earth.engaged());
+  auto& ds_earth = *expected_ds_earth;
+  run(tick_interval);
+  auto& master_st
+    = earth.deref<caf::stateful_actor<master_state>>(ds_earth.frontend())
+        .state;
+  master_st.batch_window = std::chrono::seconds(1);
+  MESSAGE("peer earth and mars and attach a clone on mars");
+  earth.self->send(core1, atom::peer_v, core2_proxy);
+  run(tick_interval);
+  mars.sched.inline_next_enqueue();
+  auto expected_ds_mars = mars.ep.attach_clone("foo");
+  REQUIRE(expected_ds_mars.engaged());
+  auto& ds_mars = *expected_ds_mars;
+  run(tick_interval);
+  MESSAGE("the master holds back updates until the batch window closes");
+  ds_earth.put("a", 1);
+  ds_earth.put("b", 2);
+  ds_earth.put("c", 3);
+  ds_earth.erase("a");
+  run(tick_interval);
+  CHECK_EQUAL(master_st.pending_commands.size(), 4u);
+  mars.sched.inline_next_enqueue();
+  CHECK_EQUAL(error_of(ds_mars.get("b")), caf::error{ec::no_such_key});
+  MESSAGE("the clone applies all updates of the batch");
+  run(std::chrono::seconds(1));
+  CHECK(master_st.pending_commands.empty());
+  mars.sched.inline_next_enqueue();
+  CHECK_EQUAL(error_of(ds_mars.get("a")), caf::error{ec::no_such_key});
+  mars.sched.inline_next_enqueue();
+  CHECK_EQUAL(value_of(ds_mars.get("b")), data{2});
+  mars.sched.inline_next_enqueue();
+  CHECK_EQUAL(value_of(ds_mars.get("c")), data{3});
+  // done
+  anon_send_exit(core1, caf::exit_reason::user_shutdown);
+  anon_send_exit(core2, caf::exit_reason::user_shutdown);
+  exec_all();
+  // check log
+  CHECK_EQUAL(mars.log, earth.log);
+  CHECK_EQUAL(mars.log, pattern_list({
+                          "insert\\(foo, a, 1, (null|none), .+\\)",
+                          "insert\\(foo, b, 2, (null|none), .+\\)",
+                          "insert\\(foo, c, 3, (null|none), .+\\)",
+                          "erase\\(foo, a, .+\\)",
+                        }));
+}
+
+FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(store_event_subscriptions, base_fixture)
+
+TEST(the core tells masters whether anyone receives their events) {
+  caf::timespan tick_interval = defaults::store::tick_interval;
+  auto core = ep.core();
+  run(tick_interval);
+  sched.inline_next_enqueue(); // ep.attach talks to the core (blocking)
+  auto expected_ds = ep.attach_master("foo", backend::memory);
+  REQUIRE(expected_ds.engaged());
+  auto& ds = *expected_ds;
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<master_state>>(ds.frontend()).state;
+  CHECK(!st.has_event_subscribers());
+  MESSAGE("subscribers for other stores do not receive events of foo");
+  auto nop = [](caf::unit_t&) {};
+  auto consume = [](caf::unit_t&, data_message) {};
+  auto bar_logger = ep.subscribe_nosync({topics::store_events / "bar"}, nop,
+                                        consume, nop);
+  run(tick_interval);
+  CHECK(!st.has_event_subscribers());
+  MESSAGE("subscribing to the events of foo enables events");
+  auto foo_logger = ep.subscribe_nosync({topics::store_events / "foo"}, nop,
+                                        consume, nop);
+  run(tick_interval);
+  CHECK(st.has_event_subscribers());
+  // done
+  anon_send_exit(bar_logger, caf::exit_reason::user_shutdown);
+  anon_send_exit(foo_logger, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(mutation_log, base_fixture)
+
+TEST(masters keep a bounded log of recent mutations) {
+  caf::timespan tick_interval = defaults::store::tick_interval;
+  auto core = ep.core();
+  run(tick_interval);
+  sched.inline_next_enqueue(); // ep.attach talks to the core (blocking)
+  auto expected_ds = ep.attach_master("foo", backend::memory);
+  REQUIRE(expected_ds.engaged());
+  auto& ds = *expected_ds;
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<master_state>>(ds.frontend()).state;
+  st.mutation_log_size = 2;
+  CHECK_EQUAL(st.seq, 0u);
+  MESSAGE("each mutation increments the sequence number");
+  ds.put("a", 1);
+  ds.put("b", 2);
+  ds.erase("a");
+  run(tick_interval);
+  CHECK_EQUAL(st.seq, 3u);
+  CHECK_EQUAL(st.mutation_log.size(), 2u);
+  MESSAGE("clones get a delta as long as the log covers what they missed");
+  auto delta = st.delta_since(1);
+  REQUIRE(delta);
+  REQUIRE_EQUAL(delta->size(), 2u);
+  CHECK(caf::holds_alternative<put_command>((*delta)[0].content));
+  CHECK(caf::holds_alternative<erase_command>((*delta)[1].content));
+  delta = st.delta_since(3);
+  REQUIRE(delta);
+  CHECK(delta->empty());
+  MESSAGE("clones need a snapshot after the log dropped missed mutations");
+  CHECK(!st.delta_since(0));
+  CHECK(!st.delta_since(4));
+  // done
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(snapshot_transfer, base_fixture)
+
+TEST(masters wait for acknowledgements before sending more snapshot chunks) {
+  caf::timespan tick_interval = defaults::store::tick_interval;
+  auto core = ep.core();
+  run(tick_interval);
+  sched.inline_next_enqueue(); // ep.attach talks to the core (blocking)
+  auto expected_ds = ep.attach_master("foo", backend::memory);
+  REQUIRE(expected_ds.engaged());
+  auto& ds = *expected_ds;
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<master_state>>(ds.frontend()).state;
+  st.snapshot_chunk_size = 2;
+  st.snapshot_credit = 2;
+  for (integer i = 0; i < 10; ++i)
+    ds.put(i, i);
+  run(tick_interval);
+  auto chunks = std::make_shared<std::vector<set_chunk_command>>();
+  auto clone = sys.spawn([chunks](caf::event_based_actor*) -> caf::behavior {
+    return {
+      [chunks](set_chunk_command& x) { chunks->emplace_back(std::move(x)); },
+    };
+  });
+  anon_send(ds.frontend(), atom::local_v,
+            make_internal_command<snapshot_command>(clone, clone));
+  run(tick_interval);
+  MESSAGE("the master stops after sending as many chunks as the credit");
+  CHECK_EQUAL(chunks->size(), 2u);
+  CHECK_EQUAL(st.snapshot_transfers.size(), 1u);
+  MESSAGE("the master keeps processing updates during the snapshot");
+  ds.put(100, 100);
+  run(tick_interval);
+  CHECK_EQUAL(st.seq, 11u);
+  MESSAGE("each acknowledgement releases one more chunk");
+  caf::send_as(clone, ds.frontend(), atom::ack_v, atom::snapshot_v);
+  run(tick_interval);
+  CHECK_EQUAL(chunks->size(), 3u);
+  for (size_t i = 0; i < 10 && !chunks->back().last; ++i) {
+    caf::send_as(clone, ds.frontend(), atom::ack_v, atom::snapshot_v);
+    run(tick_interval);
+  }
+  MESSAGE("the snapshot includes all keys, starting at sequence number 10");
+  broker::snapshot received;
+  for (size_t i = 0; i < chunks->size(); ++i) {
+    auto& chunk = (*chunks)[i];
+    CHECK_LESS_EQUAL(chunk.state.size(), 2u);
+    CHECK_EQUAL(chunk.last, i + 1 == chunks->size());
+    CHECK_EQUAL(chunk.seq, 10u);
+    received.insert(chunk.state.begin(), chunk.state.end());
+  }
+  CHECK_EQUAL(received.size(), 11u);
+  CHECK_EQUAL(received.count(data{100}), 1u);
+  CHECK(st.snapshot_transfers.empty());
+  // done
+  anon_send_exit(clone, caf::exit_reason::user_shutdown);
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(sharded_master, fixture)
+
+TEST(sharded masters spread keys over their shards) {
+  auto core = ep.core();
+  run(tick_interval);
+  sched.inline_next_enqueue(); // ep.attach talks to the core (blocking)
+  auto expected_ds = ep.attach_master("foo", backend::memory,
+                                      backend_options{{"shards", count{4}}});
+  REQUIRE(expected_ds.engaged());
+  auto& ds = *expected_ds;
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<master_state>>(ds.frontend()).state;
+  REQUIRE_EQUAL(st.shards.size(), 4u);
+  CHECK(st.backend == nullptr);
+  auto run_until_idle = [&] { run(tick_interval); };
+  MESSAGE("each shard stores the keys that hash to it");
+  std::vector<data> keys;
+  for (integer i = 0; i < 16; ++i)
+    keys.emplace_back(i);
+  for (auto& key : keys)
+    ds.put(key, key);
+  run(tick_interval);
+  CHECK_EQUAL(st.seq, 16u);
+  for (size_t i = 0; i < st.shards.size(); ++i) {
+    auto& shard = deref<caf::stateful_actor<master_state>>(st.shards[i]).state;
+    CHECK(shard.coordinator == ds.frontend());
+    for (auto& key : keys)
+      CHECK_EQUAL(unbox(shard.backend->exists(key)), st.shard_of(key) == i);
+  }
+  MESSAGE("lookups go to the shard that owns the key");
+  for (auto& key : keys) {
+    sched.after_next_enqueue(run_until_idle);
+    CHECK_EQUAL(value_of(ds.get(key)), key);
+  }
+  MESSAGE("queries for multiple keys fan out and merge the results");
+  sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds.keys()), data{set(keys.begin(), keys.end())});
+  sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds.get_many({data{1}, data{5}, data{"none"}})),
+              data{table{{1, 1}, {5, 5}}});
+  sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds.exists_many({data{3}, data{"none"}, data{7}})),
+              data{vector{true, false, true}});
+  sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds.get_range(data{4}, data{8})),
+              data{table{{4, 4}, {5, 5}, {6, 6}, {7, 7}}});
+  MESSAGE("range queries without request ID fan out as well");
+  self->send(ds.frontend(), atom::get_v, key_range::between(data{4}, data{6}));
+  run(tick_interval);
+  self->receive([](const data& x) {
+    CHECK_EQUAL(x, data(vector{table{{4, 4}, {5, 5}}}));
+  });
+  MESSAGE("clearing the store is a single mutation for all shards");
+  ds.clear();
+  run(tick_interval);
+  CHECK_EQUAL(st.seq, 17u);
+  CHECK_EQUAL(st.pending_clears, 0u);
+  sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds.keys()), data{set{}});
+  // done
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+TEST(sharded masters hold back mutations until all shards have cleared) {
+  auto core = ep.core();
+  run(tick_interval);
+  sched.inline_next_enqueue(); // ep.attach talks to the core (blocking)
+  auto expected_ds = ep.attach_master("foo", backend::memory,
+                                      backend_options{{"shards", count{2}}});
+  REQUIRE(expected_ds.engaged());
+  auto& ds = *expected_ds;
+  run(tick_interval);
+  auto& st = deref<caf::stateful_actor<master_state>>(ds.frontend()).state;
+  st.mutation_log_size = 10;
+  auto put = [](integer key) {
+    std::vector<internal_command> xs;
+    xs.emplace_back(make_internal_command<put_command>(data{key}, data{key},
+                                                       nil, publisher_id{}));
+    return xs;
+  };
+  auto clear = [] {
+    std::vector<internal_command> xs;
+    xs.emplace_back(make_internal_command<clear_command>(publisher_id{}));
+    return xs;
+  };
+  auto xs = clear();
+  st.replicate(0, xs);
+  CHECK_EQUAL(st.pending_clears, 1u);
+  MESSAGE("mutations after the clear of shard 0 wait for shard 1");
+  xs = put(1);
+  st.replicate(0, xs);
+  MESSAGE("mutations before the clear of shard 1 go out right away");
+  xs = put(2);
+  st.replicate(1, xs);
+  CHECK_EQUAL(st.seq, 1u);
+  xs = clear();
+  st.replicate(1, xs);
+  CHECK_EQUAL(st.pending_clears, 0u);
+  CHECK_EQUAL(st.seq, 3u);
+  REQUIRE_EQUAL(st.mutation_log.size(), 3u);
+  auto key_of = [](const internal_command& x) {
+    return caf::get<put_command>(x.content).key;
+  };
+  CHECK_EQUAL(key_of(st.mutation_log[0]), data{2});
+  CHECK(caf::holds_alternative<clear_command>(st.mutation_log[1].content));
+  CHECK_EQUAL(key_of(st.mutation_log[2]), data{1});
+  // done
+  anon_send_exit(core, caf::exit_reason::user_shutdown);
+}
+
+FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(sharded_store_master, net_fixture<fixture>)
+
+TEST(clones see a single store for sharded masters) {
+  caf::timespan tick_interval = defaults::store::tick_interval;
+  auto core1 = earth.ep.core();
+  MESSAGE("connect mars and earth");
+  prepare_connection(mars, earth, "mars", 8080u);
+  run(tick_interval);
+  mars.sched.inline_next_enqueue(); // listen() calls middleman().publish()
+  CHECK_EQUAL(mars.ep.listen("", 8080u), 8080u);
+  run(tick_interval);
+  auto core2_proxy = earth.remote_actor("mars", 8080u);
+  run(tick_interval);
+  MESSAGE("attach a master with three shards on earth");
+  earth.sched.inline_next_enqueue();
+  auto expected_ds_earth
+    = earth.ep.attach_master("foo", backend::memory,
+                             backend_options{{"shards", count{3}}});
+  REQUIRE(expected_ds_earth.engaged());
+  auto& ds_earth = *expected_ds_earth;
+  run(tick_interval);
+  ds_earth.put("a", 1);
+  ds_earth.put("b", 2);
+  ds_earth.put("c", 3);
+  run(tick_interval);
+  MESSAGE("peer earth and mars and attach a clone on mars");
+  earth.self->send(core1, atom::peer_v, core2_proxy);
+  run(tick_interval);
+  mars.sched.inline_next_enqueue();
+  auto expected_ds_mars = mars.ep.attach_clone("foo");
+  REQUIRE(expected_ds_mars.engaged());
+  auto& ds_mars = *expected_ds_mars;
+  run(tick_interval);
+  MESSAGE("the clone received the entries of all shards");
+  auto run_until_idle = [&] { run(tick_interval); };
+  mars.sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds_mars.keys()), data{set{"a", "b", "c"}});
+  MESSAGE("updates from the clone reach the shards and come back");
+  ds_mars.put("d", 4);
+  ds_mars.erase("a");
+  run_until_idle();
+  mars.sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds_mars.keys()), data{set{"b", "c", "d"}});
+  earth.sched.after_next_enqueue(run_until_idle);
+  CHECK_EQUAL(value_of(ds_earth.keys()), data{set{"b", "c", "d"}});
+  using master_type = caf::stateful_actor<master_state>;
+  auto& st = earth.deref<master_type>(ds_earth.frontend()).state;
+  CHECK_EQUAL(st.seq, 5u);
+  // done
+  anon_send_exit(earth.ep.core(), caf::exit_reason::user_shutdown);
+  anon_send_exit(mars.ep.core(), caf::exit_reason::user_shutdown);
+  exec_all();
+}
+
 FIXTURE_SCOPE_END()
@@ -131,6 +131,47 @@ CAF_TEST(blocking_publishers) {
   anon_send_exit(leaf, exit_reason::user_shutdown);
 }
 
+CAF_TEST(lock_free_publishers) {
+  // Spawn/get/configure core actors.
+  broker_options options;
+  options.disable_ssl = true;
+  auto core1 = ep.core();
+  auto core2 = sys.spawn<core_actor_type>(filter_type{"a"}, options, nullptr);
+  anon_send(core1, atom::subscribe_v, filter_type{"a"});
+  anon_send(core1, atom::no_events_v);
+  anon_send(core2, atom::no_events_v);
+  self->send(core1, atom::peer_v, core2);
+  auto leaf = sys.spawn(consumer, filter_type{"a/b"}, core2);
+  run();
+  { // Lifetime scope of our publisher.
+    auto pub = ep.make_publisher("a/b", publisher_queue_type::lock_free);
+    pub.drop_all_on_destruction();
+    run();
+    CAF_CHECK_EQUAL(pub.capacity(), pub.free_capacity());
+    pub.publish(true);
+    run();
+    pub.publish({false, true});
+    run();
+    CAF_CHECK_EQUAL(pub.buffered(), 0u);
+    using buf = std::vector<data_message>;
+    self->send(leaf, atom::get_v);
+    sched.prioritize(leaf);
+    consume_message();
+    self->receive(
+      [](const buf& xs) {
+        auto expected = data_msgs({{"a/b", true}, {"a/b", false},
+                                   {"a/b", true}});
+        CAF_REQUIRE_EQUAL(xs, expected);
+      }
+    );
+  }
+  // Shutdown.
+  CAF_MESSAGE("Shutdown core actors.");
+  anon_send_exit(core1, exit_reason::user_shutdown);
+  anon_send_exit(core2, exit_reason::user_shutdown);
+  anon_send_exit(leaf, exit_reason::user_shutdown);
+}
+
 CAF_TEST(nonblocking_publishers) {
   // Spawn/get/configure core actors.
   broker_options options;
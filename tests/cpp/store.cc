@@ -7,9 +7,11 @@
 #include <chrono>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "broker/backend.hh"
 #include "broker/backend_options.hh"
+#include "broker/configuration.hh"
 #include "broker/data.hh"
 #include "broker/endpoint.hh"
 #include "broker/error.hh"
@@ -78,6 +80,84 @@ TEST(master operations) {
   REQUIRE_EQUAL(ds->get_index_from_value("foo", 2), true);
   MESSAGE("keys");
   REQUIRE_EQUAL(value_of(ds->keys()), data(set{"foo"}));
+  MESSAGE("put_many");
+  ds->put_many({{"foo", 1}, {"bar", 2}, {"baz", 3}});
+  REQUIRE_EQUAL(value_of(ds->keys()), data(set{"bar", "baz", "foo"}));
+  MESSAGE("get_many");
+  REQUIRE_EQUAL(value_of(ds->get_many({"foo", "qux", "baz"})),
+                data(table{{"baz", 3}, {"foo", 1}}));
+  MESSAGE("exists_many");
+  REQUIRE_EQUAL(value_of(ds->exists_many({"foo", "qux", "baz"})),
+                data(vector{true, false, true}));
+}
+
+TEST(range and prefix queries) {
+  configuration cfg;
+  cfg.set("broker.store.range-page-size", 2);
+  endpoint ep{std::move(cfg)};
+  auto ds = ep.attach_master("tuvok", backend::memory);
+  REQUIRE(ds);
+  for (int i = 0; i < 10; ++i)
+    ds->put(i, i * 2);
+  ds->put("host/10.0.0.1", 1);
+  ds->put("host/10.0.0.2", 2);
+  ds->put("hosts", 3);
+  ds->put(vector{"conn", 1}, 4);
+  ds->put(vector{"conn", 2}, 5);
+  ds->put(vector{"dns", 1}, 6);
+  MESSAGE("get_range");
+  CHECK_EQUAL(value_of(ds->get_range(3, 8)),
+              data(table{{3, 6}, {4, 8}, {5, 10}, {6, 12}, {7, 14}}));
+  CHECK_EQUAL(value_of(ds->get_range(20, 30)), data(table{}));
+  MESSAGE("get_prefix");
+  CHECK_EQUAL(value_of(ds->get_prefix("host/")),
+              data(table{{"host/10.0.0.1", 1}, {"host/10.0.0.2", 2}}));
+  CHECK_EQUAL(value_of(ds->get_prefix(vector{"conn"})),
+              data(table{{vector{"conn", 1}, 4}, {vector{"conn", 2}, 5}}));
+  MESSAGE("for_each_range_page passes one page at a time");
+  std::vector<table> pages;
+  auto collect = [&](table& page) {
+    pages.emplace_back(std::move(page));
+    return true;
+  };
+  REQUIRE(ds->for_each_range_page(3, 8, collect));
+  CHECK_EQUAL(pages, (std::vector<table>{{{3, 6}, {4, 8}},
+                                         {{5, 10}, {6, 12}},
+                                         {{7, 14}}}));
+  MESSAGE("returning false stops the query");
+  pages.clear();
+  REQUIRE(ds->for_each_prefix_page("host", [&](table& page) {
+    pages.emplace_back(std::move(page));
+    return false;
+  }));
+  CHECK_EQUAL(pages, (std::vector<table>{
+                       {{"host/10.0.0.1", 1}, {"host/10.0.0.2", 2}}}));
+}
+
+TEST(concurrent lookups on the same store) {
+  endpoint ep;
+  auto ds = ep.attach_master("sarek", backend::memory);
+  REQUIRE(ds);
+  for (int i = 0; i < 10; ++i)
+    ds->put(i, i * 2);
+  // Copies of a store share the same requester.
+  auto copy = *ds;
+  std::vector<std::thread> threads;
+  std::vector<size_t> failures(4);
+  for (size_t t = 0; t < failures.size(); ++t) {
+    threads.emplace_back([&, t] {
+      auto& hdl = t % 2 == 0 ? *ds : copy;
+      for (int i = 0; i < 100; ++i) {
+        auto key = i % 10;
+        if (hdl.get(key) != data{key * 2})
+          ++failures[t];
+      }
+    });
+  }
+  for (auto& th : threads)
+    th.join();
+  for (auto n : failures)
+    CHECK_EQUAL(n, 0u);
 }
 
 TEST(clone operations - same endpoint) {
@@ -90,6 +170,41 @@ TEST(clone operations - same endpoint) {
   REQUIRE(!c);
 }
 
+TEST(clones with local reads answer lookups on the calling thread) {
+  using std::chrono::milliseconds;
+  broker_options options;
+  options.disable_ssl = true;
+  configuration master_cfg{options};
+  endpoint earth{std::move(master_cfg)};
+  configuration clone_cfg{options};
+  clone_cfg.set("broker.store.clone-local-reads", true);
+  endpoint mars{std::move(clone_cfg)};
+  auto port = earth.listen("127.0.0.1", 0);
+  REQUIRE_NOT_EQUAL(port, 0u);
+  REQUIRE(mars.peer("127.0.0.1", port));
+  auto m = earth.attach_master("romulus", backend::memory);
+  REQUIRE(m);
+  m->put("foo", 42);
+  auto c = mars.attach_clone("romulus");
+  REQUIRE(c);
+  // Waits up to 10s until `pred` holds for the clone.
+  auto await = [&](auto pred) {
+    for (int i = 0; i < 1000 && !pred(); ++i)
+      std::this_thread::sleep_for(milliseconds(10));
+    return pred();
+  };
+  MESSAGE("the clone publishes the snapshot from its master");
+  CHECK(await([&] { return c->get("foo") == data{42}; }));
+  CHECK_EQUAL(value_of(c->exists("foo")), data{true});
+  CHECK_EQUAL(value_of(c->exists("bar")), data{false});
+  CHECK_EQUAL(c->get("bar"), error{ec::no_such_key});
+  MESSAGE("the clone publishes updates from its master");
+  m->put("bar", 23);
+  m->erase("foo");
+  CHECK(await([&] { return c->exists("foo") == data{false}; }));
+  CHECK_EQUAL(value_of(c->get("bar")), data{23});
+}
+
 TEST(expiration) {
   using std::chrono::milliseconds;
   endpoint ep;
@@ -129,4 +244,13 @@ TEST(proxy) {
   auto key_resp = proxy.receive();
   CAF_REQUIRE_EQUAL(key_resp.id, key_id);
   CAF_REQUIRE_EQUAL(value_of(key_resp.answer), data(set{"foo"}));
+  MESSAGE("master: query multiple keys");
+  auto get_id = proxy.get_many({"foo", "bar"});
+  auto exists_id = proxy.exists_many({"foo", "bar"});
+  auto responses = proxy.receive(2);
+  REQUIRE_EQUAL(responses.size(), 2u);
+  CHECK_EQUAL(responses[0].id, get_id);
+  CHECK_EQUAL(value_of(responses[0].answer), data(table{{"foo", 42}}));
+  CHECK_EQUAL(responses[1].id, exists_id);
+  CHECK_EQUAL(value_of(responses[1].answer), data(vector{true, false}));
 }